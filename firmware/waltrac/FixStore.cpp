@@ -0,0 +1,247 @@
+#include <LittleFS.h>
+#include <esp_log.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#include "FixStore.h"
+
+#define FIX_STORE_DIR "/fixes"
+#define FIX_STORE_CURSOR FIX_STORE_DIR "/cursor"
+
+FixStore fixStore;
+
+void FixStore::segmentPath(uint32_t segment, char* path, size_t len)
+{
+    snprintf(path, len, FIX_STORE_DIR "/%08lx.bin", (unsigned long)segment);
+}
+
+size_t FixStore::segmentFixes(uint32_t segment)
+{
+    char path[32];
+    segmentPath(segment, path, sizeof(path));
+
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return 0;
+    }
+
+    /* A record cut short by a power loss is not counted */
+    size_t fixes = file.size() / sizeof(Record);
+    file.close();
+
+    return fixes;
+}
+
+bool FixStore::begin()
+{
+    static_assert(std::is_trivially_copyable<Record>::value, "records are written with memcpy");
+
+    /* Format on the first boot, the partition is not used for anything else */
+    if (!LittleFS.begin(true)) {
+        ESP_LOGE("WaltracStore", "Could not mount LittleFS.");
+        return false;
+    }
+
+    if (!LittleFS.exists(FIX_STORE_DIR) && !LittleFS.mkdir(FIX_STORE_DIR)) {
+        ESP_LOGE("WaltracStore", "Could not create " FIX_STORE_DIR ".");
+        return false;
+    }
+
+    /* Recover the ring bounds from the segment names */
+    bool found = false;
+    File dir = LittleFS.open(FIX_STORE_DIR);
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const char* name = strrchr(file.name(), '/');
+        name = name != nullptr ? name + 1 : file.name();
+
+        char* end = nullptr;
+        uint32_t segment = strtoul(name, &end, 16);
+        file.close();
+
+        if (end == name || strcmp(end, ".bin") != 0) {
+            continue;
+        }
+
+        if (!found || segment < tail_) {
+            tail_ = segment;
+        }
+        if (!found || segment > head_) {
+            head_ = segment;
+        }
+        found = true;
+    }
+    dir.close();
+
+    tailOffset_ = 0;
+    if (found) {
+        File file = LittleFS.open(FIX_STORE_CURSOR, "r");
+        Cursor cursor = {};
+        if (file && file.read(reinterpret_cast<uint8_t*>(&cursor), sizeof(cursor)) == sizeof(cursor) && cursor.segment == tail_) {
+            tailOffset_ = cursor.offset;
+        }
+        file.close();
+
+        count_ = 0;
+        for (uint32_t segment = tail_; segment != head_ + 1; segment++) {
+            count_ += segmentFixes(segment);
+        }
+        count_ = count_ > tailOffset_ ? count_ - tailOffset_ : 0;
+        headFixes_ = segmentFixes(head_);
+    }
+
+    mounted_ = true;
+    ESP_LOGI("WaltracStore", "Fix store ready with %u stored fixes.", (unsigned)count_);
+    return true;
+}
+
+bool FixStore::saveCursor()
+{
+    File file = LittleFS.open(FIX_STORE_CURSOR, "w");
+    if (!file) {
+        return false;
+    }
+
+    Cursor cursor = {tail_, tailOffset_};
+    bool written = file.write(reinterpret_cast<const uint8_t*>(&cursor), sizeof(cursor)) == sizeof(cursor);
+    file.close();
+
+    return written;
+}
+
+void FixStore::dropTail()
+{
+    char path[32];
+    segmentPath(tail_, path, sizeof(path));
+
+    size_t fixes = segmentFixes(tail_);
+    size_t dropped = fixes > tailOffset_ ? fixes - tailOffset_ : 0;
+    count_ = count_ > dropped ? count_ - dropped : 0;
+
+    LittleFS.remove(path);
+    tail_++;
+    tailOffset_ = 0;
+}
+
+bool FixStore::append(const Entry& entry)
+{
+    if (!mounted_) {
+        return false;
+    }
+
+    /* Start the next segment, the oldest one makes room once the ring is full */
+    if (headFixes_ >= WT_CFG_STORE_SEGMENT_FIXES) {
+        head_++;
+        headFixes_ = 0;
+
+        if (head_ - tail_ >= WT_CFG_STORE_SEGMENTS) {
+            ESP_LOGW("WaltracStore", "Fix store full, dropping the oldest segment.");
+            dropTail();
+            saveCursor();
+        }
+    }
+
+    Record record = {};
+    record.timestamp = entry.timestamp;
+    record.latitude = entry.fix.latitude;
+    record.longitude = entry.fix.longitude;
+    record.confidence = entry.fix.confidence;
+    record.satellites = entry.fix.satellites;
+
+    char path[32];
+    segmentPath(head_, path, sizeof(path));
+
+    File file = LittleFS.open(path, "a");
+    if (!file) {
+        ESP_LOGE("WaltracStore", "Could not open %s.", path);
+        return false;
+    }
+
+    bool written = file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record)) == sizeof(record);
+    file.close();
+
+    if (!written) {
+        ESP_LOGE("WaltracStore", "Could not append fix to %s.", path);
+        return false;
+    }
+
+    headFixes_++;
+    count_++;
+    return true;
+}
+
+size_t FixStore::peek(Entry* entries, size_t max)
+{
+    if (!mounted_) {
+        return 0;
+    }
+
+    size_t n = 0;
+    uint32_t offset = tailOffset_;
+    for (uint32_t segment = tail_; n < max && segment != head_ + 1; segment++, offset = 0) {
+        char path[32];
+        segmentPath(segment, path, sizeof(path));
+
+        File file = LittleFS.open(path, "r");
+        if (!file) {
+            continue;
+        }
+
+        size_t fixes = file.size() / sizeof(Record);
+        file.seek(offset * sizeof(Record));
+
+        for (; offset < fixes && n < max; offset++, n++) {
+            Record record;
+            if (file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) != sizeof(record)) {
+                break;
+            }
+
+            entries[n] = {};
+            entries[n].timestamp = record.timestamp;
+            entries[n].fix.latitude = record.latitude;
+            entries[n].fix.longitude = record.longitude;
+            entries[n].fix.confidence = record.confidence;
+            entries[n].fix.satellites = record.satellites;
+        }
+
+        file.close();
+    }
+
+    return n;
+}
+
+bool FixStore::pop(size_t count)
+{
+    if (!mounted_) {
+        return false;
+    }
+
+    while (count > 0 && count_ > 0) {
+        size_t fixes = tail_ == head_ ? headFixes_ : segmentFixes(tail_);
+        size_t take = fixes - tailOffset_ < count ? fixes - tailOffset_ : count;
+
+        tailOffset_ += take;
+        count_ -= take;
+        count -= take;
+
+        if (tailOffset_ < fixes) {
+            break;
+        }
+
+        if (tail_ == head_) {
+            /* The ring is empty, the next append starts the segment over */
+            char path[32];
+            segmentPath(tail_, path, sizeof(path));
+            LittleFS.remove(path);
+
+            headFixes_ = 0;
+            tailOffset_ = 0;
+            break;
+        }
+
+        dropTail();
+    }
+
+    return saveCursor();
+}
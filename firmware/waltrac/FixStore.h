@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Messages.h"
+
+/**
+ * @brief Number of segment files the store rotates through. Once all of them are full the oldest segment is dropped.
+ */
+#ifndef WT_CFG_STORE_SEGMENTS
+#define WT_CFG_STORE_SEGMENTS 8
+#endif
+
+/**
+ * @brief Number of fixes per segment file.
+ */
+#ifndef WT_CFG_STORE_SEGMENT_FIXES
+#define WT_CFG_STORE_SEGMENT_FIXES 256
+#endif
+
+/**
+ * @brief Persistent store-and-forward ring of fixes that could not be sent.
+ *
+ * Fixes are appended as fixed size records to segment files on LittleFS, which spreads the writes over the whole
+ * partition. Segments are named by an increasing sequence number, so the ring order survives a restart. The read
+ * position inside the oldest segment is kept in a small cursor file, drained segments are deleted.
+ *
+ * @note Not thread safe, all calls have to come from the same task.
+ */
+class FixStore {
+public:
+    struct Entry {
+        Messages::PositionBatch::Fix fix;
+        int64_t timestamp = 0;      // GNSS time of the fix in seconds since the epoch
+    };
+
+    /**
+     * @brief Mount the file system and recover the ring from the segment files.
+     *
+     * @return Whether the store is usable.
+     */
+    bool begin();
+
+    /**
+     * @brief Append a fix as the newest entry, drops the oldest segment when the ring is full.
+     *
+     * @param entry The fix and its time.
+     *
+     * @return Whether the fix was written to flash.
+     */
+    bool append(const Entry& entry);
+
+    /**
+     * @brief Read the oldest entries without removing them.
+     *
+     * @param entries Receives up to max entries, oldest first.
+     * @param max Capacity of entries.
+     *
+     * @return The number of entries read.
+     */
+    size_t peek(Entry* entries, size_t max);
+
+    /**
+     * @brief Remove the oldest entries, usually after the entries returned by peek() were delivered.
+     *
+     * @param count The number of entries to remove.
+     *
+     * @return Whether the new read position was stored.
+     */
+    bool pop(size_t count);
+
+    /**
+     * @brief Number of stored entries.
+     */
+    size_t size() const { return count_; }
+
+    /**
+     * @brief Whether begin() succeeded.
+     */
+    bool ready() const { return mounted_; }
+
+private:
+    struct Record {
+        int64_t timestamp;
+        double latitude;
+        double longitude;
+        uint8_t confidence;
+        uint8_t satellites;
+    };
+
+    struct Cursor {
+        uint32_t segment;
+        uint32_t offset;
+    };
+
+    static void segmentPath(uint32_t segment, char* path, size_t len);
+    static size_t segmentFixes(uint32_t segment);
+
+    bool saveCursor();
+    void dropTail();
+
+    bool mounted_ = false;
+    uint32_t head_ = 0;             // segment appended to
+    uint32_t tail_ = 0;             // oldest segment
+    uint32_t tailOffset_ = 0;       // records of the oldest segment already popped
+    size_t headFixes_ = 0;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Fixes waiting for the uplink.
+ */
+extern FixStore fixStore;
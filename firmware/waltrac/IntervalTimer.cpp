@@ -0,0 +1,54 @@
+#include <cmath>
+
+#include "IntervalTimer.h"
+
+int64_t IntervalTimer::wake(int64_t now)
+{
+    if (!started_) {
+        deadline_ = now;
+        started_ = true;
+    }
+
+    int64_t lateness = now - start();
+    if (lateness < 0) {
+        lateness = 0;
+    }
+
+    /* Running mean and variance of the lateness */
+    stats_.cycles++;
+    double delta = lateness - stats_.meanLatenessMicros;
+    stats_.meanLatenessMicros += delta / stats_.cycles;
+    latenessM2_ += delta * (lateness - stats_.meanLatenessMicros);
+    stats_.jitterMicros = sqrt(latenessM2_ / stats_.cycles);
+
+    stats_.lastLatenessMicros = lateness;
+    if (lateness > stats_.maxLatenessMicros) {
+        stats_.maxLatenessMicros = lateness;
+    }
+
+    return lateness;
+}
+
+int64_t IntervalTimer::schedule(int64_t now, uint32_t intervalSeconds, int64_t leadMicros)
+{
+    int64_t interval = (int64_t)intervalSeconds * 1000000;
+    if (interval <= 0) {
+        interval = 1000000;
+    }
+
+    lead_ = leadMicros < 0 ? 0 : (leadMicros > interval ? interval : leadMicros);
+
+    deadline_ += interval;
+    if (deadline_ < now) {
+        stats_.overruns++;
+
+        /* Catching up runs the missed deadline right away, but never lags behind by a whole interval */
+        int64_t behind = now - deadline_;
+        int64_t missed = policy_ == POLICY_SKIP ? behind / interval + 1 : behind / interval;
+
+        deadline_ += missed * interval;
+        stats_.skipped += missed;
+    }
+
+    return start() > now ? start() - now : 0;
+}
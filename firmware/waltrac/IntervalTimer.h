@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Interval timer on absolute deadlines.
+ *
+ * Every deadline is the previous deadline plus the interval, not the end of the previous cycle plus the interval, so
+ * the time a cycle takes does not shift the cadence. A cycle that runs past the next deadline is an overrun. The
+ * policy decides whether the missed deadline still runs right away (catch-up) or is skipped to the next one in the
+ * future. A cycle can be started a lead time ahead of its deadline, so that its result is ready at the deadline. The
+ * timer records how late every cycle started compared to its planned start.
+ *
+ * All times are monotonic microseconds, passed in by the caller.
+ *
+ * @note Not thread safe, all calls have to come from the same task.
+ */
+class IntervalTimer {
+public:
+    enum Policy {
+        POLICY_CATCH_UP,    // run a missed deadline right away, at most one interval behind
+        POLICY_SKIP,        // drop missed deadlines and wait for the next one in the future
+    };
+
+    struct Stats {
+        uint32_t cycles = 0;                // cycles started
+        uint32_t overruns = 0;              // cycles that ran past the next deadline
+        uint32_t skipped = 0;               // deadlines dropped
+        int64_t lastLatenessMicros = 0;     // lateness of the current cycle against its planned start
+        int64_t maxLatenessMicros = 0;
+        double meanLatenessMicros = 0.0;
+        double jitterMicros = 0.0;          // standard deviation of the lateness
+    };
+
+    /* constexpr, so a global timer is constant initialized and can live in RTC memory across deep sleep */
+    explicit constexpr IntervalTimer(Policy policy) : policy_(policy) {}
+
+    /**
+     * @brief Mark the start of a cycle. The first call sets the first deadline.
+     *
+     * @param now The current time.
+     *
+     * @return How late the cycle started compared to its planned start in microseconds.
+     */
+    int64_t wake(int64_t now);
+
+    /**
+     * @brief Set the deadline of the next cycle at the end of a cycle.
+     *
+     * @param now The current time.
+     * @param intervalSeconds The interval from the current deadline to the next one.
+     * @param leadMicros How long before its deadline the next cycle starts, at most one interval.
+     *
+     * @return Microseconds to wait until the planned start of the next cycle, 0 to start right away.
+     */
+    int64_t schedule(int64_t now, uint32_t intervalSeconds, int64_t leadMicros = 0);
+
+    /**
+     * @brief The deadline of the current or, after schedule(), the next cycle.
+     */
+    int64_t deadline() const { return deadline_; }
+
+    /**
+     * @brief The planned start of the current or, after schedule(), the next cycle.
+     */
+    int64_t start() const { return deadline_ - lead_; }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    Policy policy_;
+    bool started_ = false;
+    int64_t deadline_ = 0;
+    int64_t lead_ = 0;              // how long before the deadline the cycle starts
+    double latenessM2_ = 0.0;       // running sum of squared deviations for the jitter
+    Stats stats_;
+};
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <string>
+#include <type_traits>
+
+#include "Messages.h"
+
+// MessageSchema.h - wire layout of every message as a compile-time field list.
+//
+// Each message is a Schema::Message<Fields...>. From that single list the
+// compiler generates size(), write(), check() and read() as unrolled fold
+// expressions, constexpr minimum sizes and field offsets, all without virtual
+// dispatch. tools/schemagen.cpp walks the same lists through describe() and
+// emits the Python (service/waltrac/messages_schema.py) and JavaScript
+// (web/waltrac/messages.js) decoders, so every codec follows this file.
+
+namespace Messages {
+namespace Schema {
+
+typedef enum
+{
+    FIELD_KIND_HEADER,
+    FIELD_KIND_U8,
+    FIELD_KIND_U16,
+    FIELD_KIND_U32,
+    FIELD_KIND_BYTES,
+    FIELD_KIND_SCALED_I32,
+    FIELD_KIND_STR8,
+    FIELD_KIND_BATCH_FIXES,
+    FIELD_KIND_TELEMETRY_PHASES
+} FieldKind;
+
+// Description of a field for code generators.
+struct FieldInfo {
+    const char* name;
+    FieldKind kind;
+    size_t size;            // fixed size or minimum size in bytes
+    int64_t scale;          // FIELD_KIND_SCALED_I32 only
+    uint8_t required;       // FIELD_KIND_HEADER only: bits that must be set
+    uint8_t forbidden;      // FIELD_KIND_HEADER only: bits that must be clear
+    uint8_t valueMask;      // FIELD_KIND_HEADER only: bits holding a value ...
+    uint8_t maxValue;       // ... that must not exceed maxValue
+};
+
+// --- field codecs ------------------------------------------------------------
+//
+// A codec encodes one value type. skip() validates the encoded value in place
+// against end, read() decodes it. frame points at the first byte of the frame
+// for codecs that depend on the header.
+
+template<size_t N>
+struct FixedCodec {
+    static constexpr bool fixed = true;
+    static constexpr size_t min_size = N;
+
+    static DecodeStatus skip(const uint8_t*, const uint8_t*& in, const uint8_t* end) noexcept {
+        if (end - in < static_cast<ptrdiff_t>(N)) {
+            return DECODE_STATUS_BAD_LENGTH;
+        }
+
+        in += N;
+        return DECODE_STATUS_OK;
+    }
+};
+
+// Header byte with marker bits that must be set or clear and an optional value
+// in valueMask that must not exceed maxValue.
+template<uint8_t Required, uint8_t Forbidden, uint8_t ValueMask = 0x00, uint8_t MaxValue = 0x00>
+struct Header : FixedCodec<1> {
+    using value_type = uint8_t;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_HEADER, 1, 0, Required, Forbidden, ValueMask, MaxValue};
+    }
+
+    static constexpr bool accepts(uint8_t v) {
+        return (v & Required) == Required && !(v & Forbidden) && (v & ValueMask) <= MaxValue;
+    }
+
+    static size_t size(const value_type&) noexcept { return 1; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        *out++ = v;
+        return true;
+    }
+
+    static DecodeStatus skip(const uint8_t*, const uint8_t*& in, const uint8_t* end) noexcept {
+        if (end - in < 1) {
+            return DECODE_STATUS_BAD_LENGTH;
+        }
+
+        return accepts(*in++) ? DECODE_STATUS_OK : DECODE_STATUS_BAD_HEADER;
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v = *start;
+        }
+
+        return status;
+    }
+};
+
+struct U8 : FixedCodec<1> {
+    using value_type = uint8_t;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_U8, 1, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const value_type&) noexcept { return 1; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        *out++ = v;
+        return true;
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v = *start;
+        }
+
+        return status;
+    }
+};
+
+// Big-endian unsigned 16 bit integer
+struct U16 : FixedCodec<2> {
+    using value_type = uint16_t;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_U16, 2, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const value_type&) noexcept { return 2; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        *out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+        *out++ = static_cast<uint8_t>((v) & 0xFF);
+        return true;
+    }
+
+    static value_type decode(const uint8_t* src) noexcept {
+        return static_cast<uint16_t>((static_cast<uint16_t>(src[0]) << 8) | src[1]);
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v = decode(start);
+        }
+
+        return status;
+    }
+};
+
+// Big-endian unsigned 32 bit integer
+struct U32 : FixedCodec<4> {
+    using value_type = uint32_t;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_U32, 4, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const value_type&) noexcept { return 4; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        *out++ = static_cast<uint8_t>((v >> 24) & 0xFF);
+        *out++ = static_cast<uint8_t>((v >> 16) & 0xFF);
+        *out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+        *out++ = static_cast<uint8_t>((v) & 0xFF);
+        return true;
+    }
+
+    static value_type decode(const uint8_t* src) noexcept {
+        return (static_cast<uint32_t>(src[0]) << 24) |
+               (static_cast<uint32_t>(src[1]) << 16) |
+               (static_cast<uint32_t>(src[2]) << 8) |
+               (static_cast<uint32_t>(src[3]));
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v = decode(start);
+        }
+
+        return status;
+    }
+};
+
+// Raw byte array of N bytes
+template<size_t N>
+struct Bytes : FixedCodec<N> {
+    using value_type = uint8_t[N];
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_BYTES, N, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const value_type&) noexcept { return N; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        memcpy(out, v, N);
+        out += N;
+        return true;
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = FixedCodec<N>::skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            memcpy(v, start, N);
+        }
+
+        return status;
+    }
+};
+
+// Double stored as big-endian signed 32 bit integer = round(value * Scale)
+template<int32_t Scale>
+struct ScaledI32 : FixedCodec<4> {
+    using value_type = double;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_SCALED_I32, 4, Scale, 0, 0, 0, 0};
+    }
+
+    static int32_t encode(double v) noexcept {
+        return static_cast<int32_t>(round(v * Scale));
+    }
+
+    static int32_t decode(const uint8_t* src) noexcept {
+        return static_cast<int32_t>((static_cast<uint32_t>(src[0]) << 24) |
+                                    (static_cast<uint32_t>(src[1]) << 16) |
+                                    (static_cast<uint32_t>(src[2]) << 8) |
+                                    (static_cast<uint32_t>(src[3])));
+    }
+
+    static size_t size(const value_type&) noexcept { return 4; }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        const int32_t scaled = encode(v);
+        *out++ = static_cast<uint8_t>((scaled >> 24) & 0xFF);
+        *out++ = static_cast<uint8_t>((scaled >> 16) & 0xFF);
+        *out++ = static_cast<uint8_t>((scaled >> 8) & 0xFF);
+        *out++ = static_cast<uint8_t>((scaled) & 0xFF);
+        return true;
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v = static_cast<double>(decode(start)) / Scale;
+        }
+
+        return status;
+    }
+};
+
+// String with a one byte length prefix, at most 255 bytes
+struct Str8 {
+    using value_type = std::string;
+
+    static constexpr bool fixed = false;
+    static constexpr size_t min_size = 1;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_STR8, 1, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const value_type& v) noexcept { return 1 + v.size(); }
+
+    static bool write(const value_type& v, uint8_t*& out) noexcept {
+        if (v.size() > 255) {
+            return false;
+        }
+
+        *out++ = static_cast<uint8_t>(v.size());
+        memcpy(out, v.data(), v.size());
+        out += v.size();
+        return true;
+    }
+
+    static DecodeStatus skip(const uint8_t*, const uint8_t*& in, const uint8_t* end) noexcept {
+        if (end - in < 1 || end - in - 1 < in[0]) {
+            return DECODE_STATUS_BAD_LENGTH;
+        }
+
+        in += 1 + in[0];
+        return DECODE_STATUS_OK;
+    }
+
+    static DecodeStatus read(value_type& v, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+        const uint8_t* start = in;
+        DecodeStatus status = skip(frame, in, end);
+        if (status == DECODE_STATUS_OK) {
+            v.assign(reinterpret_cast<const char*>(start + 1), start[0]);
+        }
+
+        return status;
+    }
+};
+
+// Count byte followed by the fixes of a PositionBatch, plain or delta/varint
+// encoded depending on PositionBatch::HEADER_COMPACT in the frame header.
+// Works on the whole PositionBatch, implemented in Messages.cpp.
+struct BatchFixes {
+    static constexpr bool fixed = false;
+    static constexpr size_t min_size = 1;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_BATCH_FIXES, 1, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const PositionBatch& batch) noexcept;
+    static bool write(const PositionBatch& batch, uint8_t*& out) noexcept;
+    static DecodeStatus skip(const uint8_t* frame, const uint8_t*& in, const uint8_t* end) noexcept;
+    static DecodeStatus read(PositionBatch& batch, const uint8_t* frame, const uint8_t*& in, const uint8_t* end);
+
+    // Decode the fix at index from a validated fix section starting at in (the count byte).
+    static PositionBatch::Fix fix(const uint8_t* frame, const uint8_t* in, const uint8_t* end, size_t index) noexcept;
+};
+
+// Count byte followed by the phases of a Telemetry frame, each
+// Telemetry::PHASE_SIZE bytes. Works on the whole Telemetry, implemented in
+// Messages.cpp. Phases beyond Telemetry::MAX_PHASES are skipped on read.
+struct TelemetryPhases {
+    static constexpr bool fixed = false;
+    static constexpr size_t min_size = 1;
+
+    static constexpr FieldInfo info(const char* name) {
+        return {name, FIELD_KIND_TELEMETRY_PHASES, 1, 0, 0, 0, 0, 0};
+    }
+
+    static size_t size(const Telemetry& telemetry) noexcept;
+    static bool write(const Telemetry& telemetry, uint8_t*& out) noexcept;
+    static DecodeStatus skip(const uint8_t* frame, const uint8_t*& in, const uint8_t* end) noexcept;
+    static DecodeStatus read(Telemetry& telemetry, const uint8_t* frame, const uint8_t*& in, const uint8_t* end);
+};
+
+// --- fields ------------------------------------------------------------------
+
+// Binds a codec to a data member. Derived structs add the wire name:
+//   struct Interval : Field<U8, &Position::interval> { static constexpr const char* name = "interval"; };
+template<typename Codec, auto Member>
+struct Field {
+    using codec = Codec;
+
+    template<typename T>
+    static size_t size(const T& obj) noexcept { return Codec::size(obj.*Member); }
+
+    template<typename T>
+    static bool write(const T& obj, uint8_t*& out) noexcept { return Codec::write(obj.*Member, out); }
+
+    template<typename T>
+    static DecodeStatus read(T& obj, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) { return Codec::read(obj.*Member, frame, in, end); }
+};
+
+// Binds a codec that encodes several members of the message at once.
+template<typename Codec>
+struct Whole {
+    using codec = Codec;
+
+    template<typename T>
+    static size_t size(const T& obj) noexcept { return Codec::size(obj); }
+
+    template<typename T>
+    static bool write(const T& obj, uint8_t*& out) noexcept { return Codec::write(obj, out); }
+
+    template<typename T>
+    static DecodeStatus read(T& obj, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) { return Codec::read(obj, frame, in, end); }
+};
+
+// --- messages ----------------------------------------------------------------
+
+// A message is its fields in wire order followed by the 16 byte HMAC.
+template<typename... Fields>
+struct Message {
+    static constexpr size_t field_count = sizeof...(Fields);
+
+    // Minimum number of field bytes, without HMAC
+    static constexpr size_t min_size = (Fields::codec::min_size + ...);
+
+    // Whether every field has a fixed size
+    static constexpr bool fixed = (Fields::codec::fixed && ...);
+
+    // Offset of field F, all fields in front of it must have a fixed size.
+    template<typename F>
+    static constexpr size_t offset_of() {
+        size_t offset = 0;
+        bool found = false;
+        bool fixedBefore = true;
+
+        ((found = found || std::is_same<F, Fields>::value,
+          offset += found ? 0 : Fields::codec::min_size,
+          fixedBefore = fixedBefore && (found || Fields::codec::fixed)), ...);
+
+        return (found && fixedBefore) ? offset : static_cast<size_t>(-1);
+    }
+
+    // Number of field bytes for obj, without HMAC
+    template<typename T>
+    static size_t size(const T& obj) noexcept {
+        return (Fields::size(obj) + ...);
+    }
+
+    // Write all fields of obj to out, which holds at least size(obj) bytes.
+    template<typename T>
+    static bool write(const T& obj, uint8_t* out) noexcept {
+        return (Fields::write(obj, out) && ...);
+    }
+
+    // Validate a full frame (fields and trailing HMAC) in place.
+    static DecodeStatus check(const uint8_t* data, size_t len) noexcept {
+        if (data == nullptr || len < min_size + Payload::HMAC_SIZE) {
+            return DECODE_STATUS_TOO_SHORT;
+        }
+
+        const uint8_t* in = data;
+        const uint8_t* end = data + len - Payload::HMAC_SIZE;
+
+        DecodeStatus status = DECODE_STATUS_OK;
+        (((status = Fields::codec::skip(data, in, end)) == DECODE_STATUS_OK) && ...);
+        if (status != DECODE_STATUS_OK) {
+            return status;
+        }
+
+        return in == end ? DECODE_STATUS_OK : DECODE_STATUS_TRAILING_BYTES;
+    }
+
+    // Validate a full frame and decode its fields into obj. The HMAC is left to the caller.
+    template<typename T>
+    static DecodeStatus read(T& obj, const uint8_t* data, size_t len) {
+        DecodeStatus status = check(data, len);
+        if (status != DECODE_STATUS_OK) {
+            return status;
+        }
+
+        const uint8_t* in = data;
+        const uint8_t* end = data + len - Payload::HMAC_SIZE;
+
+        (((status = Fields::read(obj, data, in, end)) == DECODE_STATUS_OK) && ...);
+        return status;
+    }
+
+    // Field descriptions in wire order, for code generators
+    static constexpr std::array<FieldInfo, field_count> describe() {
+        return {{ Fields::codec::info(Fields::name)... }};
+    }
+};
+
+} // namespace Schema
+
+// --- Position ----------------------------------------------------------------
+
+namespace PositionFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80, PositionBatch::HEADER_BATCH | SessionPosition::HEADER_SESSION | Telemetry::HEADER_TELEMETRY>, &Position::header> { static constexpr const char* name = "header"; };
+    struct Interval : Field<U8, &Position::interval> { static constexpr const char* name = "interval"; };
+    struct Confidence : Field<U8, &Position::confidence> { static constexpr const char* name = "confidence"; };
+    struct Satellites : Field<U8, &Position::satellites> { static constexpr const char* name = "satellites"; };
+    struct Device : Field<Bytes<6>, &Position::device> { static constexpr const char* name = "device"; };
+    struct Latitude : Field<ScaledI32<10000000>, &Position::latitude> { static constexpr const char* name = "latitude"; };
+    struct Longitude : Field<ScaledI32<10000000>, &Position::longitude> { static constexpr const char* name = "longitude"; };
+    struct Name : Field<Str8, &Position::name> { static constexpr const char* name = "name"; };
+}
+
+using PositionSchema = Schema::Message<
+    PositionFields::Header,
+    PositionFields::Interval,
+    PositionFields::Confidence,
+    PositionFields::Satellites,
+    PositionFields::Device,
+    PositionFields::Latitude,
+    PositionFields::Longitude,
+    PositionFields::Name
+>;
+
+// --- SessionPosition ---------------------------------------------------------
+
+namespace SessionPositionFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80 | SessionPosition::HEADER_SESSION, PositionBatch::HEADER_BATCH | Telemetry::HEADER_TELEMETRY>, &SessionPosition::header> { static constexpr const char* name = "header"; };
+    struct Interval : Field<U8, &SessionPosition::interval> { static constexpr const char* name = "interval"; };
+    struct Confidence : Field<U8, &SessionPosition::confidence> { static constexpr const char* name = "confidence"; };
+    struct Satellites : Field<U8, &SessionPosition::satellites> { static constexpr const char* name = "satellites"; };
+    struct Session : Field<U16, &SessionPosition::session> { static constexpr const char* name = "session"; };
+    struct Latitude : Field<ScaledI32<10000000>, &SessionPosition::latitude> { static constexpr const char* name = "latitude"; };
+    struct Longitude : Field<ScaledI32<10000000>, &SessionPosition::longitude> { static constexpr const char* name = "longitude"; };
+    struct Name : Field<Str8, &SessionPosition::name> { static constexpr const char* name = "name"; };
+}
+
+using SessionPositionSchema = Schema::Message<
+    SessionPositionFields::Header,
+    SessionPositionFields::Interval,
+    SessionPositionFields::Confidence,
+    SessionPositionFields::Satellites,
+    SessionPositionFields::Session,
+    SessionPositionFields::Latitude,
+    SessionPositionFields::Longitude,
+    SessionPositionFields::Name
+>;
+
+// --- PositionBatch -----------------------------------------------------------
+
+namespace PositionBatchFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80 | PositionBatch::HEADER_BATCH, SessionPosition::HEADER_SESSION | Telemetry::HEADER_TELEMETRY | PositionBatch::HEADER_SEQUENCED>, &PositionBatch::header> { static constexpr const char* name = "header"; };
+    struct Interval : Field<U8, &PositionBatch::interval> { static constexpr const char* name = "interval"; };
+    struct Device : Field<Bytes<6>, &PositionBatch::device> { static constexpr const char* name = "device"; };
+    struct Fixes : Whole<BatchFixes> { static constexpr const char* name = "fixes"; };
+    struct Name : Field<Str8, &PositionBatch::name> { static constexpr const char* name = "name"; };
+}
+
+using PositionBatchSchema = Schema::Message<
+    PositionBatchFields::Header,
+    PositionBatchFields::Interval,
+    PositionBatchFields::Device,
+    PositionBatchFields::Fixes,
+    PositionBatchFields::Name
+>;
+
+// --- SequencedBatch ----------------------------------------------------------
+
+// A PositionBatch with the sequence number of its first fix, same class.
+namespace SequencedBatchFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80 | PositionBatch::HEADER_BATCH | PositionBatch::HEADER_SEQUENCED, SessionPosition::HEADER_SESSION | Telemetry::HEADER_TELEMETRY>, &PositionBatch::header> { static constexpr const char* name = "header"; };
+    struct Sequence : Field<U16, &PositionBatch::sequence> { static constexpr const char* name = "sequence"; };
+}
+
+using SequencedBatchSchema = Schema::Message<
+    SequencedBatchFields::Header,
+    PositionBatchFields::Interval,
+    PositionBatchFields::Device,
+    SequencedBatchFields::Sequence,
+    PositionBatchFields::Fixes,
+    PositionBatchFields::Name
+>;
+
+// --- Command -----------------------------------------------------------------
+
+namespace CommandFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80, 0x00, 0x0F, COMMAND_ACTION_ACK>, &Command::header> { static constexpr const char* name = "header"; };
+    struct Arg : Field<Str8, &Command::arg> { static constexpr const char* name = "arg"; };
+}
+
+using CommandSchema = Schema::Message<
+    CommandFields::Header,
+    CommandFields::Arg
+>;
+
+// --- Telemetry ---------------------------------------------------------------
+
+namespace TelemetryFields {
+    using namespace Schema;
+
+    struct Header : Field<Schema::Header<0x80 | Telemetry::HEADER_TELEMETRY, PositionBatch::HEADER_BATCH | PositionBatch::HEADER_COMPACT | SessionPosition::HEADER_SESSION>, &Telemetry::header> { static constexpr const char* name = "header"; };
+    struct Device : Field<Bytes<6>, &Telemetry::device> { static constexpr const char* name = "device"; };
+    struct Window : Field<U32, &Telemetry::window> { static constexpr const char* name = "window"; };
+    struct Awake : Field<U32, &Telemetry::awake> { static constexpr const char* name = "awake"; };
+    struct Restarts : Field<U16, &Telemetry::restarts> { static constexpr const char* name = "restarts"; };
+    struct Crashes : Field<U16, &Telemetry::crashes> { static constexpr const char* name = "crashes"; };
+    struct GnssRetries : Field<U16, &Telemetry::gnssRetries> { static constexpr const char* name = "gnss_retries"; };
+    struct GnssTimeouts : Field<U16, &Telemetry::gnssTimeouts> { static constexpr const char* name = "gnss_timeouts"; };
+    struct AttachFailures : Field<U16, &Telemetry::attachFailures> { static constexpr const char* name = "attach_failures"; };
+    struct SendFailures : Field<U16, &Telemetry::sendFailures> { static constexpr const char* name = "send_failures"; };
+    struct Phases : Whole<TelemetryPhases> { static constexpr const char* name = "phases"; };
+}
+
+using TelemetrySchema = Schema::Message<
+    TelemetryFields::Header,
+    TelemetryFields::Device,
+    TelemetryFields::Window,
+    TelemetryFields::Awake,
+    TelemetryFields::Restarts,
+    TelemetryFields::Crashes,
+    TelemetryFields::GnssRetries,
+    TelemetryFields::GnssTimeouts,
+    TelemetryFields::AttachFailures,
+    TelemetryFields::SendFailures,
+    TelemetryFields::Phases
+>;
+
+} // namespace Messages
@@ -1,204 +1,392 @@
-#include "Messages.h"
+#include "MessageSchema.h"
 
+#include <atomic>
 #include <cstring>
 #include <cmath>
-#include <mbedtls/md.h>
-
-#include <esp.h>
 
 namespace Messages {
 
 // --- helpers -----------------------------------------------------------------
 
-static void push_u8(std::vector<uint8_t>& out, uint8_t v) {
-    out.push_back(v);
+static void write_u8(uint8_t*& out, uint8_t v) {
+    *out++ = v;
+}
+
+static void write_be_i32(uint8_t*& out, int32_t v) {
+    *out++ = static_cast<uint8_t>((v >> 24) & 0xFF);
+    *out++ = static_cast<uint8_t>((v >> 16) & 0xFF);
+    *out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+    *out++ = static_cast<uint8_t>((v) & 0xFF);
 }
 
-static void push_be_i32(std::vector<uint8_t>& out, int32_t v) {
-    out.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v) & 0xFF));
+static void write_be_u16(uint8_t*& out, uint16_t v) {
+    *out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+    *out++ = static_cast<uint8_t>((v) & 0xFF);
+}
+
+static size_t varint_size(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+
+    return n;
 }
 
-static void push_be_u32(std::vector<uint8_t>& out, uint32_t v) {
-    out.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v) & 0xFF));
+static void write_varint(uint8_t*& out, uint64_t v) {
+    while (v >= 0x80) {
+        *out++ = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+
+    *out++ = static_cast<uint8_t>(v);
 }
 
-static int32_t read_be_i32(const std::vector<uint8_t>& src, size_t offset) {
-    int32_t v = (static_cast<int32_t>(src[offset]) << 24) |
-                (static_cast<int32_t>(src[offset+1]) << 16) |
-                (static_cast<int32_t>(src[offset+2]) << 8) |
-                (static_cast<int32_t>(src[offset+3]));
-    return v;
+// Read a LEB128 varint of at most maxBytes bytes without reading past end.
+static bool read_varint(const uint8_t*& in, const uint8_t* end, size_t maxBytes, uint64_t& v) {
+    v = 0;
+    for (size_t i = 0; i < maxBytes && in < end; ++i) {
+        uint8_t b = *in++;
+        v |= static_cast<uint64_t>(b & 0x7F) << (7 * i);
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-static uint32_t read_be_u32(const std::vector<uint8_t>& src, size_t offset) {
-    uint32_t v = (static_cast<uint32_t>(src[offset]) << 24) |
-                 (static_cast<uint32_t>(src[offset+1]) << 16) |
-                 (static_cast<uint32_t>(src[offset+2]) << 8) |
-                 (static_cast<uint32_t>(src[offset+3]));
-    return v;
+static uint64_t zigzag_encode(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
 }
 
+static int64_t zigzag_decode(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
 
-static void compute_hmac_sha256_trunc(const uint8_t* key, size_t keylen, const uint8_t* data, size_t datalen, uint8_t out16[16]) {
-    unsigned char full[32];
-    mbedtls_md_context_t ctx;
-    
-    const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-    if (md_info == nullptr) {
-        throw std::runtime_error("mbedtls md info not available");
+static int32_t scale_coordinate(double v) {
+    return Schema::ScaledI32<10000000>::encode(v);
+}
+
+static int32_t read_be_i32(const uint8_t* src) {
+    return Schema::ScaledI32<10000000>::decode(src);
+}
+
+static bool verify_trailing_hmac(const Signer& signer, const uint8_t* data, size_t len) {
+    uint8_t expected[16];
+    if (!signer.sign(data, len - Payload::HMAC_SIZE, expected)) {
+        return false;
     }
 
-    mbedtls_md_init(&ctx);
-    if (mbedtls_md_setup(&ctx, md_info, 1) != 0) {
-        mbedtls_md_free(&ctx);
-        throw std::runtime_error("mbedtls_md_setup failed");
+    return std::equal(expected, expected + 16, data + len - Payload::HMAC_SIZE);
+}
+
+// Key schedule of the last key passed to the const char* overloads, so repeated
+// calls with the same key skip the setup. Taken without blocking: a call that
+// finds it busy, or has a key longer than a block, signs with its own Signer.
+static struct {
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    Signer signer;
+    size_t keylen = 0;
+    uint8_t key[Sha256::BLOCK_SIZE] = {0};
+} keyCache;
+
+static bool compute_hmac_sha256_trunc(const char* key, const uint8_t* data, size_t datalen, uint8_t out16[16]) {
+    const size_t keylen = std::strlen(key);
+    if (keylen > sizeof(keyCache.key) || keyCache.busy.test_and_set(std::memory_order_acquire)) {
+        Signer signer;
+        return signer.setKey(reinterpret_cast<const uint8_t*>(key), keylen) && signer.sign(data, datalen, out16);
     }
 
-    if (mbedtls_md_hmac_starts(&ctx, key, static_cast<int>(keylen)) != 0 ||
-        mbedtls_md_hmac_update(&ctx, data, datalen) != 0 ||
-        mbedtls_md_hmac_finish(&ctx, full) != 0) {
-        mbedtls_md_free(&ctx);
-        throw std::runtime_error("mbedtls hmac failed");
+    bool ok = true;
+    if (!keyCache.signer.hasKey() || keyCache.keylen != keylen || memcmp(keyCache.key, key, keylen) != 0) {
+        ok = keyCache.signer.setKey(reinterpret_cast<const uint8_t*>(key), keylen);
+        keyCache.keylen = keylen;
+        memcpy(keyCache.key, key, keylen);
     }
 
-    mbedtls_md_free(&ctx);
-    memcpy(out16, full, 16);
+    ok = ok && keyCache.signer.sign(data, datalen, out16);
+    keyCache.busy.clear(std::memory_order_release);
+
+    return ok;
 }
 
-// --- Payload ---------------------------------------------------------------
+const char* decodeStatusName(DecodeStatus status) noexcept {
+    switch (status) {
+        case DECODE_STATUS_OK:              return "ok";
+        case DECODE_STATUS_TOO_SHORT:       return "too short";
+        case DECODE_STATUS_BAD_LENGTH:      return "bad length";
+        case DECODE_STATUS_TRAILING_BYTES:  return "trailing bytes";
+        case DECODE_STATUS_BAD_HEADER:      return "bad header";
+        case DECODE_STATUS_BAD_MAC:         return "bad mac";
+    }
 
-std::vector<uint8_t> Payload::serialize(const char* key) {
-    std::vector<uint8_t> fields = this->_serialize_fields();
-    if (key == nullptr) {
-        // append 16 zero bytes
-        fields.insert(fields.end(), 16, 0);
+    return "unknown";
+}
 
-        return fields;
+const char* telemetryPhaseName(TelemetryPhase phase) noexcept {
+    switch (phase) {
+        case TELEMETRY_PHASE_CLOCK:         return "clock";
+        case TELEMETRY_PHASE_ASSISTANCE:    return "assistance";
+        case TELEMETRY_PHASE_ATTACH:        return "attach";
+        case TELEMETRY_PHASE_DETACH:        return "detach";
+        case TELEMETRY_PHASE_GNSS:          return "gnss";
+        case TELEMETRY_PHASE_SEND:          return "send";
+        case TELEMETRY_PHASE_COUNT:         break;
     }
 
-    uint8_t sig[16];
+    return "unknown";
+}
 
-    compute_hmac_sha256_trunc(reinterpret_cast<const uint8_t*>(key), std::strlen(key), fields.data(), fields.size(), sig);
+// --- Signer ----------------------------------------------------------------
 
-    std::copy(sig, sig + 16, this->hmac_.begin());
-    fields.insert(fields.end(), sig, sig + 16);
+Signer::Signer(const char* key) noexcept {
+    setKey(key);
+}
 
-    return fields;
+Signer::Signer(const uint8_t* key, size_t keylen) noexcept {
+    setKey(key, keylen);
+}
+
+Signer::~Signer() {
+    release();
+}
+
+void Signer::release() noexcept {
+    if (ready_) {
+        inner_.release();
+        outer_.release();
+        work_.release();
+        ready_ = false;
+    }
 }
 
-bool Payload::verify(const char* key) const {
+bool Signer::setKey(const char* key) noexcept {
     if (key == nullptr) {
-        throw std::runtime_error("key is null");
+        release();
+        return false;
     }
 
-    // hmac_ must be set
-    uint8_t expected[16];
-    std::vector<uint8_t> fields = this->_serialize_fields();
+    return setKey(reinterpret_cast<const uint8_t*>(key), std::strlen(key));
+}
 
-    compute_hmac_sha256_trunc(reinterpret_cast<const uint8_t*>(key), std::strlen(key), fields.data(), fields.size(), expected);
+bool Signer::setKey(const uint8_t* key, size_t keylen) noexcept {
+    release();
 
-    return std::equal(expected, expected + 16, this->hmac_.begin());
+    if (!inner_.setup() || !outer_.setup() || !work_.setup()) {
+        inner_.release();
+        outer_.release();
+        work_.release();
+        return false;
+    }
+
+    ready_ = true;
+
+    // keys longer than the block size are replaced by their digest (RFC 2104)
+    uint8_t block[Sha256::BLOCK_SIZE] = {0};
+    if (keylen > sizeof(block)) {
+        if (!work_.starts() ||
+            !work_.update(key, keylen) ||
+            !work_.finish(block)) {
+            release();
+            return false;
+        }
+    } else if (keylen > 0) {
+        memcpy(block, key, keylen);
+    }
+
+    uint8_t ipad[Sha256::BLOCK_SIZE];
+    uint8_t opad[Sha256::BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(block); ++i) {
+        ipad[i] = block[i] ^ 0x36;
+        opad[i] = block[i] ^ 0x5C;
+    }
+
+    bool ok = inner_.starts() &&
+              inner_.update(ipad, sizeof(ipad)) &&
+              outer_.starts() &&
+              outer_.update(opad, sizeof(opad));
+
+    memset(block, 0, sizeof(block));
+    memset(ipad, 0, sizeof(ipad));
+    memset(opad, 0, sizeof(opad));
+
+    if (!ok) {
+        release();
+    }
+
+    return ok;
 }
 
-// --- Position --------------------------------------------------------------
+bool Signer::sign(const uint8_t* data, size_t datalen, uint8_t out16[16]) const noexcept {
+    if (!ready_) {
+        return false;
+    }
 
-Position Position::init(const std::vector<uint8_t>& data) {
-    // min_fixed = 1(header)+1(interval)+1(confidence)+1(satellites)+6(device)+4(lat)+4(lon)+1(namelen)+16(hmac)
-    const size_t min_fixed = 1 + 1 + 1 + 1 + 6 + 4 + 4 + 1 + 16;
-    if (data.size() < min_fixed) {
-        throw std::runtime_error("data too short for Position");
+    uint8_t full[Sha256::DIGEST_SIZE];
+
+    // inner hash continues from the ipad midstate, outer hash from the opad midstate
+    if (!work_.copyFrom(inner_) ||
+        !work_.update(data, datalen) ||
+        !work_.finish(full) ||
+        !work_.copyFrom(outer_) ||
+        !work_.update(full, sizeof(full)) ||
+        !work_.finish(full)) {
+        return false;
     }
 
-    size_t offset = 0;
-    Position p;
+    memcpy(out16, full, 16);
+    return true;
+}
 
-    p.header = data[offset++];
-    p.interval = data[offset++];
-    p.confidence = data[offset++];
-    p.satellites = data[offset++];
+// --- Payload ---------------------------------------------------------------
 
-    for (size_t i = 0; i < 6; ++i) {
-        p.device[i] = data[offset++];
+#ifndef MESSAGES_NO_EXCEPTIONS
+std::vector<uint8_t> Payload::serialize(const char* key) {
+    std::vector<uint8_t> out(this->serializedSize());
+    if (this->serialize(out.data(), out.size(), key) == 0) {
+        throw std::runtime_error("message fields cannot be encoded or signed");
     }
 
-    int32_t lat_int = read_be_i32(data, offset);
-    offset += 4;
-    p.latitude = static_cast<double>(lat_int) / Position::SCALE;
+    return out;
+}
+#endif
 
-    int32_t lon_int = read_be_i32(data, offset);
-    offset += 4;
-    p.longitude = static_cast<double>(lon_int) / Position::SCALE;
+size_t Payload::serialize(uint8_t* buffer, size_t capacity, const char* key) noexcept {
+    const size_t fieldsLen = this->_fields_size();
+    const size_t total = fieldsLen + HMAC_SIZE;
+    if (buffer == nullptr || capacity < total) {
+        return 0;
+    }
 
+    if (!this->_write_fields(buffer)) {
+        return 0;
+    }
 
-    uint8_t namelen = data[offset++];
+    if (key == nullptr) {
+        // append 16 zero bytes
+        memset(buffer + fieldsLen, 0, HMAC_SIZE);
 
-    if (data.size() < offset + namelen + 16) {
-        throw std::runtime_error("data too short for name length and hmac");
+        return total;
     }
 
-    p.name.assign(reinterpret_cast<const char*>(&data[offset]), namelen);
-    offset += namelen;
+    // sign directly into the output buffer
+    if (!compute_hmac_sha256_trunc(key, buffer, fieldsLen, buffer + fieldsLen)) {
+        return 0;
+    }
+
+    std::copy(buffer + fieldsLen, buffer + total, this->hmac_.begin());
 
-    // read hmac
-    for (size_t i = 0; i < 16; ++i) {
-        p.hmac_[i] = data[offset++];
+    return total;
+}
+
+size_t Payload::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    const size_t fieldsLen = this->_fields_size();
+    const size_t total = fieldsLen + HMAC_SIZE;
+    if (buffer == nullptr || capacity < total) {
+        return 0;
     }
 
-    if (offset != data.size()) {
-        throw std::runtime_error("extra or missing bytes after parsing hmac");
+    if (!this->_write_fields(buffer) || !signer.sign(buffer, fieldsLen, buffer + fieldsLen)) {
+        return 0;
     }
 
-    return p;
+    std::copy(buffer + fieldsLen, buffer + total, this->hmac_.begin());
+
+    return total;
+}
+
+size_t Payload::serializedSize() const noexcept {
+    return this->_fields_size() + HMAC_SIZE;
 }
 
-std::vector<uint8_t> Position::_serialize_fields() const {
-    std::vector<uint8_t> parts;
+bool Payload::verify(const char* key) const noexcept {
+    if (key == nullptr) {
+        return false;
+    }
 
-    // header
-    push_u8(parts, header);
+    // hmac_ must be set
+    uint8_t expected[16];
+    uint8_t fields[MAX_FIELDS_SIZE];
+
+    const size_t fieldsLen = this->_fields_size();
+    if (fieldsLen > sizeof(fields) || !this->_write_fields(fields)) {
+        return false;
+    }
+
+    if (!compute_hmac_sha256_trunc(key, fields, fieldsLen, expected)) {
+        return false;
+    }
 
-    // interval
-    push_u8(parts, interval);
+    return std::equal(expected, expected + 16, this->hmac_.begin());
+}
 
-    // confidence
-    push_u8(parts, confidence);
+bool Payload::verify(const Signer& signer) const noexcept {
+    uint8_t expected[16];
+    uint8_t fields[MAX_FIELDS_SIZE];
 
-    // satellites
-    push_u8(parts, satellites);
+    const size_t fieldsLen = this->_fields_size();
+    if (fieldsLen > sizeof(fields) || !this->_write_fields(fields)) {
+        return false;
+    }
 
-    // device (6 bytes)
-    parts.insert(parts.end(), device, device + 6);
+    if (!signer.sign(fields, fieldsLen, expected)) {
+        return false;
+    }
 
-    // latitude
-    int32_t lat_int = static_cast<int32_t>(round(latitude * SCALE));
-    push_be_i32(parts, lat_int);
+    return std::equal(expected, expected + 16, this->hmac_.begin());
+}
 
-    // longitude
-    int32_t lon_int = static_cast<int32_t>(round(longitude * SCALE));
-    push_be_i32(parts, lon_int);
+// --- Position --------------------------------------------------------------
 
-        // (timestamp removed)
+#ifndef MESSAGES_NO_EXCEPTIONS
+Position Position::init(const std::vector<uint8_t>& data) {
+    Position p;
 
-    // name
-    if (name.size() > 255) {
-        throw std::runtime_error("name too long; max 255 bytes");
+    DecodeStatus status = Position::decode(data.data(), data.size(), p);
+    if (status != DECODE_STATUS_OK) {
+        throw std::runtime_error(std::string("cannot parse Position: ") + decodeStatusName(status));
     }
 
-    push_u8(parts, static_cast<uint8_t>(name.size()));
-    parts.insert(parts.end(), name.begin(), name.end());
+    return p;
+}
+#endif
+
+static_assert(Position::MAX_SIZE == PositionSchema::min_size + 255 + Payload::HMAC_SIZE, "Position::MAX_SIZE does not match the schema");
+
+DecodeStatus Position::decode(const uint8_t* data, size_t len, Position& out) noexcept {
+    DecodeStatus status = PositionSchema::read(out, data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    std::copy(data + len - HMAC_SIZE, data + len, out.hmac_.begin());
 
-    return parts;
+    return DECODE_STATUS_OK;
 }
 
+size_t Position::_fields_size() const noexcept {
+    return PositionSchema::size(*this);
+}
+
+bool Position::_write_fields(uint8_t* out) const noexcept {
+    return PositionSchema::write(*this, out);
+}
+
+#ifndef MESSAGES_NO_EXCEPTIONS
 std::vector<uint8_t> Position::serialize(const char* key) {
     return Payload::serialize(key);
 }
+#endif
+
+size_t Position::serialize(uint8_t* buffer, size_t capacity, const char* key) noexcept {
+    return Payload::serialize(buffer, capacity, key);
+}
+
+size_t Position::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    return Payload::serialize(buffer, capacity, signer);
+}
 
 void Position::setHeader(bool isValid) {
     header = 0x80;                      // MSB immer 1
@@ -215,63 +403,355 @@ std::string Position::toString() const {
              header, interval, confidence, satellites,
              device[0], device[1], device[2], device[3], device[4], device[5],
              latitude, longitude, name.c_str());
-    
+
     return std::string(buf);
 }
 
-// --- Command ---------------------------------------------------------------
+// --- SessionPosition -------------------------------------------------------
 
-Command Command::init(const std::vector<uint8_t>& data) {
-    const size_t min_fixed = 1 + 1 + 16; // header + arglen + hmac
-    if (data.size() < min_fixed) {
-        throw std::runtime_error("data too short for Command");
+static_assert(SessionPosition::MAX_SIZE == SessionPositionSchema::min_size + 255 + Payload::HMAC_SIZE, "SessionPosition::MAX_SIZE does not match the schema");
+
+DecodeStatus SessionPosition::decode(const uint8_t* data, size_t len, SessionPosition& out) noexcept {
+    DecodeStatus status = SessionPositionSchema::read(out, data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
     }
 
-    size_t offset = 0;
-    Command c;
+    std::copy(data + len - HMAC_SIZE, data + len, out.hmac_.begin());
+
+    return DECODE_STATUS_OK;
+}
+
+size_t SessionPosition::_fields_size() const noexcept {
+    return SessionPositionSchema::size(*this);
+}
+
+bool SessionPosition::_write_fields(uint8_t* out) const noexcept {
+    return SessionPositionSchema::write(*this, out);
+}
+
+size_t SessionPosition::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    return Payload::serialize(buffer, capacity, signer);
+}
+
+void SessionPosition::setHeader(bool isValid) {
+    header = 0x80 | HEADER_SESSION;     // MSB always 1, bit 4 marks the session frame
+    header |= (isValid ? 1 : 0);        // Bit 0 = Flag
+}
+
+void SessionPosition::getHeader(bool &isValid) {
+    isValid = header & 0x01;
+}
+
+std::string SessionPosition::toString() const {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "SessionPosition(header=%u, interval=%u, confidence=%u, satellites=%u, session=%04x, lat=%.7f, lon=%.7f, name=%s)",
+             header, interval, confidence, satellites, session, latitude, longitude, name.c_str());
+
+    return std::string(buf);
+}
+
+// --- PositionBatch ---------------------------------------------------------
+
+static_assert(PositionBatch::MAX_SIZE == SequencedBatchSchema::min_size + (3 + 1 + 1 + 4 + 4) + (PositionBatch::MAX_FIXES - 1) * PositionBatch::COMPACT_FIX_MAX_SIZE + 255 + Payload::HMAC_SIZE,
+              "PositionBatch::MAX_SIZE does not match the schema");
+
+DecodeStatus PositionBatch::decode(const uint8_t* data, size_t len, PositionBatch& out) noexcept {
+    bool sequenced = data != nullptr && len > 0 && (data[0] & HEADER_SEQUENCED);
+    DecodeStatus status = sequenced ? SequencedBatchSchema::read(out, data, len) : PositionBatchSchema::read(out, data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    std::copy(data + len - HMAC_SIZE, data + len, out.hmac_.begin());
+
+    return DECODE_STATUS_OK;
+}
+
+bool PositionBatch::addFix(const Fix& fix) {
+    if (full()) {
+        return false;
+    }
+
+    fixes[count++] = fix;
+    return true;
+}
+
+void PositionBatch::clear() {
+    count = 0;
+}
+
+size_t PositionBatch::_fields_size() const noexcept {
+    return sequenced() ? SequencedBatchSchema::size(*this) : PositionBatchSchema::size(*this);
+}
+
+bool PositionBatch::_write_fields(uint8_t* out) const noexcept {
+    return sequenced() ? SequencedBatchSchema::write(*this, out) : PositionBatchSchema::write(*this, out);
+}
+
+size_t PositionBatch::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    return Payload::serialize(buffer, capacity, signer);
+}
+
+void PositionBatch::setHeader(bool isValid, bool isCompact, bool isSequenced) {
+    header = 0x80 | HEADER_BATCH;                   // MSB always 1, bit 6 = batch
+    header |= (isCompact ? HEADER_COMPACT : 0);     // Bit 5 = compact encoding
+    header |= (isSequenced ? HEADER_SEQUENCED : 0); // Bit 2 = sequence number follows the device
+    header |= (isValid ? 1 : 0);                    // Bit 0 = Flag
+}
+
+void PositionBatch::getHeader(bool &isValid) {
+    isValid = header & 0x01;            // Bit 0 = Flag
+}
+
+void PositionBatch::getHeader(bool &isValid, bool &isCompact) {
+    isValid = header & 0x01;
+    isCompact = header & HEADER_COMPACT;
+}
+
+std::string PositionBatch::toString() const {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "PositionBatch(header=%u, interval=%u, device=[%02x%02x%02x%02x%02x%02x], sequence=%u, count=%u, name=%s)",
+             header, interval,
+             device[0], device[1], device[2], device[3], device[4], device[5],
+             sequence, count, name.c_str());
+
+    return std::string(buf);
+}
+
+// --- Schema::BatchFixes ----------------------------------------------------
+
+// Walk count fixes starting at in, bounds checked against end, and hand every
+// decoded fix to sink(index, fix). in is left on the byte following the fixes.
+// Returns false if the fixes are malformed.
+template<typename Sink>
+static bool walk_batch_fixes(bool compact, const uint8_t*& in, const uint8_t* end, size_t count, Sink sink) {
+    int64_t age = 0;
+    int64_t lat = 0;
+    int64_t lon = 0;
+
+    PositionBatch::Fix fix;
+    for (size_t i = 0; i < count; ++i) {
+        if (!compact) {
+            if (end - in < static_cast<ptrdiff_t>(PositionBatch::FIX_SIZE)) {
+                return false;
+            }
+
+            age = Schema::U16::decode(in);
+            fix.confidence = in[2];
+            fix.satellites = in[3];
+            lat = read_be_i32(in + 4);
+            lon = read_be_i32(in + 8);
+            in += PositionBatch::FIX_SIZE;
+        } else if (i == 0) {
+            uint64_t v = 0;
+            if (!read_varint(in, end, 3, v) || v > UINT16_MAX || end - in < 1 + 1 + 4 + 4) {
+                return false;
+            }
+
+            age = static_cast<int64_t>(v);
+            fix.confidence = in[0];
+            fix.satellites = in[1];
+            lat = read_be_i32(in + 2);
+            lon = read_be_i32(in + 6);
+            in += 1 + 1 + 4 + 4;
+        } else {
+            uint64_t seconds = 0;
+            uint64_t dlat = 0;
+            uint64_t dlon = 0;
+
+            if (!read_varint(in, end, 3, seconds) || end - in < 2) {
+                return false;
+            }
+
+            fix.confidence = in[0];
+            fix.satellites = in[1];
+            in += 2;
+
+            if (!read_varint(in, end, 5, dlat) || !read_varint(in, end, 5, dlon)) {
+                return false;
+            }
+
+            age -= static_cast<int64_t>(seconds);
+            lat += zigzag_decode(dlat);
+            lon += zigzag_decode(dlon);
+
+            if (age < 0 || lat < INT32_MIN || lat > INT32_MAX || lon < INT32_MIN || lon > INT32_MAX) {
+                return false;
+            }
+        }
+
+        fix.age = static_cast<uint16_t>(age);
+        fix.latitude = static_cast<double>(lat) / PositionBatch::SCALE;
+        fix.longitude = static_cast<double>(lon) / PositionBatch::SCALE;
+        sink(i, fix);
+    }
+
+    return true;
+}
+
+namespace Schema {
+
+size_t BatchFixes::size(const PositionBatch& batch) noexcept {
+    // count + fixes
+    if (!(batch.header & PositionBatch::HEADER_COMPACT)) {
+        return 1 + batch.count * PositionBatch::FIX_SIZE;
+    }
+
+    size_t size = 1;
+    for (size_t i = 0; i < batch.count && i < PositionBatch::MAX_FIXES; ++i) {
+        const PositionBatch::Fix* fixes = batch.fixes;
+        if (i == 0) {
+            size += varint_size(fixes[0].age) + 1 + 1 + 4 + 4;
+            continue;
+        }
+
+        const int64_t seconds = static_cast<int64_t>(fixes[i - 1].age) - fixes[i].age;
+        const int64_t dlat = static_cast<int64_t>(scale_coordinate(fixes[i].latitude)) - scale_coordinate(fixes[i - 1].latitude);
+        const int64_t dlon = static_cast<int64_t>(scale_coordinate(fixes[i].longitude)) - scale_coordinate(fixes[i - 1].longitude);
+
+        size += varint_size(seconds < 0 ? 0 : seconds) + 1 + 1 + varint_size(zigzag_encode(dlat)) + varint_size(zigzag_encode(dlon));
+    }
+
+    return size;
+}
+
+bool BatchFixes::write(const PositionBatch& batch, uint8_t*& out) noexcept {
+    if (batch.count == 0 || batch.count > PositionBatch::MAX_FIXES) {
+        return false;
+    }
+
+    write_u8(out, batch.count);
+
+    const PositionBatch::Fix* fixes = batch.fixes;
+    const bool compact = batch.header & PositionBatch::HEADER_COMPACT;
+    for (size_t i = 0; i < batch.count; ++i) {
+        const PositionBatch::Fix& fix = fixes[i];
+
+        if (!compact) {
+            write_be_u16(out, fix.age);
+            write_u8(out, fix.confidence);
+            write_u8(out, fix.satellites);
+            write_be_i32(out, scale_coordinate(fix.latitude));
+            write_be_i32(out, scale_coordinate(fix.longitude));
+        } else if (i == 0) {
+            write_varint(out, fix.age);
+            write_u8(out, fix.confidence);
+            write_u8(out, fix.satellites);
+            write_be_i32(out, scale_coordinate(fix.latitude));
+            write_be_i32(out, scale_coordinate(fix.longitude));
+        } else {
+            // fixes must be ordered oldest first
+            if (fixes[i - 1].age < fix.age) {
+                return false;
+            }
+
+            write_varint(out, fixes[i - 1].age - fix.age);
+            write_u8(out, fix.confidence);
+            write_u8(out, fix.satellites);
+            write_varint(out, zigzag_encode(static_cast<int64_t>(scale_coordinate(fix.latitude)) - scale_coordinate(fixes[i - 1].latitude)));
+            write_varint(out, zigzag_encode(static_cast<int64_t>(scale_coordinate(fix.longitude)) - scale_coordinate(fixes[i - 1].longitude)));
+        }
+    }
+
+    return true;
+}
+
+DecodeStatus BatchFixes::skip(const uint8_t* frame, const uint8_t*& in, const uint8_t* end) noexcept {
+    if (end - in < 1 || in[0] == 0 || in[0] > PositionBatch::MAX_FIXES) {
+        return DECODE_STATUS_BAD_LENGTH;
+    }
 
-    c.header = data[offset++];
+    const uint8_t* p = in + 1;
+    if (!walk_batch_fixes(frame[0] & PositionBatch::HEADER_COMPACT, p, end, in[0], [](size_t, const PositionBatch::Fix&) {})) {
+        return DECODE_STATUS_BAD_LENGTH;
+    }
 
-    uint8_t arglen = data[offset++];
+    in = p;
+    return DECODE_STATUS_OK;
+}
 
-    if (data.size() < offset + arglen + 16) {
-        //throw std::runtime_error("data too short for arg length and hmac");
-        printf("data too short for arg length and hmac");
+DecodeStatus BatchFixes::read(PositionBatch& batch, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+    if (end - in < 1 || in[0] == 0 || in[0] > PositionBatch::MAX_FIXES) {
+        return DECODE_STATUS_BAD_LENGTH;
     }
 
-    c.arg.assign(reinterpret_cast<const char*>(&data[offset]), arglen);
-    offset += arglen;
-    
-    for (size_t i = 0; i < 16; ++i) {
-        c.hmac_[i] = data[offset++];
+    const uint8_t count = in[0];
+    const uint8_t* p = in + 1;
+    if (!walk_batch_fixes(frame[0] & PositionBatch::HEADER_COMPACT, p, end, count, [&batch](size_t i, const PositionBatch::Fix& fix) { batch.fixes[i] = fix; })) {
+        return DECODE_STATUS_BAD_LENGTH;
     }
 
-    if (offset != data.size()) {
-        //throw std::runtime_error("extra or missing bytes after parsing hmac");
-        printf("extra or missing bytes after parsing hmac");
+    batch.count = count;
+    in = p;
+    return DECODE_STATUS_OK;
+}
+
+PositionBatch::Fix BatchFixes::fix(const uint8_t* frame, const uint8_t* in, const uint8_t* end, size_t index) noexcept {
+    PositionBatch::Fix out;
+
+    // compact fixes are deltas, so walk up to and including index
+    const uint8_t* p = in + 1;
+    walk_batch_fixes(frame[0] & PositionBatch::HEADER_COMPACT, p, end, index + 1, [&out, index](size_t i, const PositionBatch::Fix& fix) {
+        if (i == index) {
+            out = fix;
+        }
+    });
+
+    return out;
+}
+
+} // namespace Schema
+
+// --- Command ---------------------------------------------------------------
+
+#ifndef MESSAGES_NO_EXCEPTIONS
+Command Command::init(const std::vector<uint8_t>& data) {
+    Command c;
+
+    DecodeStatus status = Command::decode(data.data(), data.size(), c);
+    if (status != DECODE_STATUS_OK) {
+        throw std::runtime_error(std::string("cannot parse Command: ") + decodeStatusName(status));
     }
 
     return c;
 }
+#endif
 
-std::vector<uint8_t> Command::_serialize_fields() const {
-    std::vector<uint8_t> parts;
-    
-    push_u8(parts, header);
-    
-    if (arg.size() > 255) {
-        throw std::runtime_error("arg too long; max 255 bytes");
+static_assert(Command::MAX_SIZE == CommandSchema::min_size + 255 + Payload::HMAC_SIZE, "Command::MAX_SIZE does not match the schema");
+
+DecodeStatus Command::decode(const uint8_t* data, size_t len, Command& out) noexcept {
+    DecodeStatus status = CommandSchema::read(out, data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
     }
 
-    push_u8(parts, static_cast<uint8_t>(arg.size()));
-    parts.insert(parts.end(), arg.begin(), arg.end());
-    
-    return parts;
+    std::copy(data + len - HMAC_SIZE, data + len, out.hmac_.begin());
+
+    return DECODE_STATUS_OK;
 }
 
+size_t Command::_fields_size() const noexcept {
+    return CommandSchema::size(*this);
+}
+
+bool Command::_write_fields(uint8_t* out) const noexcept {
+    return CommandSchema::write(*this, out);
+}
+
+#ifndef MESSAGES_NO_EXCEPTIONS
 std::vector<uint8_t> Command::serialize(const char* key) {
     return Payload::serialize(key);
 }
+#endif
+
+size_t Command::serialize(uint8_t* buffer, size_t capacity, const char* key) noexcept {
+    return Payload::serialize(buffer, capacity, key);
+}
+
+size_t Command::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    return Payload::serialize(buffer, capacity, signer);
+}
 
 void Command::setHeader(CommandAction action) {
     header = 0x80;                     // MSB always 1
@@ -285,8 +765,370 @@ void Command::getHeader(CommandAction &action) {
 std::string Command::toString() const {
     char buf[200];
     snprintf(buf, sizeof(buf), "Command(header=%u, arglen=%zu, arg=%s)", header, arg.size(), arg.c_str());
-    
+
     return std::string(buf);
 }
 
+// --- Telemetry -------------------------------------------------------------
+
+static_assert(TELEMETRY_PHASE_COUNT <= Telemetry::MAX_PHASES, "Telemetry::MAX_PHASES is too small for all phases");
+static_assert(Telemetry::MAX_SIZE == TelemetrySchema::min_size + Telemetry::MAX_PHASES * Telemetry::PHASE_SIZE + Payload::HMAC_SIZE, "Telemetry::MAX_SIZE does not match the schema");
+static_assert(Telemetry::MAX_SIZE - Payload::HMAC_SIZE <= Payload::MAX_FIELDS_SIZE, "Telemetry does not fit into Payload::MAX_FIELDS_SIZE");
+
+DecodeStatus Telemetry::decode(const uint8_t* data, size_t len, Telemetry& out) noexcept {
+    DecodeStatus status = TelemetrySchema::read(out, data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    std::copy(data + len - HMAC_SIZE, data + len, out.hmac_.begin());
+
+    return DECODE_STATUS_OK;
+}
+
+size_t Telemetry::_fields_size() const noexcept {
+    return TelemetrySchema::size(*this);
+}
+
+bool Telemetry::_write_fields(uint8_t* out) const noexcept {
+    return TelemetrySchema::write(*this, out);
+}
+
+size_t Telemetry::serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept {
+    return Payload::serialize(buffer, capacity, signer);
+}
+
+void Telemetry::setHeader() {
+    header = 0x80 | HEADER_TELEMETRY;   // MSB always 1, bit 3 = telemetry
+}
+
+std::string Telemetry::toString() const {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "Telemetry(header=%u, device=[%02x%02x%02x%02x%02x%02x], window=%u, awake=%u, restarts=%u, crashes=%u, phases=%u)",
+             header,
+             device[0], device[1], device[2], device[3], device[4], device[5],
+             (unsigned)window, (unsigned)awake, restarts, crashes, count);
+
+    return std::string(buf);
+}
+
+namespace Schema {
+
+size_t TelemetryPhases::size(const Telemetry& telemetry) noexcept {
+    return 1 + telemetry.count * Telemetry::PHASE_SIZE;
+}
+
+bool TelemetryPhases::write(const Telemetry& telemetry, uint8_t*& out) noexcept {
+    if (telemetry.count > Telemetry::MAX_PHASES) {
+        return false;
+    }
+
+    write_u8(out, telemetry.count);
+
+    for (size_t i = 0; i < telemetry.count; ++i) {
+        const Telemetry::Phase& phase = telemetry.phases[i];
+
+        U16::write(phase.samples, out);
+        U32::write(phase.totalMillis, out);
+        U32::write(phase.maxMillis, out);
+        U32::write(phase.charge, out);
+        for (uint16_t bucket : phase.buckets) {
+            U16::write(bucket, out);
+        }
+    }
+
+    return true;
+}
+
+DecodeStatus TelemetryPhases::skip(const uint8_t*, const uint8_t*& in, const uint8_t* end) noexcept {
+    if (end - in < 1 || end - in - 1 < static_cast<ptrdiff_t>(in[0] * Telemetry::PHASE_SIZE)) {
+        return DECODE_STATUS_BAD_LENGTH;
+    }
+
+    in += 1 + in[0] * Telemetry::PHASE_SIZE;
+    return DECODE_STATUS_OK;
+}
+
+DecodeStatus TelemetryPhases::read(Telemetry& telemetry, const uint8_t* frame, const uint8_t*& in, const uint8_t* end) {
+    const uint8_t* start = in;
+    DecodeStatus status = skip(frame, in, end);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    // phases of newer firmware are skipped
+    telemetry.count = std::min<uint8_t>(start[0], Telemetry::MAX_PHASES);
+
+    const uint8_t* p = start + 1;
+    for (size_t i = 0; i < telemetry.count; ++i, p += Telemetry::PHASE_SIZE) {
+        Telemetry::Phase& phase = telemetry.phases[i];
+
+        phase.samples = U16::decode(p);
+        phase.totalMillis = U32::decode(p + 2);
+        phase.maxMillis = U32::decode(p + 6);
+        phase.charge = U32::decode(p + 10);
+        for (size_t b = 0; b < Telemetry::BUCKETS; ++b) {
+            phase.buckets[b] = U16::decode(p + 14 + 2 * b);
+        }
+    }
+
+    return DECODE_STATUS_OK;
+}
+
+} // namespace Schema
+
+// --- PositionView ----------------------------------------------------------
+
+// the inline accessors in Messages.h read these offsets directly
+static_assert(PositionSchema::offset_of<PositionFields::Interval>() == 1 &&
+              PositionSchema::offset_of<PositionFields::Confidence>() == 2 &&
+              PositionSchema::offset_of<PositionFields::Satellites>() == 3 &&
+              PositionSchema::offset_of<PositionFields::Device>() == 4,
+              "PositionView accessors do not match the schema");
+
+DecodeStatus PositionView::init(const uint8_t* data, size_t len) noexcept {
+    data_ = nullptr;
+    size_ = 0;
+
+    // batch and session frames are rejected by the header rule and decoded by their own views
+    DecodeStatus status = PositionSchema::check(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    data_ = data;
+    size_ = len;
+
+    return DECODE_STATUS_OK;
+}
+
+DecodeStatus PositionView::decode(const uint8_t* data, size_t len, const Signer& signer) noexcept {
+    DecodeStatus status = init(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    if (!verify(signer)) {
+        data_ = nullptr;
+        size_ = 0;
+
+        return DECODE_STATUS_BAD_MAC;
+    }
+
+    return DECODE_STATUS_OK;
+}
+
+int32_t PositionView::latitudeRaw() const noexcept {
+    return read_be_i32(data_ + PositionSchema::offset_of<PositionFields::Latitude>());
+}
+
+int32_t PositionView::longitudeRaw() const noexcept {
+    return read_be_i32(data_ + PositionSchema::offset_of<PositionFields::Longitude>());
+}
+
+double PositionView::latitude() const noexcept {
+    return static_cast<double>(latitudeRaw()) / Position::SCALE;
+}
+
+double PositionView::longitude() const noexcept {
+    return static_cast<double>(longitudeRaw()) / Position::SCALE;
+}
+
+std::string_view PositionView::name() const noexcept {
+    constexpr size_t offset = PositionSchema::offset_of<PositionFields::Name>();
+    return std::string_view(reinterpret_cast<const char*>(data_ + offset + 1), data_[offset]);
+}
+
+void PositionView::getHeader(bool &isValid) const noexcept {
+    isValid = header() & 0x01;
+}
+
+bool PositionView::verify(const Signer& signer) const noexcept {
+    return valid() && verify_trailing_hmac(signer, data_, size_);
+}
+
+// --- SessionPositionView ---------------------------------------------------
+
+static_assert(SessionPositionSchema::offset_of<SessionPositionFields::Interval>() == 1 &&
+              SessionPositionSchema::offset_of<SessionPositionFields::Confidence>() == 2 &&
+              SessionPositionSchema::offset_of<SessionPositionFields::Satellites>() == 3,
+              "SessionPositionView accessors do not match the schema");
+
+DecodeStatus SessionPositionView::init(const uint8_t* data, size_t len) noexcept {
+    data_ = nullptr;
+    size_ = 0;
+
+    DecodeStatus status = SessionPositionSchema::check(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    data_ = data;
+    size_ = len;
+
+    return DECODE_STATUS_OK;
+}
+
+DecodeStatus SessionPositionView::decode(const uint8_t* data, size_t len, const Signer& signer) noexcept {
+    DecodeStatus status = init(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    if (!verify(signer)) {
+        data_ = nullptr;
+        size_ = 0;
+
+        return DECODE_STATUS_BAD_MAC;
+    }
+
+    return DECODE_STATUS_OK;
+}
+
+uint16_t SessionPositionView::session() const noexcept {
+    return Schema::U16::decode(data_ + SessionPositionSchema::offset_of<SessionPositionFields::Session>());
+}
+
+int32_t SessionPositionView::latitudeRaw() const noexcept {
+    return read_be_i32(data_ + SessionPositionSchema::offset_of<SessionPositionFields::Latitude>());
+}
+
+int32_t SessionPositionView::longitudeRaw() const noexcept {
+    return read_be_i32(data_ + SessionPositionSchema::offset_of<SessionPositionFields::Longitude>());
+}
+
+double SessionPositionView::latitude() const noexcept {
+    return static_cast<double>(latitudeRaw()) / SessionPosition::SCALE;
+}
+
+double SessionPositionView::longitude() const noexcept {
+    return static_cast<double>(longitudeRaw()) / SessionPosition::SCALE;
+}
+
+std::string_view SessionPositionView::name() const noexcept {
+    constexpr size_t offset = SessionPositionSchema::offset_of<SessionPositionFields::Name>();
+    return std::string_view(reinterpret_cast<const char*>(data_ + offset + 1), data_[offset]);
+}
+
+void SessionPositionView::getHeader(bool &isValid) const noexcept {
+    isValid = header() & 0x01;
+}
+
+bool SessionPositionView::verify(const Signer& signer) const noexcept {
+    return valid() && verify_trailing_hmac(signer, data_, size_);
+}
+
+// --- PositionBatchView -----------------------------------------------------
+
+static_assert(PositionBatchSchema::offset_of<PositionBatchFields::Interval>() == 1 &&
+              PositionBatchSchema::offset_of<PositionBatchFields::Device>() == 2 &&
+              PositionBatchSchema::offset_of<PositionBatchFields::Fixes>() == 8,
+              "PositionBatchView accessors do not match the schema");
+
+DecodeStatus PositionBatchView::init(const uint8_t* data, size_t len) noexcept {
+    data_ = nullptr;
+    size_ = 0;
+    nameOffset_ = 0;
+
+    DecodeStatus status = PositionBatchSchema::check(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    // already validated, only locate the name behind the fixes
+    const uint8_t* in = data + PositionBatchSchema::offset_of<PositionBatchFields::Fixes>();
+    Schema::BatchFixes::skip(data, in, data + len - Payload::HMAC_SIZE);
+
+    data_ = data;
+    size_ = len;
+    nameOffset_ = static_cast<size_t>(in - data);
+
+    return DECODE_STATUS_OK;
+}
+
+DecodeStatus PositionBatchView::decode(const uint8_t* data, size_t len, const Signer& signer) noexcept {
+    DecodeStatus status = init(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    if (!verify(signer)) {
+        data_ = nullptr;
+        size_ = 0;
+
+        return DECODE_STATUS_BAD_MAC;
+    }
+
+    return DECODE_STATUS_OK;
+}
+
+PositionBatch::Fix PositionBatchView::fix(size_t index) const noexcept {
+    // already validated by init()
+    return Schema::BatchFixes::fix(data_, data_ + PositionBatchSchema::offset_of<PositionBatchFields::Fixes>(), data_ + nameOffset_, index);
+}
+
+std::string_view PositionBatchView::name() const noexcept {
+    return std::string_view(reinterpret_cast<const char*>(data_ + nameOffset_ + 1), data_[nameOffset_]);
+}
+
+void PositionBatchView::getHeader(bool &isValid) const noexcept {
+    isValid = header() & 0x01;
+}
+
+void PositionBatchView::getHeader(bool &isValid, bool &isCompact) const noexcept {
+    isValid = header() & 0x01;
+    isCompact = header() & PositionBatch::HEADER_COMPACT;
+}
+
+bool PositionBatchView::verify(const Signer& signer) const noexcept {
+    return valid() && verify_trailing_hmac(signer, data_, size_);
+}
+
+// --- CommandView -----------------------------------------------------------
+
+DecodeStatus CommandView::init(const uint8_t* data, size_t len) noexcept {
+    data_ = nullptr;
+    size_ = 0;
+
+    // the header rule requires the MSB and a known action
+    DecodeStatus status = CommandSchema::check(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    data_ = data;
+    size_ = len;
+
+    return DECODE_STATUS_OK;
+}
+
+DecodeStatus CommandView::decode(const uint8_t* data, size_t len, const Signer& signer) noexcept {
+    DecodeStatus status = init(data, len);
+    if (status != DECODE_STATUS_OK) {
+        return status;
+    }
+
+    if (!verify(signer)) {
+        data_ = nullptr;
+        size_ = 0;
+
+        return DECODE_STATUS_BAD_MAC;
+    }
+
+    return DECODE_STATUS_OK;
+}
+
+std::string_view CommandView::arg() const noexcept {
+    constexpr size_t offset = CommandSchema::offset_of<CommandFields::Arg>();
+    return std::string_view(reinterpret_cast<const char*>(data_ + offset + 1), data_[offset]);
+}
+
+void CommandView::getHeader(CommandAction &action) const noexcept {
+    action = (CommandAction)(header() & 0x0F);
+}
+
+bool CommandView::verify(const Signer& signer) const noexcept {
+    return valid() && verify_trailing_hmac(signer, data_, size_);
+}
+
 } // namespace Messages
@@ -4,11 +4,29 @@
 #include <array>
 #include <vector>
 #include <string>
-#include <stdexcept>
+#include <string_view>
 #include <algorithm>
 
-// Messages.h - generated from service/python/data.py
-// Target: ESP32 (uses mbedTLS for HMAC-SHA256)
+#include "Sha256.h"
+
+// Messages.h - message types of the Waltrac wire protocol
+// Target: ESP32 (HMAC-SHA256 on mbedTLS), host builds select another backend in Sha256.h
+// The wire layout of every message is defined in MessageSchema.h.
+
+// The decode path (views, decode(), verify()) is noexcept and reports errors as
+// DecodeStatus. The views never allocate. The static decode() of the owning
+// types copies string fields into std::string, and if that allocation fails the
+// program terminates, as it does in a build without exceptions. The throwing
+// convenience API (Position::init, Command::init and the vector returning
+// serialize) is only available when exceptions are enabled. Building with
+// -fno-exceptions or defining MESSAGES_NO_EXCEPTIONS removes it.
+#if !defined(MESSAGES_NO_EXCEPTIONS) && !defined(__cpp_exceptions)
+#define MESSAGES_NO_EXCEPTIONS
+#endif
+
+#ifndef MESSAGES_NO_EXCEPTIONS
+#include <stdexcept>
+#endif
 
 namespace Messages {
 
@@ -17,27 +35,120 @@ typedef enum
     COMMAND_ACTION_DISCOVER,
     COMMAND_ACTION_SETINTERVAL,
     COMMAND_ACTION_SETNAME,
-    COMMAND_ACTION_EXIT
+    COMMAND_ACTION_EXIT,
+    COMMAND_ACTION_SETSESSION,      // arg: session ID in decimal, answer to DISCOVER
+    COMMAND_ACTION_ACK              // arg: sequence number following the last fix received in decimal, answer to a sequenced batch
 } CommandAction;
 
+// Phases of a tracker cycle reported in a Telemetry frame, in wire order.
+typedef enum
+{
+    TELEMETRY_PHASE_CLOCK,          // validation (and sync) of the GNSS clock
+    TELEMETRY_PHASE_ASSISTANCE,     // check and download of GNSS assistance data
+    TELEMETRY_PHASE_ATTACH,         // LTE attach up to the registration
+    TELEMETRY_PHASE_DETACH,         // LTE detach until the modem stopped searching
+    TELEMETRY_PHASE_GNSS,           // one GNSS acquisition attempt
+    TELEMETRY_PHASE_SEND,           // one CoAP send
+    TELEMETRY_PHASE_COUNT
+} TelemetryPhase;
+
+typedef enum
+{
+    DECODE_STATUS_OK,
+    DECODE_STATUS_TOO_SHORT,        // fewer bytes than the fixed part of the message
+    DECODE_STATUS_BAD_LENGTH,       // a length field points past the end of the frame
+    DECODE_STATUS_TRAILING_BYTES,   // bytes left over after the trailing HMAC
+    DECODE_STATUS_BAD_HEADER,       // header marker bit missing or unknown header value
+    DECODE_STATUS_BAD_MAC           // HMAC does not match the frame
+} DecodeStatus;
+
+// Human readable name of a decode status, for logging.
+const char* decodeStatusName(DecodeStatus status) noexcept;
+
+// Short name of a telemetry phase, also used by the generated decoders.
+const char* telemetryPhaseName(TelemetryPhase phase) noexcept;
+
+// HMAC-SHA256 signer with a precomputed key schedule.
+// The key is absorbed once and the SHA-256 midstates after the ipad and opad
+// blocks are kept, so every message only costs its own blocks plus the outer
+// block. Not thread-safe: sign() reuses an internal scratch context.
+class Signer {
+public:
+    Signer() = default;
+    explicit Signer(const char* key) noexcept;
+    Signer(const uint8_t* key, size_t keylen) noexcept;
+    ~Signer();
+
+    Signer(const Signer&) = delete;
+    Signer& operator=(const Signer&) = delete;
+
+    // (Re)load the key. Returns false if the hash contexts cannot be set up.
+    bool setKey(const char* key) noexcept;
+    bool setKey(const uint8_t* key, size_t keylen) noexcept;
+
+    bool hasKey() const noexcept { return ready_; }
+
+    // Compute the truncated 16-byte HMAC over data.
+    // Returns false if no key is loaded or the digest fails.
+    bool sign(const uint8_t* data, size_t datalen, uint8_t out16[16]) const noexcept;
+
+private:
+    void release() noexcept;
+
+    Sha256 inner_;                  // state after absorbing key ^ ipad
+    Sha256 outer_;                  // state after absorbing key ^ opad
+    mutable Sha256 work_;
+    bool ready_ = false;
+};
+
 class Payload {
 public:
+    static constexpr size_t HMAC_SIZE = 16;
+
+    // Largest field section of any message (compact sequenced PositionBatch with 16 worst case fixes and a 255 byte name).
+    static constexpr size_t MAX_FIELDS_SIZE = 1 + 1 + 6 + 2 + 1 + (3 + 1 + 1 + 4 + 4) + 15 * (3 + 1 + 1 + 5 + 5) + 1 + 255;
+
     virtual ~Payload() = default;
 
+#ifndef MESSAGES_NO_EXCEPTIONS
     // Serialize full message including trailing 16-byte HMAC.
     // If key == nullptr, append 16 zero bytes instead of HMAC.
     // Accept a raw C string to avoid constructing a std::string on Arduino.
     std::vector<uint8_t> serialize(const char* key = nullptr);
+#endif
+
+    // Serialize full message into a caller-provided buffer.
+    // Returns the number of bytes written, or 0 if the message does not fit into
+    // capacity or cannot be encoded (e.g. a string field longer than 255 bytes).
+    // The key schedule of the last key up to a block long is cached. Setting it
+    // up for another key allocates on the mbedTLS and OpenSSL backends, like
+    // every call with a longer key or while another thread holds the cache.
+    // A Signer avoids both and the key comparison.
+    size_t serialize(uint8_t* buffer, size_t capacity, const char* key = nullptr) noexcept;
+
+    // Same as above, but sign with a precomputed key schedule.
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
+
+    // Exact number of bytes serialize() produces for the current field values.
+    size_t serializedSize() const noexcept;
 
     // Verify stored HMAC against provided key. Accept raw C string for Arduino.
-    bool verify(const char* key) const;
+    // Returns false if key is null. Shares the key cache of serialize().
+    bool verify(const char* key) const noexcept;
+
+    // Verify stored HMAC with a precomputed key schedule.
+    bool verify(const Signer& signer) const noexcept;
 
 protected:
-    // Subclasses implement this to return the bytes that should be signed
-    // (all fields except the trailing HMAC).
-    virtual std::vector<uint8_t> _serialize_fields() const = 0;
+    // Subclasses return the number of bytes that _write_fields() will write.
+    virtual size_t _fields_size() const noexcept = 0;
 
-    mutable std::array<uint8_t, 16> hmac_{};
+    // Subclasses write the bytes that should be signed (all fields except the
+    // trailing HMAC) to out, which holds at least _fields_size() bytes.
+    // Returns false if the fields cannot be encoded.
+    virtual bool _write_fields(uint8_t* out) const noexcept = 0;
+
+    mutable std::array<uint8_t, HMAC_SIZE> hmac_{};
 };
 
 
@@ -45,6 +156,9 @@ class Position : public Payload {
 public:
     static constexpr double SCALE = 1e7;
 
+    // Size of a serialized Position with the longest possible name.
+    static constexpr size_t MAX_SIZE = 1 + 1 + 1 + 1 + 6 + 4 + 4 + 1 + 255 + HMAC_SIZE;
+
     // fields in order: header, interval, confidence, satellites, device(6), latitude, longitude, namelen, name, hmac
     uint8_t header = 0;
     uint8_t interval = 0;
@@ -59,11 +173,20 @@ public:
 
     Position() = default;
 
+#ifndef MESSAGES_NO_EXCEPTIONS
     // Parse from raw bytes (throws std::runtime_error on error)
     static Position init(const std::vector<uint8_t>& data);
+#endif
+
+    // Parse from raw bytes into out. The HMAC is not checked, use verify() afterwards.
+    static DecodeStatus decode(const uint8_t* data, size_t len, Position& out) noexcept;
 
+#ifndef MESSAGES_NO_EXCEPTIONS
     // Serialize full message (fields + 16-byte HMAC) — delegates to Payload::serialize
     std::vector<uint8_t> serialize(const char* key = nullptr);
+#endif
+    size_t serialize(uint8_t* buffer, size_t capacity, const char* key = nullptr) noexcept;
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
 
     // Set the header byte by its parameters
     void setHeader(bool isValid);
@@ -72,7 +195,146 @@ public:
     void getHeader(bool &isValid);
 
 protected:
-    std::vector<uint8_t> _serialize_fields() const override;
+    size_t _fields_size() const noexcept override;
+    bool _write_fields(uint8_t* out) const noexcept override;
+
+public:
+    std::string toString() const;
+};
+
+
+// Position of a device that got a session ID from the server in answer to its
+// DISCOVER command. The session replaces the device MAC, and the name is only
+// sent when it changed since the last frame of the session.
+// fields in order: header, interval, confidence, satellites, session(2), latitude, longitude, namelen, name, hmac
+// An empty name leaves the name known to the server unchanged.
+class SessionPosition : public Payload {
+public:
+    static constexpr double SCALE = Position::SCALE;
+
+    // Header bit 4 marks a session frame among the position frames.
+    static constexpr uint8_t HEADER_SESSION = 0x10;
+
+    // Size of a serialized SessionPosition with the longest possible name.
+    static constexpr size_t MAX_SIZE = 1 + 1 + 1 + 1 + 2 + 4 + 4 + 1 + 255 + HMAC_SIZE;
+
+    uint8_t header = 0;
+    uint8_t interval = 0;
+    uint8_t confidence = 0;
+    uint8_t satellites = 0;
+    uint16_t session = 0;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    std::string name;
+
+    SessionPosition() = default;
+
+    // Parse from raw bytes into out. The HMAC is not checked, use verify() afterwards.
+    static DecodeStatus decode(const uint8_t* data, size_t len, SessionPosition& out) noexcept;
+
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
+
+    // Set the header byte by its parameters
+    void setHeader(bool isValid);
+
+    // Get the header params
+    void getHeader(bool &isValid);
+
+protected:
+    size_t _fields_size() const noexcept override;
+    bool _write_fields(uint8_t* out) const noexcept override;
+
+public:
+    std::string toString() const;
+};
+
+
+// Several fixes of one device in a single frame under one HMAC, so a batch
+// costs only one radio attach and one CoAP round trip.
+// fields in order: header, interval, device(6), count, count * fix, namelen, name, hmac
+// with fix: age(2), confidence, satellites, latitude, longitude
+//
+// In compact mode (header bit 5) the first fix is sent as
+//   age(varint), confidence, satellites, latitude(4), longitude(4)
+// and every following fix as deltas to its predecessor
+//   seconds(varint), confidence, satellites, latitude(zigzag varint), longitude(zigzag varint)
+// where latitude/longitude are the scaled integers and seconds is the time since the previous fix.
+//
+// A sequenced batch (header bit 2) carries the sequence number of its first fix
+// after the device, the following fixes are numbered consecutively:
+//   header, interval, device(6), sequence(2), count, count * fix, namelen, name, hmac
+// It is sent without CoAP confirmation, the receiver answers with an ACK command.
+class PositionBatch : public Payload {
+public:
+    static constexpr double SCALE = Position::SCALE;
+
+    static constexpr uint8_t MAX_FIXES = 16;
+
+    // Header bit 6 marks a batch frame among the position frames.
+    static constexpr uint8_t HEADER_BATCH = 0x40;
+
+    // Header bit 5 selects the compact delta/varint encoding of the fixes.
+    static constexpr uint8_t HEADER_COMPACT = 0x20;
+
+    // Header bit 2 marks a sequenced batch.
+    static constexpr uint8_t HEADER_SEQUENCED = 0x04;
+
+    // A sequenced batch starting further than this behind the sequence a receiver
+    // expects next comes from a device that started its numbering over.
+    static constexpr uint16_t SEQUENCE_WINDOW = 1024;
+
+    // Size of a serialized fix inside the batch.
+    static constexpr size_t FIX_SIZE = 2 + 1 + 1 + 4 + 4;
+
+    // Worst case size of a delta encoded fix in compact mode.
+    static constexpr size_t COMPACT_FIX_MAX_SIZE = 3 + 1 + 1 + 5 + 5;
+
+    // Size of a serialized sequenced PositionBatch with MAX_FIXES worst case fixes and the longest possible name.
+    static constexpr size_t MAX_SIZE = MAX_FIELDS_SIZE + HMAC_SIZE;
+
+    struct Fix {
+        uint16_t age = 0;           // seconds between the fix and the transmission of the frame
+        uint8_t confidence = 0;
+        uint8_t satellites = 0;
+        double latitude = 0.0;
+        double longitude = 0.0;
+    };
+
+    uint8_t header = 0;
+    uint8_t interval = 0;
+    uint8_t device[6] = {0};
+    uint16_t sequence = 0;          // sequenced batches only, sequence number of fixes[0]
+    uint8_t count = 0;
+    Fix fixes[MAX_FIXES];           // oldest fix first
+    std::string name;
+
+    PositionBatch() = default;
+
+    // Parse from raw bytes into out. The HMAC is not checked, use verify() afterwards.
+    static DecodeStatus decode(const uint8_t* data, size_t len, PositionBatch& out) noexcept;
+
+    // Append a fix. Returns false if the batch is full.
+    bool addFix(const Fix& fix);
+
+    // Drop all fixes.
+    void clear();
+
+    bool full() const { return count >= MAX_FIXES; }
+
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
+
+    // Set the header byte by its parameters
+    void setHeader(bool isValid, bool isCompact = false, bool isSequenced = false);
+
+    // Get the header params
+    void getHeader(bool &isValid);
+    void getHeader(bool &isValid, bool &isCompact);
+
+    bool sequenced() const { return header & HEADER_SEQUENCED; }
+
+protected:
+    size_t _fields_size() const noexcept override;
+    bool _write_fields(uint8_t* out) const noexcept override;
 
 public:
     std::string toString() const;
@@ -81,16 +343,28 @@ public:
 
 class Command : public Payload {
 public:
+    // Size of a serialized Command with the longest possible argument.
+    static constexpr size_t MAX_SIZE = 1 + 1 + 255 + HMAC_SIZE;
+
     uint8_t header = 0;
     std::string arg;
 
     Command() = default;
 
+#ifndef MESSAGES_NO_EXCEPTIONS
     // Parse from raw bytes (throws std::runtime_error on error)
     static Command init(const std::vector<uint8_t>& data);
+#endif
+
+    // Parse from raw bytes into out. The HMAC is not checked, use verify() afterwards.
+    static DecodeStatus decode(const uint8_t* data, size_t len, Command& out) noexcept;
 
+#ifndef MESSAGES_NO_EXCEPTIONS
     // Serialize full message (fields + 16-byte HMAC) — delegates to Payload::serialize
     std::vector<uint8_t> serialize(const char* key = nullptr);
+#endif
+    size_t serialize(uint8_t* buffer, size_t capacity, const char* key = nullptr) noexcept;
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
 
     // Set the header byte by its parameters
     void setHeader(CommandAction action);
@@ -99,10 +373,245 @@ public:
     void getHeader(CommandAction &action);
 
 protected:
-    std::vector<uint8_t> _serialize_fields() const override;
+    size_t _fields_size() const noexcept override;
+    bool _write_fields(uint8_t* out) const noexcept override;
+
+public:
+    std::string toString() const;
+};
+
+
+// Summary of where a device spent its time and charge since the last
+// Telemetry frame, sent to its own resource every few hours.
+// fields in order: header, device(6), window(4), awake(4), restarts(2), crashes(2),
+//                  gnssRetries(2), gnssTimeouts(2), attachFailures(2), sendFailures(2),
+//                  count, count * phase, hmac
+// with phase: samples(2), totalMillis(4), maxMillis(4), charge(4), BUCKETS * bucket(2)
+// Phases are in TelemetryPhase order, decoders ignore phases they do not know.
+// Bucket i counts the samples below BUCKET_BASE_MILLIS << i, the last bucket
+// the rest. Counts saturate at 65535.
+class Telemetry : public Payload {
+public:
+    static constexpr uint8_t MAX_PHASES = 8;
+
+    static constexpr uint8_t BUCKETS = 10;
+
+    static constexpr uint32_t BUCKET_BASE_MILLIS = 125;
+
+    // Header bit 3 marks a telemetry frame, position frames never set it.
+    static constexpr uint8_t HEADER_TELEMETRY = 0x08;
+
+    // Size of a serialized phase.
+    static constexpr size_t PHASE_SIZE = 2 + 4 + 4 + 4 + BUCKETS * 2;
+
+    // Size of a serialized Telemetry with MAX_PHASES phases.
+    static constexpr size_t MAX_SIZE = 1 + 6 + 4 + 4 + 6 * 2 + 1 + MAX_PHASES * PHASE_SIZE + HMAC_SIZE;
+
+    struct Phase {
+        uint16_t samples = 0;
+        uint32_t totalMillis = 0;   // wall time of all samples, nested phases included
+        uint32_t maxMillis = 0;
+        uint32_t charge = 0;        // estimated charge in uAh, nested phases excluded
+        uint16_t buckets[BUCKETS] = {0};
+    };
+
+    uint8_t header = 0;
+    uint8_t device[6] = {0};
+    uint32_t window = 0;            // seconds covered by this frame
+    uint32_t awake = 0;             // seconds the ESP32 was awake within the window
+    uint16_t restarts = 0;          // software restarts of the firmware
+    uint16_t crashes = 0;           // panics, watchdog and brownout resets
+    uint16_t gnssRetries = 0;       // GNSS attempts after the first one of a fix
+    uint16_t gnssTimeouts = 0;
+    uint16_t attachFailures = 0;
+    uint16_t sendFailures = 0;
+    uint8_t count = 0;
+    Phase phases[MAX_PHASES];       // indexed by TelemetryPhase
+
+    Telemetry() = default;
+
+    // Parse from raw bytes into out. The HMAC is not checked, use verify() afterwards.
+    static DecodeStatus decode(const uint8_t* data, size_t len, Telemetry& out) noexcept;
+
+    size_t serialize(uint8_t* buffer, size_t capacity, const Signer& signer) noexcept;
+
+    // Set the header byte
+    void setHeader();
+
+protected:
+    size_t _fields_size() const noexcept override;
+    bool _write_fields(uint8_t* out) const noexcept override;
 
 public:
     std::string toString() const;
 };
 
+
+// Non-owning, allocation-free view over a serialized Position frame.
+// The viewed bytes must outlive the view.
+class PositionView {
+public:
+    PositionView() = default;
+
+    // Validate the frame in place. On any status other than DECODE_STATUS_OK
+    // the view is left empty.
+    DecodeStatus init(const uint8_t* data, size_t len) noexcept;
+
+    // Validate the frame and check its HMAC in one step.
+    DecodeStatus decode(const uint8_t* data, size_t len, const Signer& signer) noexcept;
+
+    bool valid() const noexcept { return data_ != nullptr; }
+    const uint8_t* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+
+    uint8_t header() const noexcept { return data_[0]; }
+    uint8_t interval() const noexcept { return data_[1]; }
+    uint8_t confidence() const noexcept { return data_[2]; }
+    uint8_t satellites() const noexcept { return data_[3]; }
+    const uint8_t* device() const noexcept { return data_ + 4; }
+
+    // Raw scaled coordinates as transmitted (degrees * Position::SCALE)
+    int32_t latitudeRaw() const noexcept;
+    int32_t longitudeRaw() const noexcept;
+
+    double latitude() const noexcept;
+    double longitude() const noexcept;
+
+    std::string_view name() const noexcept;
+    const uint8_t* hmac() const noexcept { return data_ + size_ - Payload::HMAC_SIZE; }
+
+    // Get the header params
+    void getHeader(bool &isValid) const noexcept;
+
+    // Verify the trailing HMAC over the viewed bytes, no re-serialization needed.
+    bool verify(const Signer& signer) const noexcept;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+// Non-owning, allocation-free view over a serialized SessionPosition frame.
+// The viewed bytes must outlive the view.
+class SessionPositionView {
+public:
+    SessionPositionView() = default;
+
+    // Validate the frame in place. On any status other than DECODE_STATUS_OK
+    // the view is left empty.
+    DecodeStatus init(const uint8_t* data, size_t len) noexcept;
+
+    // Validate the frame and check its HMAC in one step.
+    DecodeStatus decode(const uint8_t* data, size_t len, const Signer& signer) noexcept;
+
+    bool valid() const noexcept { return data_ != nullptr; }
+    const uint8_t* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+
+    uint8_t header() const noexcept { return data_[0]; }
+    uint8_t interval() const noexcept { return data_[1]; }
+    uint8_t confidence() const noexcept { return data_[2]; }
+    uint8_t satellites() const noexcept { return data_[3]; }
+    uint16_t session() const noexcept;
+
+    // Raw scaled coordinates as transmitted (degrees * Position::SCALE)
+    int32_t latitudeRaw() const noexcept;
+    int32_t longitudeRaw() const noexcept;
+
+    double latitude() const noexcept;
+    double longitude() const noexcept;
+
+    // Empty if the name did not change since the previous frame of the session.
+    std::string_view name() const noexcept;
+    const uint8_t* hmac() const noexcept { return data_ + size_ - Payload::HMAC_SIZE; }
+
+    // Get the header params
+    void getHeader(bool &isValid) const noexcept;
+
+    // Verify the trailing HMAC over the viewed bytes, no re-serialization needed.
+    bool verify(const Signer& signer) const noexcept;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+// Non-owning, allocation-free view over a serialized PositionBatch frame.
+// Sequenced batches are rejected, decode them with PositionBatch::decode().
+// The viewed bytes must outlive the view.
+class PositionBatchView {
+public:
+    PositionBatchView() = default;
+
+    // Validate the frame in place. On any status other than DECODE_STATUS_OK
+    // the view is left empty.
+    DecodeStatus init(const uint8_t* data, size_t len) noexcept;
+
+    // Validate the frame and check its HMAC in one step.
+    DecodeStatus decode(const uint8_t* data, size_t len, const Signer& signer) noexcept;
+
+    bool valid() const noexcept { return data_ != nullptr; }
+    const uint8_t* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+
+    uint8_t header() const noexcept { return data_[0]; }
+    uint8_t interval() const noexcept { return data_[1]; }
+    const uint8_t* device() const noexcept { return data_ + 2; }
+    uint8_t count() const noexcept { return data_[8]; }
+
+    // Decoded fix at index (0 = oldest), index must be below count().
+    // Compact frames are decoded from the first fix on every call.
+    PositionBatch::Fix fix(size_t index) const noexcept;
+
+    std::string_view name() const noexcept;
+    const uint8_t* hmac() const noexcept { return data_ + size_ - Payload::HMAC_SIZE; }
+
+    // Get the header params
+    void getHeader(bool &isValid) const noexcept;
+    void getHeader(bool &isValid, bool &isCompact) const noexcept;
+
+    // Verify the trailing HMAC over the viewed bytes, no re-serialization needed.
+    bool verify(const Signer& signer) const noexcept;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t nameOffset_ = 0;
+};
+
+
+// Non-owning, allocation-free view over a serialized Command frame.
+// The viewed bytes must outlive the view.
+class CommandView {
+public:
+    CommandView() = default;
+
+    // Validate the frame in place. On any status other than DECODE_STATUS_OK
+    // the view is left empty.
+    DecodeStatus init(const uint8_t* data, size_t len) noexcept;
+
+    // Validate the frame and check its HMAC in one step.
+    DecodeStatus decode(const uint8_t* data, size_t len, const Signer& signer) noexcept;
+
+    bool valid() const noexcept { return data_ != nullptr; }
+    const uint8_t* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+
+    uint8_t header() const noexcept { return data_[0]; }
+    std::string_view arg() const noexcept;
+    const uint8_t* hmac() const noexcept { return data_ + size_ - Payload::HMAC_SIZE; }
+
+    // Get the header params
+    void getHeader(CommandAction &action) const noexcept;
+
+    // Verify the trailing HMAC over the viewed bytes, no re-serialization needed.
+    bool verify(const Signer& signer) const noexcept;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
 } // namespace Messages
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <WalterModem.h>
+
+/**
+ * @brief The modem calls the tracker uses, so the control flow does not depend on the Walter hardware.
+ *
+ * The firmware implements it with WalterModemAdapter on top of the Walter modem library, the Linux simulator in sim/
+ * with a modem model on virtual time. The interface speaks the types of the Walter modem library.
+ */
+class ModemInterface {
+public:
+    typedef void (*GnssEventHandler)(const WalterModemGNSSFix* fix, void* args);
+    typedef void (*CoapEventHandler)(WalterModemCoapEvent event, int profileId, void* args);
+    typedef void (*RegistrationEventHandler)(WalterModemNetworkRegState state, void* args);
+
+    virtual ~ModemInterface() = default;
+
+    /**
+     * @brief Open the connection to the modem. After a deep sleep the modem is picked up without a reset.
+     *
+     * @return true on success, else false.
+     */
+    virtual bool begin() = 0;
+
+    /**
+     * @brief Put the ESP32 into deep sleep, the modem is kept out of reset. Does not return, the ESP32 starts over
+     * with setup() once the time is up. The modem sleeps whole seconds, the duration is rounded up to the next
+     * multiple of SLEEP_RESOLUTION_MILLIS.
+     *
+     * @param sleepMillis The sleep duration in milliseconds.
+     */
+    virtual void sleep(uint32_t sleepMillis) = 0;
+
+    static constexpr uint32_t SLEEP_RESOLUTION_MILLIS = 1000;
+
+    /**
+     * @brief Configure power saving mode with the timers of the network.
+     */
+    virtual bool configPSM(WalterModemPSMMode mode) = 0;
+
+    /* LTE registration */
+
+    virtual bool setOpState(WalterModemOpState state) = 0;
+    virtual bool definePDPContext() = 0;
+    virtual bool setNetworkSelectionMode(WalterModemNetworkSelMode mode) = 0;
+
+    /**
+     * @brief The registration state as last reported by the modem, answered by the driver without an AT command.
+     */
+    virtual WalterModemNetworkRegState getNetworkRegState() = 0;
+
+    virtual void setRegistrationEventHandler(RegistrationEventHandler handler, void* args) = 0;
+
+    /* GNSS and clock */
+
+    virtual bool gnssConfig(WalterModemGNSSSensMode sensMode = WALTER_MODEM_GNSS_SENS_MODE_HIGH, WalterModemGNSSAcqMode acqMode = WALTER_MODEM_GNSS_ACQ_MODE_COLD_WARM_START) = 0;
+    virtual bool gnssPerformAction(WalterModemGNSSAction action = WALTER_MODEM_GNSS_ACTION_GET_SINGLE_FIX) = 0;
+    virtual bool gnssGetUTCTime(WalterModemRsp* rsp) = 0;
+    virtual bool gnssGetAssistanceStatus(WalterModemRsp* rsp) = 0;
+    virtual bool gnssUpdateAssistance(WalterModemGNSSAssistanceType type) = 0;
+    virtual void gnssSetEventHandler(GnssEventHandler handler, void* args) = 0;
+
+    /* CoAP */
+
+    virtual bool coapGetContextStatus(int profileId) = 0;
+    virtual bool coapCreateContext(int profileId, const char* serverName, int port) = 0;
+    virtual bool coapSetOptions(int profileId, WalterModemCoapOptionAction action, WalterModemCoapOptionCode code, const char* values) = 0;
+    virtual bool coapSendData(int profileId, WalterModemCoapSendType type, WalterModemCoapSendMethodRsp methodRsp, int length, uint8_t* payload) = 0;
+    virtual bool coapDidRing(int profileId, uint8_t* targetBuf, uint16_t targetBufSize, WalterModemRsp* rsp) = 0;
+    virtual void coapSetEventHandler(CoapEventHandler handler, void* args) = 0;
+};
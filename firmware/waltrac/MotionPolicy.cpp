@@ -0,0 +1,138 @@
+#include <cmath>
+
+#include "MotionPolicy.h"
+
+/* Mean earth radius in meters */
+#define EARTH_RADIUS 6371000.0
+
+/* Weight of a new sample in the smoothed speed and turn rate */
+#define MOTION_SMOOTHING 0.5
+
+static double toRadians(double degrees)
+{
+    return degrees * M_PI / 180.0;
+}
+
+double MotionPolicy::distance(const Point& from, const Point& to)
+{
+    /* Equirectangular approximation, exact enough for the few hundred meters between two fixes */
+    double x = toRadians(to.longitude - from.longitude) * cos(toRadians((from.latitude + to.latitude) / 2.0));
+    double y = toRadians(to.latitude - from.latitude);
+
+    return sqrt(x * x + y * y) * EARTH_RADIUS;
+}
+
+double MotionPolicy::bearing(const Point& from, const Point& to)
+{
+    double lat1 = toRadians(from.latitude);
+    double lat2 = toRadians(to.latitude);
+    double dLon = toRadians(to.longitude - from.longitude);
+
+    double y = sin(dLon) * cos(lat2);
+    double x = cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(dLon);
+
+    double degrees = atan2(y, x) * 180.0 / M_PI;
+    return degrees < 0.0 ? degrees + 360.0 : degrees;
+}
+
+uint32_t MotionPolicy::clampInterval(double seconds, uint32_t minInterval, uint32_t maxInterval) const
+{
+    if (!(seconds > minInterval)) {
+        return minInterval;
+    }
+
+    if (seconds > maxInterval) {
+        return maxInterval;
+    }
+
+    return (uint32_t)seconds;
+}
+
+MotionPolicy::Decision MotionPolicy::update(double latitude, double longitude, int64_t timestamp)
+{
+    Point point = {latitude, longitude, timestamp};
+    Decision decision;
+
+    /* Read once, so the whole decision uses the same bounds */
+    uint32_t minInterval = this->minInterval();
+    uint32_t maxInterval = this->maxInterval();
+
+    /* The first fix is always reported and starts at the configured minimum */
+    if (!hasLast_) {
+        last_ = point;
+        reported_ = point;
+        hasLast_ = true;
+        stationary_ = false;
+
+        decision.interval = minInterval;
+        return decision;
+    }
+
+    int64_t elapsed = timestamp - last_.timestamp;
+    if (elapsed > 0) {
+        double moved = distance(last_, point);
+
+        if (moved >= config_.stationaryRadius) {
+            double heading = bearing(last_, point);
+
+            /* Turn rate from the smallest angle between the last two headings */
+            double turn = 0.0;
+            if (hasHeading_) {
+                turn = fabs(fmod(heading - heading_ + 540.0, 360.0) - 180.0) / elapsed;
+            }
+
+            speed_ += MOTION_SMOOTHING * (moved / elapsed - speed_);
+            turnRate_ += MOTION_SMOOTHING * (turn - turnRate_);
+            heading_ = heading;
+            hasHeading_ = true;
+        } else {
+            /* Movement inside the deadband is GNSS jitter */
+            speed_ -= MOTION_SMOOTHING * speed_;
+            turnRate_ -= MOTION_SMOOTHING * turnRate_;
+        }
+
+        last_ = point;
+    }
+
+    stationary_ = distance(reported_, point) < config_.stationaryRadius;
+
+    if (stationary_) {
+        decision.interval = maxInterval;
+        decision.report = config_.heartbeat != 0 && timestamp - reported_.timestamp >= (int64_t)config_.heartbeat;
+    } else {
+        double interval = speed_ > 0.0 ? config_.reportDistance / speed_ : maxInterval;
+        if (config_.turnRate > 0.0) {
+            interval /= 1.0 + turnRate_ / config_.turnRate;
+        }
+
+        decision.interval = clampInterval(interval, minInterval, maxInterval);
+        decision.report = true;
+    }
+
+    if (decision.report) {
+        reported_ = point;
+    }
+
+    return decision;
+}
+
+void MotionPolicy::reset()
+{
+    hasLast_ = false;
+    hasHeading_ = false;
+    stationary_ = false;
+    speed_ = 0.0;
+    heading_ = 0.0;
+    turnRate_ = 0.0;
+}
+
+bool MotionPolicy::setBounds(uint32_t minInterval, uint32_t maxInterval)
+{
+    if (minInterval < 1 || maxInterval < minInterval) {
+        return false;
+    }
+
+    minInterval_.store(minInterval, std::memory_order_relaxed);
+    maxInterval_.store(maxInterval, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Motion-adaptive reporting policy fed with successive GNSS fixes.
+ *
+ * The policy estimates speed, heading and turn rate from consecutive fixes. While the asset stays inside the
+ * stationary deadband around the last reported position, fixes are suppressed and the interval stretches to the
+ * maximum, only a heartbeat is sent now and then. Once the asset moves, the interval is chosen so that consecutive
+ * fixes are about reportDistance meters apart and is shortened further while the asset turns.
+ *
+ * @note Not thread safe, all calls but setBounds() have to come from the same task.
+ */
+class MotionPolicy {
+public:
+    struct Config {
+        uint32_t minInterval = 10;          // seconds, initial lower bound of the interval
+        uint32_t maxInterval = 120;         // seconds, initial upper bound of the interval and the interval while stationary
+        double stationaryRadius = 25.0;     // meters, movement inside this radius counts as GNSS jitter
+        double reportDistance = 100.0;      // meters, target distance between two reported fixes
+        double turnRate = 10.0;             // degrees per second at which the interval is halved
+        uint32_t heartbeat = 900;           // seconds, a stationary asset still reports this often, 0 never
+    };
+
+    struct Decision {
+        bool report = true;                 // whether the fix should be sent
+        uint32_t interval = 0;              // seconds until the next fix
+    };
+
+    /* constexpr, so a global policy is constant initialized and can live in RTC memory across deep sleep */
+    explicit constexpr MotionPolicy(const Config& config)
+        : config_(config), minInterval_(config.minInterval), maxInterval_(config.maxInterval) {}
+
+    /**
+     * @brief Feed a new fix and decide whether it is reported and when the next fix is taken.
+     *
+     * @param latitude Latitude of the fix in degrees.
+     * @param longitude Longitude of the fix in degrees.
+     * @param timestamp GNSS time of the fix in seconds since the epoch.
+     *
+     * @return The decision for this fix.
+     */
+    Decision update(double latitude, double longitude, int64_t timestamp);
+
+    /**
+     * @brief Forget all motion state, the next fix is reported like the first one.
+     */
+    void reset();
+
+    /**
+     * @brief Change the bounds of the interval. May be called from another task than update(), a cycle that runs
+     * meanwhile picks an interval between the old and the new bounds.
+     *
+     * @param minInterval The new lower bound in seconds, at least 1.
+     * @param maxInterval The new upper bound in seconds, at least minInterval.
+     *
+     * @return Whether the bounds are valid and were taken, else the previous bounds stay in place.
+     */
+    bool setBounds(uint32_t minInterval, uint32_t maxInterval);
+
+    /**
+     * @brief Lower bound of the interval in seconds.
+     */
+    uint32_t minInterval() const { return minInterval_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Upper bound of the interval in seconds, also the interval while stationary.
+     */
+    uint32_t maxInterval() const { return maxInterval_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Smoothed speed over ground in meters per second.
+     */
+    double speed() const { return speed_; }
+
+    /**
+     * @brief Heading of the last movement outside the deadband in degrees, clockwise from north.
+     */
+    double heading() const { return heading_; }
+
+    /**
+     * @brief Smoothed absolute turn rate in degrees per second.
+     */
+    double turnRate() const { return turnRate_; }
+
+    /**
+     * @brief Whether the asset is inside the deadband of the last reported fix.
+     */
+    bool stationary() const { return stationary_; }
+
+private:
+    struct Point {
+        double latitude;
+        double longitude;
+        int64_t timestamp;
+    };
+
+    static double distance(const Point& from, const Point& to);
+    static double bearing(const Point& from, const Point& to);
+
+    uint32_t clampInterval(double seconds, uint32_t minInterval, uint32_t maxInterval) const;
+
+    Config config_;                 // the bounds in effect are minInterval_ and maxInterval_
+    std::atomic<uint32_t> minInterval_;
+    std::atomic<uint32_t> maxInterval_;
+
+    bool hasLast_ = false;
+    bool hasHeading_ = false;
+    bool stationary_ = false;
+    Point last_ = {};               // previous fix
+    Point reported_ = {};           // last reported fix, center of the deadband
+    double speed_ = 0.0;
+    double heading_ = 0.0;
+    double turnRate_ = 0.0;
+};
@@ -0,0 +1,155 @@
+#include <esp_timer.h>
+
+#include <cstring>
+
+#include "WaltracConfig.h"
+#include "Waltrac.h"
+
+WT_NOINIT PhaseStats phaseStats;
+
+/* "WTS1", set by clear(). Without it the counters are noise from a power on and the telemetry window starts empty */
+#define PHASE_STATS_MAGIC 0x57545331
+
+/* Typical current of each phase in mA, indexed by Messages::TelemetryPhase */
+static const uint16_t phaseCurrents[Messages::TELEMETRY_PHASE_COUNT] = WT_CFG_PHASE_CURRENTS;
+
+static uint16_t saturate16(uint64_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+static uint32_t saturate32(uint64_t value)
+{
+    return value > UINT32_MAX ? UINT32_MAX : value;
+}
+
+PhaseStats::Span::Span(PhaseStats& stats, Phase phase)
+    : stats_(stats), phase_(phase), start_(esp_timer_get_time()), outerNested_(stats.nestedMicros_)
+{
+    stats_.nestedMicros_ = 0;
+}
+
+PhaseStats::Span::~Span()
+{
+    int64_t wall = esp_timer_get_time() - start_;
+
+    stats_.record(phase_, wall, wall - stats_.nestedMicros_);
+    stats_.nestedMicros_ = outerNested_ + wall;
+}
+
+void PhaseStats::clear(int64_t now)
+{
+    magic_ = PHASE_STATS_MAGIC;
+    windowStart_ = now;
+    lastSeen_ = now;
+    awakeMicros_ = 0;
+    memset(phases_, 0, sizeof(phases_));
+    memset(counters_, 0, sizeof(counters_));
+}
+
+void PhaseStats::begin(Boot boot, int64_t now)
+{
+    /* The ESP32 timer starts over at every boot, the time awake after the last span before a reset is lost */
+    awakeMark_ = 0;
+    nestedMicros_ = 0;
+
+    if (boot == BOOT_POWER_ON || magic_ != PHASE_STATS_MAGIC) {
+        clear(now);
+        return;
+    }
+
+    if (boot == BOOT_WAKE) {
+        return;
+    }
+
+    /* The monotonic clock starts over with a reset, the window continues at the boot from the last thing it saw */
+    int64_t bootedAt = now - esp_timer_get_time();
+    windowStart_ = bootedAt - (lastSeen_ - windowStart_);
+    lastSeen_ = bootedAt;
+
+    count(boot == BOOT_CRASH ? COUNTER_CRASHES : COUNTER_RESTARTS);
+}
+
+void PhaseStats::count(Counter counter)
+{
+    counters_[counter]++;
+}
+
+void PhaseStats::record(Phase phase, int64_t wallMicros, int64_t selfMicros)
+{
+    Histogram& histogram = phases_[phase];
+
+    if (wallMicros < 0) {
+        wallMicros = 0;
+    }
+
+    if (selfMicros < 0) {
+        selfMicros = 0;
+    }
+
+    histogram.samples++;
+    histogram.totalMicros += wallMicros;
+    histogram.charge += (uint64_t)selfMicros * phaseCurrents[phase];
+    if ((uint64_t)wallMicros > histogram.maxMicros) {
+        histogram.maxMicros = wallMicros;
+    }
+
+    /* Bucket i holds the samples below BUCKET_BASE_MILLIS << i, the last one everything longer */
+    int64_t millis = wallMicros / 1000;
+    uint8_t bucket = 0;
+    while (bucket < Messages::Telemetry::BUCKETS - 1 && millis >= (int64_t)Messages::Telemetry::BUCKET_BASE_MILLIS << bucket) {
+        bucket++;
+    }
+
+    histogram.buckets[bucket]++;
+
+    /* Keeps the window and the time awake up to date in case a reset follows */
+    accountAwake();
+    lastSeen_ = monotonicMicros();
+}
+
+void PhaseStats::accountAwake()
+{
+    int64_t now = esp_timer_get_time();
+    awakeMicros_ += now - awakeMark_;
+    awakeMark_ = now;
+}
+
+bool PhaseStats::due(int64_t now, int64_t periodMicros) const
+{
+    return now - windowStart_ >= periodMicros;
+}
+
+void PhaseStats::report(Messages::Telemetry& telemetry, int64_t now)
+{
+    accountAwake();
+    lastSeen_ = now;
+
+    telemetry.window = saturate32((now - windowStart_) / 1000000);
+    telemetry.awake = saturate32(awakeMicros_ / 1000000);
+    telemetry.restarts = saturate16(counters_[COUNTER_RESTARTS]);
+    telemetry.crashes = saturate16(counters_[COUNTER_CRASHES]);
+    telemetry.gnssRetries = saturate16(counters_[COUNTER_GNSS_RETRIES]);
+    telemetry.gnssTimeouts = saturate16(counters_[COUNTER_GNSS_TIMEOUTS]);
+    telemetry.attachFailures = saturate16(counters_[COUNTER_ATTACH_FAILURES]);
+    telemetry.sendFailures = saturate16(counters_[COUNTER_SEND_FAILURES]);
+
+    telemetry.count = Messages::TELEMETRY_PHASE_COUNT;
+    for (uint8_t i = 0; i < Messages::TELEMETRY_PHASE_COUNT; i++) {
+        const Histogram& histogram = phases_[i];
+        Messages::Telemetry::Phase& phase = telemetry.phases[i];
+
+        phase.samples = saturate16(histogram.samples);
+        phase.totalMillis = saturate32(histogram.totalMicros / 1000);
+        phase.maxMillis = saturate32(histogram.maxMicros / 1000);
+        phase.charge = saturate32(histogram.charge / 3600000);     // mA * us to uAh
+        for (uint8_t b = 0; b < Messages::Telemetry::BUCKETS; b++) {
+            phase.buckets[b] = saturate16(histogram.buckets[b]);
+        }
+    }
+}
+
+void PhaseStats::reset(int64_t now)
+{
+    clear(now);
+}
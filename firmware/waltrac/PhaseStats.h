@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Messages.h"
+
+/**
+ * @brief Latency and charge per phase of the tracker cycle, plus retry and restart counters, summarized into a
+ * Messages::Telemetry frame.
+ *
+ * Every phase is timed with the ESP32 microsecond timer by a Span. The wall time of a span goes into the histogram of
+ * its phase, nested spans included. The charge estimate only uses the time outside of nested spans, multiplied by the
+ * typical current of the phase, so an attach inside the clock validation is not counted twice.
+ *
+ * The statistics live in memory that survives software resets, so restarts and crashes can be counted and the window
+ * is not lost with them. After a power on the memory holds garbage, begin() recognizes that and starts over.
+ *
+ * @note Not thread safe. Spans have to nest, which holds as long as all radio work happens under radioMutex.
+ */
+class PhaseStats {
+public:
+    using Phase = Messages::TelemetryPhase;
+
+    enum Counter {
+        COUNTER_RESTARTS,           // software restarts, e.g. after a GNSS lookup timeout
+        COUNTER_CRASHES,            // panics, watchdog and brownout resets
+        COUNTER_GNSS_RETRIES,       // GNSS attempts after the first one of a fix
+        COUNTER_GNSS_TIMEOUTS,
+        COUNTER_ATTACH_FAILURES,
+        COUNTER_SEND_FAILURES,
+        COUNTER_COUNT,
+    };
+
+    enum Boot {
+        BOOT_POWER_ON,              // memory content is undefined
+        BOOT_WAKE,                  // timer wake-up from deep sleep
+        BOOT_RESTART,
+        BOOT_CRASH,
+    };
+
+    /**
+     * @brief Times one phase from construction to destruction.
+     */
+    class Span {
+    public:
+        Span(PhaseStats& stats, Phase phase);
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        PhaseStats& stats_;
+        Phase phase_;
+        int64_t start_;
+        int64_t outerNested_;
+    };
+
+    /* Trivial, so the statistics can be placed in memory that is not initialized at boot */
+    PhaseStats() = default;
+
+    /**
+     * @brief Validate the statistics after a boot and count the restart or crash that caused it.
+     *
+     * @param boot How the ESP32 came up.
+     * @param now The current monotonicMicros().
+     */
+    void begin(Boot boot, int64_t now);
+
+    /**
+     * @brief Count an event.
+     */
+    void count(Counter counter);
+
+    /**
+     * @brief Whether the window is at least periodMicros long and worth a report.
+     */
+    bool due(int64_t now, int64_t periodMicros) const;
+
+    /**
+     * @brief Fill the statistics of the window into a telemetry frame. Header and device are left to the caller.
+     */
+    void report(Messages::Telemetry& telemetry, int64_t now);
+
+    /**
+     * @brief Start a new window, called once the report was delivered.
+     */
+    void reset(int64_t now);
+
+    /**
+     * @brief Add the time awake since the boot or the last call. Called right before a deep sleep, since the ESP32
+     * timer starts over at every wake-up.
+     */
+    void accountAwake();
+
+private:
+    struct Histogram {
+        uint32_t samples;
+        uint64_t totalMicros;
+        uint64_t maxMicros;
+        uint64_t charge;                // mA * microseconds
+        uint32_t buckets[Messages::Telemetry::BUCKETS];
+    };
+
+    void record(Phase phase, int64_t wallMicros, int64_t selfMicros);
+    void clear(int64_t now);
+
+    uint32_t magic_;
+    int64_t windowStart_;               // monotonicMicros() at the start of the window
+    int64_t lastSeen_;                  // monotonicMicros() of the last report or span, carries the window over a reset
+    int64_t awakeMicros_;
+    int64_t awakeMark_;                 // esp_timer time up to which awakeMicros_ is accounted
+    int64_t nestedMicros_;              // wall time of the finished spans inside the running one
+    Histogram phases_[Messages::TELEMETRY_PHASE_COUNT];
+    uint32_t counters_[COUNTER_COUNT];
+};
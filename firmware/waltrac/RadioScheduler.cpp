@@ -0,0 +1,91 @@
+#include <esp_log.h>
+
+#include "WaltracConfig.h"
+#include "Waltrac.h"
+
+RadioScheduler radioScheduler;
+
+void RadioScheduler::account(uint32_t now)
+{
+    uint32_t elapsed = now - modeSince_;
+
+    if (mode_ == MODE_LTE) {
+        cycle_.lteMillis += elapsed;
+    } else if (mode_ == MODE_GNSS) {
+        cycle_.gnssMillis += elapsed;
+    }
+
+    modeSince_ = now;
+}
+
+void RadioScheduler::switchTo(Mode mode)
+{
+    account(millis());
+    mode_ = mode;
+}
+
+bool RadioScheduler::enterLte()
+{
+    /* The registration state is tracked by the driver, checking it needs no AT command */
+    if (mode_ == MODE_LTE && isLteConnected()) {
+        return true;
+    }
+
+    if (!lteConnect()) {
+        phaseStats.count(PhaseStats::COUNTER_ATTACH_FAILURES);
+        cycle_.failures++;
+        switchTo(MODE_UNKNOWN);
+        return false;
+    }
+
+    cycle_.attaches++;
+    switchTo(MODE_LTE);
+
+    ESP_LOGD("WaltracRadio", "LTE window opened, attach %u of this cycle.", (unsigned)cycle_.attaches);
+    return true;
+}
+
+bool RadioScheduler::enterGnss()
+{
+    if (mode_ == MODE_GNSS) {
+        return true;
+    }
+
+    if (!lteDisconnect()) {
+        cycle_.failures++;
+        switchTo(MODE_UNKNOWN);
+        return false;
+    }
+
+    cycle_.detaches++;
+    switchTo(MODE_GNSS);
+
+    ESP_LOGD("WaltracRadio", "GNSS window opened, detach %u of this cycle.", (unsigned)cycle_.detaches);
+    return true;
+}
+
+void RadioScheduler::invalidate()
+{
+    switchTo(MODE_UNKNOWN);
+}
+
+RadioScheduler::Stats RadioScheduler::takeCycle()
+{
+    uint32_t now = millis();
+    account(now);
+
+    Stats stats = cycle_;
+    stats.wallMillis = now - cycleSince_;
+
+    total_.attaches += stats.attaches;
+    total_.detaches += stats.detaches;
+    total_.failures += stats.failures;
+    total_.lteMillis += stats.lteMillis;
+    total_.gnssMillis += stats.gnssMillis;
+    total_.wallMillis += stats.wallMillis;
+
+    cycle_ = Stats();
+    cycleSince_ = now;
+
+    return stats;
+}
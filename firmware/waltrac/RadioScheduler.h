@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Owner of the mutually exclusive GNSS and LTE modes of the modem.
+ *
+ * Callers ask for the mode they need instead of attaching and detaching themselves. A request for the mode the modem
+ * is already in costs nothing, so all LTE work of an interval (uploads, assistance data, clock sync) shares one attach
+ * and consecutive GNSS fixes share one detach. The scheduler counts attaches and detaches and the time spent in each
+ * mode, so the cost of a cycle can be measured.
+ *
+ * @note Not thread safe, only call while holding radioMutex.
+ */
+class RadioScheduler {
+public:
+    enum Mode {
+        MODE_UNKNOWN,       // after power on or a failed switch, the next request switches for sure
+        MODE_LTE,           // attached to the LTE network
+        MODE_GNSS,          // detached, GNSS can run
+    };
+
+    struct Stats {
+        uint32_t attaches = 0;          // successful LTE attaches
+        uint32_t detaches = 0;          // successful LTE detaches
+        uint32_t failures = 0;          // failed switches
+        uint32_t lteMillis = 0;         // time spent attached
+        uint32_t gnssMillis = 0;        // time spent detached
+        uint32_t wallMillis = 0;        // time covered by these stats
+    };
+
+    /**
+     * @brief Open an LTE window, attaches unless already attached.
+     *
+     * @return Whether the modem is attached.
+     */
+    bool enterLte();
+
+    /**
+     * @brief Open a GNSS window, detaches unless already detached.
+     *
+     * @return Whether the modem is detached.
+     */
+    bool enterGnss();
+
+    /**
+     * @brief Forget the mode, the next request switches for sure. For callers that changed the modem state directly.
+     */
+    void invalidate();
+
+    /**
+     * @brief The mode the modem is in as far as the scheduler knows.
+     */
+    Mode mode() const { return mode_; }
+
+    /**
+     * @brief Close the current cycle.
+     *
+     * @return The stats since the last call, the running window is accounted up to now.
+     */
+    Stats takeCycle();
+
+    /**
+     * @brief Stats since power on, excluding the running cycle.
+     */
+    const Stats& total() const { return total_; }
+
+private:
+    void switchTo(Mode mode);
+    void account(uint32_t now);
+
+    Mode mode_ = MODE_UNKNOWN;
+    uint32_t modeSince_ = 0;        // millis() when the current mode was entered
+    uint32_t cycleSince_ = 0;       // millis() when the current cycle started
+    Stats cycle_;
+    Stats total_;
+};
+
+/**
+ * @brief The scheduler of the modem radio.
+ */
+extern RadioScheduler radioScheduler;
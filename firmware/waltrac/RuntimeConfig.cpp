@@ -0,0 +1,100 @@
+#include <Preferences.h>
+#include <esp_log.h>
+#include <cstring>
+#include <type_traits>
+
+#include "RuntimeConfig.h"
+
+#define RUNTIME_CONFIG_NAMESPACE "waltrac"
+#define RUNTIME_CONFIG_KEY "config"
+
+/* Bumped whenever the layout of the blob changes, older blobs are ignored */
+#define RUNTIME_CONFIG_VERSION 1
+
+RuntimeConfig runtimeConfig;
+
+bool RuntimeConfig::valid(const Values& values)
+{
+    if (values.version != RUNTIME_CONFIG_VERSION || values.interval < MIN_INTERVAL || values.interval > MAX_INTERVAL) {
+        return false;
+    }
+
+    size_t length = strnlen(values.name, sizeof(values.name));
+    return length > 0 && length <= MAX_NAME;
+}
+
+bool RuntimeConfig::begin(uint32_t interval, const char* name)
+{
+    static_assert(std::is_trivially_copyable<Values>::value, "the settings are stored as a blob");
+
+    values_ = {};
+    values_.version = RUNTIME_CONFIG_VERSION;
+    values_.interval = interval;
+    strncpy(values_.name, name, MAX_NAME);
+
+    bool found = false;
+    Preferences preferences;
+    if (preferences.begin(RUNTIME_CONFIG_NAMESPACE, true)) {
+        Values stored = {};
+        if (preferences.getBytesLength(RUNTIME_CONFIG_KEY) == sizeof(stored) && preferences.getBytes(RUNTIME_CONFIG_KEY, &stored, sizeof(stored)) == sizeof(stored) && valid(stored)) {
+            values_ = stored;
+            found = true;
+        }
+
+        preferences.end();
+    }
+
+    interval_.store(values_.interval, std::memory_order_relaxed);
+    return found;
+}
+
+bool RuntimeConfig::store(const Values& values)
+{
+    Preferences preferences;
+    if (!preferences.begin(RUNTIME_CONFIG_NAMESPACE, false)) {
+        ESP_LOGE("WaltracConfig", "Could not open NVS namespace " RUNTIME_CONFIG_NAMESPACE ".");
+        return false;
+    }
+
+    /* NVS replaces a blob only once the new one is written completely */
+    bool stored = preferences.putBytes(RUNTIME_CONFIG_KEY, &values, sizeof(values)) == sizeof(values);
+    preferences.end();
+
+    if (!stored) {
+        ESP_LOGE("WaltracConfig", "Could not store the settings.");
+        return false;
+    }
+
+    values_ = values;
+    interval_.store(values_.interval, std::memory_order_relaxed);
+    return true;
+}
+
+bool RuntimeConfig::setInterval(uint32_t seconds)
+{
+    Values values = values_;
+    values.interval = seconds;
+
+    if (!valid(values)) {
+        return false;
+    }
+
+    return values.interval == values_.interval || store(values);
+}
+
+bool RuntimeConfig::setName(std::string_view name)
+{
+    if (name.empty() || name.size() > MAX_NAME || name.find('\0') != std::string_view::npos) {
+        return false;
+    }
+
+    Values values = values_;
+    memset(values.name, 0, sizeof(values.name));
+    memcpy(values.name, name.data(), name.size());
+
+    if (!valid(values)) {
+        return false;
+    }
+
+    return strcmp(values.name, values_.name) == 0 || store(values);
+}
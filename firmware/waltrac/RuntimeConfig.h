@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Tracker settings that the server changes at runtime with SETINTERVAL and SETNAME.
+ *
+ * The settings are kept in NVS as a single blob, so an update is stored completely or not at all and a power loss
+ * in the middle of a write leaves the previous settings in place. begin() loads them once at boot and falls back to
+ * the compiled defaults while nothing valid is stored.
+ *
+ * The uplink task applies the commands and is the only reader of the name. The interval is read by the GNSS task with
+ * every cycle, so a new interval takes effect with the next fix.
+ */
+class RuntimeConfig {
+public:
+    static constexpr uint32_t MIN_INTERVAL = 1;
+    static constexpr uint32_t MAX_INTERVAL = 3600;
+    static constexpr size_t MAX_NAME = 255;         // the name length is a single byte on the wire
+
+    /**
+     * @brief Load the stored settings.
+     *
+     * @param interval Interval in seconds used while no settings are stored.
+     * @param name Name used while no settings are stored.
+     *
+     * @return Whether stored settings were found, false if the defaults are used.
+     */
+    bool begin(uint32_t interval, const char* name);
+
+    /**
+     * @brief Change and store the interval.
+     *
+     * @param seconds The new interval, between MIN_INTERVAL and MAX_INTERVAL.
+     *
+     * @return Whether the interval is valid and was stored, else the previous interval stays in place.
+     */
+    bool setInterval(uint32_t seconds);
+
+    /**
+     * @brief Change and store the name.
+     *
+     * @param name The new name, not empty and at most MAX_NAME bytes.
+     *
+     * @return Whether the name is valid and was stored, else the previous name stays in place.
+     */
+    bool setName(std::string_view name);
+
+    /**
+     * @brief Seconds between two fixes, safe to call from any task.
+     */
+    uint32_t interval() const { return interval_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Name of the tracker, only for the task that applies the commands.
+     */
+    const char* name() const { return values_.name; }
+
+private:
+    /* Layout of the NVS blob */
+    struct Values {
+        uint32_t version;
+        uint32_t interval;
+        char name[MAX_NAME + 1];
+    };
+
+    static bool valid(const Values& values);
+    bool store(const Values& values);
+
+    Values values_ = {};
+    std::atomic<uint32_t> interval_{0};
+};
+
+/**
+ * @brief The settings of the tracker.
+ */
+extern RuntimeConfig runtimeConfig;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// SeqlockBuffer.h - lock-free handoff of the latest value from one producer to one consumer.
+//
+// The producer (a driver callback) never blocks and never waits for the
+// consumer: it copies into the slot the consumer is not reading and then
+// publishes it by bumping a sequence counter. The consumer copies the
+// published slot and retries if the producer moved on meanwhile, so it
+// always ends up with one complete value. Only the newest value is kept,
+// older unread values are overwritten.
+//
+// Producer and consumer may run on different cores. The slots are copied
+// word by word with relaxed atomics, so a copy that overlaps a publish reads
+// stale words instead of racing, and the fences order the words against the
+// sequence like in any seqlock.
+
+template <typename T>
+class SeqlockBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqlockBuffer copies values with memcpy");
+
+public:
+    // Producer side, a single producer at a time. Wait free, so it may run in
+    // the event task of a driver while the consumer runs on the other core.
+    void publish(const T& value) noexcept {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+
+        // the slot was handed out two publishes ago: a consumer that sees any
+        // of the words below also sees that sequence moved on and retries
+        std::atomic_thread_fence(std::memory_order_release);
+
+        // the consumer only ever reads the slot of the current sequence
+        std::atomic<uint32_t>* slot = slots_[(sequence + 1) & 1];
+        for (size_t i = 0; i < WORDS; i++) {
+            slot[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        sequence_.store(sequence + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Copies the newest value into value and returns true,
+    // or returns false if nothing was published since the last consume().
+    bool consume(T& value) noexcept {
+        uint32_t words[WORDS];
+        uint32_t sequence;
+        uint32_t check;
+
+        do {
+            sequence = sequence_.load(std::memory_order_acquire);
+            if (sequence == consumed_) {
+                return false;
+            }
+
+            const std::atomic<uint32_t>* slot = slots_[sequence & 1];
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = slot[i].load(std::memory_order_relaxed);
+            }
+
+            // a second publish reuses the slot just copied, retry in that case
+            std::atomic_thread_fence(std::memory_order_acquire);
+            check = sequence_.load(std::memory_order_relaxed);
+        } while (check != sequence);
+
+        memcpy(&value, words, sizeof(T));
+        consumed_ = sequence;
+        return true;
+    }
+
+    // Consumer side. Drops whatever was published so far.
+    void discard() noexcept {
+        consumed_ = sequence_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> slots_[2][WORDS] = {};
+    std::atomic<uint32_t> sequence_{0};
+    uint32_t consumed_ = 0;         // consumer only
+};
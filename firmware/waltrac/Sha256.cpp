@@ -0,0 +1,238 @@
+#include "Sha256.h"
+
+#include <cstring>
+
+#if defined(MESSAGES_SHA256_OPENSSL)
+#include <openssl/evp.h>
+#endif
+
+namespace Messages {
+
+Sha256::~Sha256() {
+    release();
+}
+
+#if defined(MESSAGES_SHA256_MBEDTLS)
+
+// --- mbedTLS -----------------------------------------------------------------
+
+bool Sha256::setup() noexcept {
+    release();
+
+    const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (md_info == nullptr) {
+        return false;
+    }
+
+    mbedtls_md_init(&ctx_);
+    if (mbedtls_md_setup(&ctx_, md_info, 0) != 0) {
+        mbedtls_md_free(&ctx_);
+        return false;
+    }
+
+    ready_ = true;
+    return true;
+}
+
+void Sha256::release() noexcept {
+    if (ready_) {
+        mbedtls_md_free(&ctx_);
+        ready_ = false;
+    }
+}
+
+bool Sha256::starts() noexcept {
+    return ready_ && mbedtls_md_starts(&ctx_) == 0;
+}
+
+bool Sha256::update(const uint8_t* data, size_t len) noexcept {
+    return ready_ && mbedtls_md_update(&ctx_, data, len) == 0;
+}
+
+bool Sha256::finish(uint8_t out[DIGEST_SIZE]) noexcept {
+    return ready_ && mbedtls_md_finish(&ctx_, out) == 0;
+}
+
+bool Sha256::copyFrom(const Sha256& other) noexcept {
+    return ready_ && other.ready_ && mbedtls_md_clone(&ctx_, &other.ctx_) == 0;
+}
+
+#elif defined(MESSAGES_SHA256_OPENSSL)
+
+// --- OpenSSL -----------------------------------------------------------------
+
+bool Sha256::setup() noexcept {
+    release();
+
+    ctx_ = EVP_MD_CTX_new();
+    return ctx_ != nullptr;
+}
+
+void Sha256::release() noexcept {
+    if (ctx_ != nullptr) {
+        EVP_MD_CTX_free(ctx_);
+        ctx_ = nullptr;
+    }
+}
+
+bool Sha256::starts() noexcept {
+    return ctx_ != nullptr && EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr) == 1;
+}
+
+bool Sha256::update(const uint8_t* data, size_t len) noexcept {
+    return ctx_ != nullptr && EVP_DigestUpdate(ctx_, data, len) == 1;
+}
+
+bool Sha256::finish(uint8_t out[DIGEST_SIZE]) noexcept {
+    return ctx_ != nullptr && EVP_DigestFinal_ex(ctx_, out, nullptr) == 1;
+}
+
+bool Sha256::copyFrom(const Sha256& other) noexcept {
+    return ctx_ != nullptr && other.ctx_ != nullptr && EVP_MD_CTX_copy_ex(ctx_, other.ctx_) == 1;
+}
+
+#else
+
+// --- bundled (FIPS 180-4) ----------------------------------------------------
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, unsigned n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void compress(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[4 * i]) << 24) |
+               (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+               (static_cast<uint32_t>(block[4 * i + 2]) << 8) |
+               (static_cast<uint32_t>(block[4 * i + 3]));
+    }
+
+    for (size_t i = 16; i < 64; ++i) {
+        const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t i = 0; i < 64; ++i) {
+        const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+bool Sha256::setup() noexcept {
+    return starts();
+}
+
+void Sha256::release() noexcept {
+}
+
+bool Sha256::starts() noexcept {
+    static const uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(state_, H0, sizeof(state_));
+    length_ = 0;
+    return true;
+}
+
+bool Sha256::update(const uint8_t* data, size_t len) noexcept {
+    size_t buffered = static_cast<size_t>(length_ % BLOCK_SIZE);
+    length_ += len;
+
+    if (buffered > 0) {
+        const size_t take = len < BLOCK_SIZE - buffered ? len : BLOCK_SIZE - buffered;
+        memcpy(buffer_ + buffered, data, take);
+        data += take;
+        len -= take;
+        buffered += take;
+
+        if (buffered < BLOCK_SIZE) {
+            return true;
+        }
+
+        compress(state_, buffer_);
+    }
+
+    for (; len >= BLOCK_SIZE; data += BLOCK_SIZE, len -= BLOCK_SIZE) {
+        compress(state_, data);
+    }
+
+    if (len > 0) {
+        memcpy(buffer_, data, len);
+    }
+
+    return true;
+}
+
+bool Sha256::finish(uint8_t out[DIGEST_SIZE]) noexcept {
+    const uint64_t bits = length_ * 8;
+    size_t buffered = static_cast<size_t>(length_ % BLOCK_SIZE);
+
+    // 0x80, zero padding and the 64 bit message length in bits
+    buffer_[buffered++] = 0x80;
+    if (buffered > BLOCK_SIZE - 8) {
+        memset(buffer_ + buffered, 0, BLOCK_SIZE - buffered);
+        compress(state_, buffer_);
+        buffered = 0;
+    }
+
+    memset(buffer_ + buffered, 0, BLOCK_SIZE - 8 - buffered);
+    for (size_t i = 0; i < 8; ++i) {
+        buffer_[BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+
+    compress(state_, buffer_);
+
+    for (size_t i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+    }
+
+    return true;
+}
+
+bool Sha256::copyFrom(const Sha256& other) noexcept {
+    memcpy(state_, other.state_, sizeof(state_));
+    memcpy(buffer_, other.buffer_, static_cast<size_t>(other.length_ % BLOCK_SIZE));
+    length_ = other.length_;
+    return true;
+}
+
+#endif
+
+} // namespace Messages
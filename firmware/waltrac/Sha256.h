@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Sha256.h - SHA-256 backend of the message signer.
+//
+// Exactly one backend is compiled in:
+//   MESSAGES_SHA256_MBEDTLS  mbedTLS md API (default, part of the ESP32 core)
+//   MESSAGES_SHA256_OPENSSL  OpenSSL libcrypto EVP API, for host builds
+//   MESSAGES_SHA256_BUNDLED  portable implementation in Sha256.cpp, no dependencies
+#if !defined(MESSAGES_SHA256_MBEDTLS) && !defined(MESSAGES_SHA256_OPENSSL) && !defined(MESSAGES_SHA256_BUNDLED)
+#define MESSAGES_SHA256_MBEDTLS
+#endif
+
+#if defined(MESSAGES_SHA256_MBEDTLS)
+#include <mbedtls/md.h>
+#elif defined(MESSAGES_SHA256_OPENSSL)
+struct evp_md_ctx_st;
+#endif
+
+namespace Messages {
+
+// Incremental SHA-256 whose state, including buffered input, can be copied
+// from another instance. That is what the signer needs to resume from a
+// precomputed HMAC midstate.
+class Sha256 {
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    Sha256() = default;
+    ~Sha256();
+
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    // Allocate the backend state. Must succeed before any other call.
+    bool setup() noexcept;
+
+    // Free the backend state, setup() may be called again afterwards.
+    void release() noexcept;
+
+    bool starts() noexcept;
+    bool update(const uint8_t* data, size_t len) noexcept;
+    bool finish(uint8_t out[DIGEST_SIZE]) noexcept;
+
+    // Continue from the state of other, both must be set up.
+    bool copyFrom(const Sha256& other) noexcept;
+
+private:
+#if defined(MESSAGES_SHA256_MBEDTLS)
+    mbedtls_md_context_t ctx_{};
+    bool ready_ = false;
+#elif defined(MESSAGES_SHA256_OPENSSL)
+    evp_md_ctx_st* ctx_ = nullptr;
+#else
+    uint32_t state_[8] = {0};
+    uint64_t length_ = 0;           // bytes absorbed, including buffered ones
+    uint8_t buffer_[BLOCK_SIZE] = {0};
+#endif
+};
+
+} // namespace Messages
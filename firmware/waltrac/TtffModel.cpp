@@ -0,0 +1,39 @@
+#include "TtffModel.h"
+
+/* Number of mean deviations the lead adds on top of the mean, covers most fixes that take longer than usual */
+#define TTFF_DEVIATION_FACTOR 2
+
+void TtffModel::update(Estimate& estimate, int64_t sample)
+{
+    if (sample < 0) {
+        sample = 0;
+    }
+
+    /* Smoothed like a TCP round trip time, gains 1/8 for the mean and 1/4 for the deviation */
+    if (estimate.samples == 0) {
+        estimate.meanMicros = sample;
+        estimate.deviationMicros = sample / 2;
+    } else {
+        int64_t error = sample - estimate.meanMicros;
+        estimate.deviationMicros += ((error < 0 ? -error : error) - estimate.deviationMicros) / 4;
+        estimate.meanMicros += error / 8;
+    }
+
+    estimate.samples++;
+}
+
+void TtffModel::addSample(Mode mode, int64_t setupMicros, int64_t ttffMicros)
+{
+    update(setup_[mode], setupMicros);
+    update(ttff_[mode], ttffMicros);
+}
+
+int64_t TtffModel::lead(Mode mode, int64_t maxMicros) const
+{
+    if (ttff_[mode].samples == 0) {
+        return 0;
+    }
+
+    int64_t lead = setup_[mode].meanMicros + ttff_[mode].meanMicros + TTFF_DEVIATION_FACTOR * (setup_[mode].deviationMicros + ttff_[mode].deviationMicros);
+    return lead > maxMicros ? maxMicros : lead;
+}
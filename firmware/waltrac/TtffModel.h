@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Running model of how long a fix takes, per acquisition mode.
+ *
+ * For every fix the model gets the time from the start of the interval to the GNSS request (clock, assistance and
+ * detach) and the time from the request to the fix (time to fix). Both are smoothed like a round trip time, with a
+ * mean and a mean deviation. lead() is how long before the interval boundary a cycle has to start so that the fix
+ * lands on the boundary in most cases.
+ *
+ * All times are microseconds.
+ *
+ * @note Not thread safe, all calls have to come from the same task.
+ */
+class TtffModel {
+public:
+    enum Mode {
+        MODE_COLD_WARM,     // initial fix, WALTER_MODEM_GNSS_ACQ_MODE_COLD_WARM_START
+        MODE_HOT,           // following fixes, WALTER_MODEM_GNSS_ACQ_MODE_HOT_START
+        MODE_COUNT,
+    };
+
+    struct Estimate {
+        uint32_t samples = 0;
+        int64_t meanMicros = 0;
+        int64_t deviationMicros = 0;
+    };
+
+    /* constexpr, so a global model is constant initialized and can live in RTC memory across deep sleep */
+    constexpr TtffModel() = default;
+
+    /**
+     * @brief Add the timing of a successful fix.
+     *
+     * @param mode The acquisition mode of the fix.
+     * @param setupMicros Time from the start of the interval to the request of the fix.
+     * @param ttffMicros Time from the request to the fix.
+     */
+    void addSample(Mode mode, int64_t setupMicros, int64_t ttffMicros);
+
+    /**
+     * @brief How long before the interval boundary a cycle of the given mode should start.
+     *
+     * @param mode The acquisition mode of the next fix.
+     * @param maxMicros Upper bound of the lead.
+     *
+     * @return The lead in microseconds, 0 while the mode has no samples.
+     */
+    int64_t lead(Mode mode, int64_t maxMicros) const;
+
+    /**
+     * @brief The smoothed time to fix of the given mode.
+     */
+    const Estimate& ttff(Mode mode) const { return ttff_[mode]; }
+
+    /**
+     * @brief The smoothed time from the start of the interval to the request of the given mode.
+     */
+    const Estimate& setup(Mode mode) const { return setup_[mode]; }
+
+private:
+    static void update(Estimate& estimate, int64_t sample);
+
+    Estimate setup_[MODE_COUNT];
+    Estimate ttff_[MODE_COUNT];
+};
@@ -0,0 +1,94 @@
+#include <type_traits>
+
+#include "WaltracConfig.h"
+#include "Waltrac.h"
+
+WT_NOINIT UplinkWindow uplinkWindow;
+
+/* "WTW1", set by begin(). The slot indices are checked as well, they must never address outside of the ring */
+#define UPLINK_WINDOW_MAGIC 0x57545731
+
+void UplinkWindow::begin(uint16_t sequence)
+{
+    static_assert(CAPACITY > 0 && CAPACITY < UINT16_MAX, "WT_CFG_ACK_WINDOW out of range");
+    static_assert(std::is_trivially_default_constructible<UplinkWindow>::value, "the window must not be initialized at boot");
+
+    if (magic_ == UPLINK_WINDOW_MAGIC && head_ < CAPACITY && count_ <= CAPACITY) {
+        return;
+    }
+
+    magic_ = UPLINK_WINDOW_MAGIC;
+    first_ = sequence;
+    head_ = 0;
+    count_ = 0;
+}
+
+bool UplinkWindow::push(const FixStore::Entry& entry, FixStore::Entry& evicted)
+{
+    bool full = count_ == CAPACITY;
+    if (full) {
+        const Slot& slot = slots_[head_];
+        evicted.timestamp = slot.timestamp;
+        evicted.fix.latitude = slot.latitude;
+        evicted.fix.longitude = slot.longitude;
+        evicted.fix.confidence = slot.confidence;
+        evicted.fix.satellites = slot.satellites;
+
+        head_ = (head_ + 1) % CAPACITY;
+        first_++;
+        count_--;
+    }
+
+    Slot& slot = slots_[(head_ + count_) % CAPACITY];
+    slot.timestamp = entry.timestamp;
+    slot.latitude = entry.fix.latitude;
+    slot.longitude = entry.fix.longitude;
+    slot.confidence = entry.fix.confidence;
+    slot.satellites = entry.fix.satellites;
+    count_++;
+
+    return full;
+}
+
+size_t UplinkWindow::peek(FixStore::Entry* entries, size_t max) const
+{
+    size_t count = count_ < max ? count_ : max;
+    for (size_t i = 0; i < count; i++) {
+        const Slot& slot = slots_[(head_ + i) % CAPACITY];
+        entries[i] = FixStore::Entry();
+        entries[i].timestamp = slot.timestamp;
+        entries[i].fix.latitude = slot.latitude;
+        entries[i].fix.longitude = slot.longitude;
+        entries[i].fix.confidence = slot.confidence;
+        entries[i].fix.satellites = slot.satellites;
+    }
+
+    return count;
+}
+
+size_t UplinkWindow::acknowledge(uint16_t next)
+{
+    /* Sequence numbers wrap, an acknowledgement behind the window or beyond its newest fix is stale or bogus */
+    uint16_t count = next - first_;
+    if (count == 0 || count > count_) {
+        return 0;
+    }
+
+    head_ = (head_ + count) % CAPACITY;
+    first_ = next;
+    count_ -= count;
+
+    return count;
+}
+
+bool UplinkWindow::resync(uint16_t next)
+{
+    /* Half of the sequence space ahead of the window counts as ahead, the other half as behind */
+    uint16_t ahead = next - (uint16_t)(first_ + count_);
+    if (ahead == 0 || ahead >= 0x8000) {
+        return false;
+    }
+
+    first_ = next;
+    return true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "FixStore.h"
+
+/**
+ * @brief Number of unacknowledged fixes the window holds. Once it is full the oldest fix moves to the fix store.
+ */
+#ifndef WT_CFG_ACK_WINDOW
+#define WT_CFG_ACK_WINDOW 32
+#endif
+
+/**
+ * @brief Fixes sent in sequenced batches without CoAP confirmation that the receiver did not acknowledge yet.
+ *
+ * Every fix gets the next sequence number of the device. A sequenced batch always starts at the oldest fix of the
+ * window, so a lost frame is repeated by the next one and a frame that arrived covers everything the receiver is
+ * missing. The receiver answers with the sequence number following the last fix it got, which acknowledges all fixes
+ * in front of it at once.
+ *
+ * The window lives in memory that survives software resets and deep sleep, so unacknowledged fixes and the sequence
+ * numbering outlast a crash. After a power on the memory holds garbage, begin() recognizes that and starts the
+ * numbering over at a random sequence number. That number can land shortly behind the one the receiver expects, which
+ * then takes every frame for a repeat and answers with its own expectation. resync() adopts that expectation, so the
+ * unacknowledged fixes go out again under numbers the receiver takes.
+ *
+ * @note Not thread safe, all calls have to come from the same task.
+ */
+class UplinkWindow {
+public:
+    static constexpr size_t CAPACITY = WT_CFG_ACK_WINDOW;
+
+    /* Trivial, so the window can be placed in memory that is not initialized at boot */
+    UplinkWindow() = default;
+
+    /**
+     * @brief Validate the window after a boot, a window that did not survive the boot starts empty.
+     *
+     * @param sequence Sequence number of the first fix of an empty window.
+     */
+    void begin(uint16_t sequence);
+
+    /**
+     * @brief Append a fix as the newest entry with the next sequence number.
+     *
+     * @param entry The fix and its time.
+     * @param evicted Receives the oldest fix when the window was full.
+     *
+     * @return Whether a fix was evicted to make room.
+     */
+    bool push(const FixStore::Entry& entry, FixStore::Entry& evicted);
+
+    /**
+     * @brief Read the oldest fixes without removing them.
+     *
+     * @param entries Receives up to max entries, oldest first.
+     * @param max Capacity of entries.
+     *
+     * @return The number of entries read, entries[0] has sequence number first().
+     */
+    size_t peek(FixStore::Entry* entries, size_t max) const;
+
+    /**
+     * @brief Remove every fix in front of a sequence number the receiver acknowledged.
+     *
+     * @param next The sequence number following the last fix the receiver got.
+     *
+     * @return The number of fixes removed, 0 for an acknowledgement outside of the window.
+     */
+    size_t acknowledge(uint16_t next);
+
+    /**
+     * @brief Renumber the unacknowledged fixes when the receiver expects a sequence number ahead of the newest fix.
+     *
+     * The receiver never acknowledges a fix it did not get, so such an acknowledgement means it saw these numbers
+     * before the device started its numbering over. One behind the window is a late answer and changes nothing.
+     *
+     * @param next The sequence number following the last fix the receiver got.
+     *
+     * @return Whether the fixes were renumbered, the oldest one now has sequence number next.
+     */
+    bool resync(uint16_t next);
+
+    /**
+     * @brief Sequence number of the oldest fix, or of the next fix while the window is empty.
+     */
+    uint16_t first() const { return first_; }
+
+    /**
+     * @brief Number of unacknowledged fixes.
+     */
+    size_t size() const { return count_; }
+
+private:
+    /* Trivial copy of FixStore::Entry, which has default member initializers */
+    struct Slot {
+        int64_t timestamp;
+        double latitude;
+        double longitude;
+        uint8_t confidence;
+        uint8_t satellites;
+    };
+
+    uint32_t magic_;
+    uint16_t first_;
+    uint16_t head_;                     // slot of the oldest fix
+    uint16_t count_;
+    Slot slots_[CAPACITY];
+};
+
+/**
+ * @brief Fixes waiting for an acknowledgement of the receiver.
+ */
+extern UplinkWindow uplinkWindow;
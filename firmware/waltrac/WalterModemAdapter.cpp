@@ -0,0 +1,108 @@
+#include "WalterModemAdapter.h"
+
+/* The modem driver and its adapter, the rest of the firmware only knows the interface */
+static WalterModem walterModem;
+static WalterModemAdapter walterModemAdapter(walterModem, Serial2);
+
+ModemInterface& modem = walterModemAdapter;
+
+bool WalterModemAdapter::begin()
+{
+    return WalterModem::begin(&uart_);
+}
+
+void WalterModemAdapter::sleep(uint32_t sleepMillis)
+{
+    /* The driver sleeps whole seconds, round up so the ESP32 never wakes before the deadline */
+    WalterModem::sleep((sleepMillis + 999) / 1000);
+}
+
+bool WalterModemAdapter::configPSM(WalterModemPSMMode mode)
+{
+    return modem_.configPSM(mode);
+}
+
+bool WalterModemAdapter::setOpState(WalterModemOpState state)
+{
+    return modem_.setOpState(state);
+}
+
+bool WalterModemAdapter::definePDPContext()
+{
+    return modem_.definePDPContext();
+}
+
+bool WalterModemAdapter::setNetworkSelectionMode(WalterModemNetworkSelMode mode)
+{
+    return modem_.setNetworkSelectionMode(mode);
+}
+
+WalterModemNetworkRegState WalterModemAdapter::getNetworkRegState()
+{
+    return modem_.getNetworkRegState();
+}
+
+void WalterModemAdapter::setRegistrationEventHandler(RegistrationEventHandler handler, void* args)
+{
+    modem_.setRegistrationEventHandler(handler, args);
+}
+
+bool WalterModemAdapter::gnssConfig(WalterModemGNSSSensMode sensMode, WalterModemGNSSAcqMode acqMode)
+{
+    return modem_.gnssConfig(sensMode, acqMode);
+}
+
+bool WalterModemAdapter::gnssPerformAction(WalterModemGNSSAction action)
+{
+    return modem_.gnssPerformAction(action);
+}
+
+bool WalterModemAdapter::gnssGetUTCTime(WalterModemRsp* rsp)
+{
+    return modem_.gnssGetUTCTime(rsp);
+}
+
+bool WalterModemAdapter::gnssGetAssistanceStatus(WalterModemRsp* rsp)
+{
+    return modem_.gnssGetAssistanceStatus(rsp);
+}
+
+bool WalterModemAdapter::gnssUpdateAssistance(WalterModemGNSSAssistanceType type)
+{
+    return modem_.gnssUpdateAssistance(type);
+}
+
+void WalterModemAdapter::gnssSetEventHandler(GnssEventHandler handler, void* args)
+{
+    modem_.gnssSetEventHandler(handler, args);
+}
+
+bool WalterModemAdapter::coapGetContextStatus(int profileId)
+{
+    return modem_.coapGetContextStatus(profileId);
+}
+
+bool WalterModemAdapter::coapCreateContext(int profileId, const char* serverName, int port)
+{
+    return modem_.coapCreateContext(profileId, serverName, port);
+}
+
+bool WalterModemAdapter::coapSetOptions(int profileId, WalterModemCoapOptionAction action, WalterModemCoapOptionCode code, const char* values)
+{
+    return modem_.coapSetOptions(profileId, action, code, values);
+}
+
+bool WalterModemAdapter::coapSendData(int profileId, WalterModemCoapSendType type, WalterModemCoapSendMethodRsp methodRsp, int length, uint8_t* payload)
+{
+    return modem_.coapSendData(profileId, type, methodRsp, length, payload);
+}
+
+bool WalterModemAdapter::coapDidRing(int profileId, uint8_t* targetBuf, uint16_t targetBufSize, WalterModemRsp* rsp)
+{
+    return modem_.coapDidRing(profileId, targetBuf, targetBufSize, rsp);
+}
+
+void WalterModemAdapter::coapSetEventHandler(CoapEventHandler handler, void* args)
+{
+    modem_.coapSetEventHandler(handler, args);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <HardwareSerial.h>
+#include <WalterModem.h>
+
+#include "ModemInterface.h"
+
+/**
+ * @brief ModemInterface on top of the Walter modem library, every call is forwarded as is.
+ */
+class WalterModemAdapter : public ModemInterface {
+public:
+    WalterModemAdapter(WalterModem& modem, HardwareSerial& uart) : modem_(modem), uart_(uart) {}
+
+    bool begin() override;
+    void sleep(uint32_t sleepMillis) override;
+    bool configPSM(WalterModemPSMMode mode) override;
+
+    bool setOpState(WalterModemOpState state) override;
+    bool definePDPContext() override;
+    bool setNetworkSelectionMode(WalterModemNetworkSelMode mode) override;
+    WalterModemNetworkRegState getNetworkRegState() override;
+    void setRegistrationEventHandler(RegistrationEventHandler handler, void* args) override;
+
+    bool gnssConfig(WalterModemGNSSSensMode sensMode, WalterModemGNSSAcqMode acqMode) override;
+    bool gnssPerformAction(WalterModemGNSSAction action) override;
+    bool gnssGetUTCTime(WalterModemRsp* rsp) override;
+    bool gnssGetAssistanceStatus(WalterModemRsp* rsp) override;
+    bool gnssUpdateAssistance(WalterModemGNSSAssistanceType type) override;
+    void gnssSetEventHandler(GnssEventHandler handler, void* args) override;
+
+    bool coapGetContextStatus(int profileId) override;
+    bool coapCreateContext(int profileId, const char* serverName, int port) override;
+    bool coapSetOptions(int profileId, WalterModemCoapOptionAction action, WalterModemCoapOptionCode code, const char* values) override;
+    bool coapSendData(int profileId, WalterModemCoapSendType type, WalterModemCoapSendMethodRsp methodRsp, int length, uint8_t* payload) override;
+    bool coapDidRing(int profileId, uint8_t* targetBuf, uint16_t targetBufSize, WalterModemRsp* rsp) override;
+    void coapSetEventHandler(CoapEventHandler handler, void* args) override;
+
+private:
+    WalterModem& modem_;
+    HardwareSerial& uart_;
+};
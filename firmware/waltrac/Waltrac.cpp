@@ -1,37 +1,119 @@
 #include <esp_log.h>
 
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+
 #include "WaltracConfig.h"
 #include "Waltrac.h"
 
-WalterModem modem = {};
+Messages::Signer signer;
+SeqlockBuffer<WalterModemGNSSFix> gnssFixBuffer;
 WalterModemGNSSFix latestGnssFix = {};
 
-volatile bool gnssFixRcvd = false;
-volatile uint8_t gnssFixNumSatellites = 0;
-volatile uint32_t gnssFixDurationSeconds = 0;
+WT_RETAINED TrackerState trackerState;
+WT_RETAINED GnssValidity gnssValidity;
+WT_RETAINED TtffModel ttffModel;
+WT_RETAINED IntervalTimer intervalTimer(WT_CFG_OVERRUN_SKIP ? IntervalTimer::POLICY_SKIP : IntervalTimer::POLICY_CATCH_UP);
+
+/* Monotonic time at the last wake-up, esp_timer starts over after deep sleep */
+WT_RETAINED static int64_t monotonicBaseMicros = 0;
 
-volatile bool cmdModeActive = true;
+WT_RETAINED MotionPolicy motionPolicy({
+    WT_CFG_INTERVAL_MIN,
+    WT_CFG_INTERVAL_MAX,
+    WT_CFG_STATIONARY_RADIUS,
+    WT_CFG_REPORT_DISTANCE,
+    WT_CFG_TURN_RATE,
+    WT_CFG_HEARTBEAT,
+});
+
+EventGroupHandle_t waltracEvents = nullptr;
+QueueHandle_t gnssUpdates = nullptr;
+SemaphoreHandle_t radioMutex = nullptr;
+
+uint8_t gnssFixNumSatellites = 0;
+volatile uint32_t gnssFixDurationSeconds = 0;
+int64_t gnssRequestMicros = 0;
+int64_t gnssFixMicros = 0;
 
 uint8_t macBuf[6] = {0};
 char macHex[13] = {0};
+WT_RETAINED uint16_t sessionId = 0;
+WT_RETAINED char sessionHex[5] = {0};
+WT_RETAINED bool sessionNamed = false;
 uint8_t incomingBuf[274] = {0};
 
-uint8_t cntMntInv = 0;
-uint8_t cntMntCmd = (60 / WT_CFG_INTERVAL);
+bool initRuntime()
+{
+    waltracEvents = xEventGroupCreate();
+    gnssUpdates = xQueueCreate(GNSS_UPDATE_QUEUE_LENGTH, sizeof(GnssUpdate));
+    radioMutex = xSemaphoreCreateMutex();
+
+    return waltracEvents != nullptr && gnssUpdates != nullptr && radioMutex != nullptr;
+}
+
+int64_t monotonicMicros()
+{
+    return monotonicBaseMicros + esp_timer_get_time();
+}
+
+void advanceMonotonicClock(uint32_t sleepMillis)
+{
+    monotonicBaseMicros += esp_timer_get_time() + (int64_t)sleepMillis * 1000;
+}
+
+void invalidateGnssValidity()
+{
+    gnssValidity = GnssValidity();
+}
+
+void applyMotionBounds(uint32_t interval)
+{
+    uint32_t minInterval = std::max<uint64_t>(1, (uint64_t)interval * WT_CFG_INTERVAL_MIN / WT_CFG_INTERVAL);
+    uint32_t maxInterval = std::max<uint32_t>(WT_CFG_INTERVAL_MAX, minInterval);
+
+    if (!motionPolicy.setBounds(minInterval, maxInterval)) {
+        ESP_LOGW("Waltrac", "Could not apply motion bounds for a %us interval.", (unsigned)interval);
+    }
+}
+
+/* Mirror a registration state into the LTE event bits */
+static void setRegistrationBits(WalterModemNetworkRegState state)
+{
+    if (state == WALTER_MODEM_NETWORK_REG_REGISTERED_HOME || state == WALTER_MODEM_NETWORK_REG_REGISTERED_ROAMING) {
+        xEventGroupClearBits(waltracEvents, WT_EVENT_LTE_DETACHED);
+        xEventGroupSetBits(waltracEvents, WT_EVENT_LTE_REGISTERED);
+    } else if (state == WALTER_MODEM_NETWORK_REG_NOT_SEARCHING) {
+        xEventGroupClearBits(waltracEvents, WT_EVENT_LTE_REGISTERED);
+        xEventGroupSetBits(waltracEvents, WT_EVENT_LTE_DETACHED);
+    } else {
+        xEventGroupClearBits(waltracEvents, WT_EVENT_LTE_REGISTERED | WT_EVENT_LTE_DETACHED);
+    }
+}
+
+void registrationEventHandler(WalterModemNetworkRegState state, void* /* args */)
+{
+    setRegistrationBits(state);
+}
+
+/* Block until one of the LTE event bits is set, the bits are seeded from the current state first */
+static bool waitForRegistrationBits(EventBits_t bits, uint32_t timeoutSeconds)
+{
+    setRegistrationBits(modem.getNetworkRegState());
+
+    EventBits_t result = xEventGroupWaitBits(waltracEvents, bits, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutSeconds * 1000));
+    return (result & bits) != 0;
+}
 
 bool waitForNetwork()
 {
-    /* Wait for the network to become available */
-    int timeout = 0;
-    while (!isLteConnected()) {
-        delay(1000);
+    /* Wait for the network to become available, registrationEventHandler wakes us up */
+    if (!waitForRegistrationBits(WT_EVENT_LTE_REGISTERED, MAX_NETWORK_TIMEOUT_SECONDS)) {
+        ESP_LOGE("Waltrac", "Network connection timeout reached.");
 
-        if (timeout++ >= MAX_NETWORK_TIMEOUT_SECONDS) {
-            ESP_LOGE("Waltrac", "Network connection timeout reached.");
-            
-            lteDisconnect(); 
-            return false;
-        }
+        lteDisconnect(); 
+        return false;
     }
 
     ESP_LOGI("Waltrac", "Connected to the network.");
@@ -40,6 +122,8 @@ bool waitForNetwork()
 
 bool lteConnect() 
 {
+    PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_ATTACH);
+
     /* Set operational state */
     if (modem.setOpState(WALTER_MODEM_OPSTATE_NO_RF)) {
         ESP_LOGD("Waltrac", "Successfully set operational state to NO RF.");
@@ -83,6 +167,8 @@ bool isLteConnected()
 
 bool lteDisconnect()
 {
+    PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_DETACH);
+
     /* Set the operational state to minimum */
     if(modem.setOpState(WALTER_MODEM_OPSTATE_MINIMUM)) {
         ESP_LOGD("Waltrac", "Successfully set operational state to MINIMUM.");
@@ -91,11 +177,10 @@ bool lteDisconnect()
         return false;
     }
 
-    /* Wait for the network to become available */
-    WalterModemNetworkRegState regState = modem.getNetworkRegState();
-    while(regState != WALTER_MODEM_NETWORK_REG_NOT_SEARCHING) {
-        delay(100);
-        regState = modem.getNetworkRegState();
+    /* Wait for the modem to stop searching, registrationEventHandler wakes us up */
+    if (!waitForRegistrationBits(WT_EVENT_LTE_DETACHED, MAX_NETWORK_TIMEOUT_SECONDS)) {
+        ESP_LOGE("Waltrac", "Network disconnect timeout reached.");
+        return false;
     }
 
     ESP_LOGD("Waltrac", "Disconnected from the network.");
@@ -138,6 +223,16 @@ bool checkAssistanceStatus(WalterModemRsp* rsp, bool* updateAlmanac, bool* updat
     reportAndSetUpdateFlag("Almanac", rsp->data.gnssAssistance.almanac, updateAlmanac);
     reportAndSetUpdateFlag("Realtime Ephemeris", rsp->data.gnssAssistance.realtimeEphemeris, updateEphemeris);
 
+    /* Remember when each data set is due, missing data is due right away */
+    auto expiresMicros = [](const auto& data, int64_t now) {
+        return data.available && data.timeToUpdate > 0 ? now + (int64_t)data.timeToUpdate * 1000000 : now;
+    };
+
+    int64_t now = monotonicMicros();
+    gnssValidity.assistanceKnown = true;
+    gnssValidity.almanacExpiresMicros = expiresMicros(rsp->data.gnssAssistance.almanac, now);
+    gnssValidity.ephemerisExpiresMicros = expiresMicros(rsp->data.gnssAssistance.realtimeEphemeris, now);
+
     return true;
 }
 
@@ -146,6 +241,15 @@ bool updateGNSSAssistance(WalterModemRsp* rsp)
     bool updateAlmanac = false;
     bool updateEphemeris = false;
 
+    PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_ASSISTANCE);
+
+    /* Nothing expires soon, the modem does not have to be asked */
+    int64_t dueMicros = monotonicMicros() + (int64_t)GNSS_ASSISTANCE_MARGIN_SECONDS * 1000000;
+    if(gnssValidity.assistanceKnown && gnssValidity.almanacExpiresMicros > dueMicros && gnssValidity.ephemerisExpiresMicros > dueMicros) {
+        ESP_LOGD("Waltrac", "GNSS assistance up-to-date according to cache. No update needed.");
+        return true;
+    }
+
     /* Get the latest assistance data */
     if(!checkAssistanceStatus(rsp, &updateAlmanac, &updateEphemeris)) {
         ESP_LOGE("Waltrac", "Could not check GNSS assistance status.");
@@ -159,7 +263,7 @@ bool updateGNSSAssistance(WalterModemRsp* rsp)
     }
 
     /* Connect to LTE to download assistance data */
-    if(!isLteConnected() && !lteConnect()) {
+    if(!radioScheduler.enterLte()) {
         return false;
     }
 
@@ -195,16 +299,28 @@ bool updateGNSSAssistance(WalterModemRsp* rsp)
 
 bool validateGNSSClock(WalterModemRsp* rsp)
 {
+    PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_CLOCK);
+
+    /* A clock seen valid recently is still valid, the modem keeps it running */
+    int64_t now = monotonicMicros();
+    if(gnssValidity.clockValid && now - gnssValidity.clockCheckedMicros < (int64_t)GNSS_CLOCK_RECHECK_SECONDS * 1000000) {
+        return true;
+    }
+
     /* Validate the GNSS subsystem clock */
     modem.gnssGetUTCTime(rsp);
     if(rsp->data.clock.epochTime > 4) {
+        gnssValidity.clockValid = true;
+        gnssValidity.clockCheckedMicros = now;
         return true;
     }
 
+    gnssValidity.clockValid = false;
+
     ESP_LOGI("Waltrac", "System clock invalid, LTE time sync required.");
 
     /* Connect to LTE (required for time sync) */
-    if(!isLteConnected() && !lteConnect()) {
+    if(!radioScheduler.enterLte()) {
         ESP_LOGE("Waltrac", "Could not connect to LTE network.");
         return false;
     }
@@ -215,6 +331,9 @@ bool validateGNSSClock(WalterModemRsp* rsp)
         modem.gnssGetUTCTime(rsp);
         if(rsp->data.clock.epochTime > 4) {
             ESP_LOGI("Waltrac", "System clock synchronized to UNIX timestamp %" PRIi64 ".", rsp->data.clock.epochTime);
+
+            gnssValidity.clockValid = true;
+            gnssValidity.clockCheckedMicros = monotonicMicros();
             return true;
         }
 
@@ -225,11 +344,62 @@ bool validateGNSSClock(WalterModemRsp* rsp)
     return false;
 }
 
-void gnssEventHandler(const WalterModemGNSSFix* fix, void* args)
+bool prepareGnss()
 {
-    latestGnssFix = *fix;
-    gnssFixRcvd = true;
-    
+    WalterModemRsp rsp = {};
+
+    /* Both only attach when needed, inside an LTE window they ride on the open connection */
+    if(!validateGNSSClock(&rsp)) {
+        ESP_LOGW("Waltrac", "Could not validate GNSS clock in the LTE window.");
+        return false;
+    }
+
+    if(!updateGNSSAssistance(&rsp)) {
+        ESP_LOGW("Waltrac", "Could not update GNSS assistance data in the LTE window.");
+        return false;
+    }
+
+    return true;
+}
+
+void gnssEventHandler(const WalterModemGNSSFix* fix, void* /* args */)
+{
+    /* Only a copy here, statistics and logging happen in waitForGnssFix */
+    gnssFixBuffer.publish(*fix);
+    xEventGroupSetBits(waltracEvents, WT_EVENT_GNSS_FIX);
+}
+
+/* Start a GNSS attempt, a fix left over from an earlier attempt is dropped */
+static bool requestGnssFix()
+{
+    xEventGroupClearBits(waltracEvents, WT_EVENT_GNSS_FIX);
+    gnssFixBuffer.discard();
+
+    gnssRequestMicros = monotonicMicros();
+    gnssFixDurationSeconds = 0;
+
+    return modem.gnssPerformAction();
+}
+
+/* Block until gnssEventHandler reports a fix, at most maxDurationSeconds since the attempt was requested */
+static bool waitForGnssFix(uint32_t maxDurationSeconds)
+{
+    int64_t elapsedMicros = monotonicMicros() - gnssRequestMicros;
+    int64_t remainingMicros = (int64_t)maxDurationSeconds * 1000000 - elapsedMicros;
+    if (remainingMicros < 0) {
+        remainingMicros = 0;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(waltracEvents, WT_EVENT_GNSS_FIX, pdTRUE, pdFALSE, pdMS_TO_TICKS(remainingMicros / 1000));
+    int64_t now = monotonicMicros();
+    gnssFixDurationSeconds = (now - gnssRequestMicros) / 1000000;
+
+    if (!(bits & WT_EVENT_GNSS_FIX) || !gnssFixBuffer.consume(latestGnssFix)) {
+        return false;
+    }
+
+    gnssFixMicros = now;
+
     /* Count satellites with good signal strength */
     gnssFixNumSatellites = 0;
     for(int i = 0; i < latestGnssFix.satCount; ++i) {
@@ -240,7 +410,7 @@ void gnssEventHandler(const WalterModemGNSSFix* fix, void* args)
 
     ESP_LOGI("Waltrac", "Received GNSS fix to %.06f, %.06f with %d satellites after %ds.", latestGnssFix.latitude, latestGnssFix.longitude, gnssFixNumSatellites, gnssFixDurationSeconds);
 
-    gnssFixDurationSeconds = 0;
+    return true;
 }
 
 bool waitForInitialGnssFix() 
@@ -257,8 +427,8 @@ bool waitForInitialGnssFix()
         ESP_LOGW("Waltrac", "Could not update GNSS assistance data. Continuing without assistance.");
     }
 
-    /* Disconnect from the network if network is connected or in lookup (Required for GNSS) */
-    if(!lteDisconnect()) {
+    /* Open the GNSS window, detaches only if the last window was LTE (Required for GNSS) */
+    if(!radioScheduler.enterGnss()) {
         ESP_LOGE("Waltrac", "Could not disconnect from the LTE network.");
         return false;
     }
@@ -272,24 +442,25 @@ bool waitForInitialGnssFix()
     
     const uint8_t maxGnssFixAttempts = MAX_GNSS_FIX_ATTEMPTS;
     for (uint8_t i = 0; i < maxGnssFixAttempts; i++) {
-        
-        gnssFixRcvd = false;
-        if(!modem.gnssPerformAction()) {
+        PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_GNSS);
+        if (i > 0) {
+            phaseStats.count(PhaseStats::COUNTER_GNSS_RETRIES);
+        }
+
+        if(!requestGnssFix()) {
             ESP_LOGE("Waltrac", "Could not request GNSS fix.");
             return false;
         }
 
         ESP_LOGI("Waltrac", "Waiting for GNSS lookup attempt %d/%d ...", (i + 1), maxGnssFixAttempts);
-        while(!gnssFixRcvd) {
-            delay(1000);
 
-            // restart the ESP when there're more than 5 minutes passed without a valid GNSS signal
-            if (gnssFixDurationSeconds++ >= 300) {
-                ESP_LOGI("Waltrac", "GNSS lookup timeout after %ds. Restarting ESP ...", gnssFixDurationSeconds);
+        // restart the ESP when there're more than 5 minutes passed without a valid GNSS signal
+        if (!waitForGnssFix(300)) {
+            ESP_LOGI("Waltrac", "GNSS lookup timeout after %ds. Restarting ESP ...", gnssFixDurationSeconds);
+            phaseStats.count(PhaseStats::COUNTER_GNSS_TIMEOUTS);
 
-                delay(500);
-                ESP.restart();
-            }
+            delay(500);
+            ESP.restart();
         }
 
         /* If confidence is acceptable, stop trying. Otherwise, try again */
@@ -323,8 +494,8 @@ bool attemptGnssFix(uint32_t numAttempts)
         ESP_LOGW("Waltrac", "Could not update GNSS assistance data. Continuing without assistance.");
     }
 
-    /* Disconnect from the network if network is connected or in lookup (Required for GNSS) */
-    if(!lteDisconnect()) {
+    /* Open the GNSS window, detaches only if the last window was LTE (Required for GNSS) */
+    if(!radioScheduler.enterGnss()) {
         ESP_LOGE("Waltrac", "Could not disconnect from the LTE network.");
         return false;
     }
@@ -337,37 +508,39 @@ bool attemptGnssFix(uint32_t numAttempts)
     }
 
     for (uint8_t i = 0; i < numAttempts; i++) {
+        PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_GNSS);
+        if (i > 0) {
+            phaseStats.count(PhaseStats::COUNTER_GNSS_RETRIES);
+        }
 
-        gnssFixRcvd = false;
-        if(!modem.gnssPerformAction()) {
+        if(!requestGnssFix()) {
             ESP_LOGE("Waltrac", "Could not request GNSS fix.");
             return false;
         }
 
         ESP_LOGI("Waltrac", "Waiting for GNSS fix attempt %d/%d ...", (i + 1), numAttempts);
-        while(!gnssFixRcvd) {
-            delay(1000);
 
-            if (gnssFixDurationSeconds++ >= MAX_GNSS_FIX_DURATION_SECONDS) {
-                ESP_LOGW("Waltrac", "GNSS fix timeout after %ds. Cancelling GNSS fix ...", gnssFixDurationSeconds);
+        bool fixReceived = waitForGnssFix(MAX_GNSS_FIX_DURATION_SECONDS);
+        if (!fixReceived) {
+            ESP_LOGW("Waltrac", "GNSS fix timeout after %ds. Cancelling GNSS fix ...", gnssFixDurationSeconds);
+            phaseStats.count(PhaseStats::COUNTER_GNSS_TIMEOUTS);
+
+            /* Stale clock or assistance data may be the reason, check both again before the next fix */
+            invalidateGnssValidity();
 
-                if (modem.gnssPerformAction(WALTER_MODEM_GNSS_ACTION_CANCEL)) {
-                    ESP_LOGD("Waltrac", "Cancelled GNSS fix.");
-                    
-                    gnssFixDurationSeconds = 0;
+            if (modem.gnssPerformAction(WALTER_MODEM_GNSS_ACTION_CANCEL)) {
+                ESP_LOGD("Waltrac", "Cancelled GNSS fix.");
 
-                    delay(1000);
-                    break;
-                } else {
-                    ESP_LOGE("Waltrac", "Could not cancel GNSS fix. Restarting ESP ...");
+                delay(1000);
+            } else {
+                ESP_LOGE("Waltrac", "Could not cancel GNSS fix. Restarting ESP ...");
 
-                    delay(500);
-                    ESP.restart();
-                }
+                delay(500);
+                ESP.restart();
             }
         }
 
-        if (gnssFixRcvd) {
+        if (fixReceived) {
             /* If confidence is acceptable, stop trying. Otherwise, try again */
             if(latestGnssFix.estimatedConfidence <= MAX_GNSS_CONFIDENCE) {
                 ESP_LOGI("Waltrac", "GNSS fix acceptable with confidence %.02f, found %d satellites.", latestGnssFix.estimatedConfidence, gnssFixNumSatellites);
@@ -385,22 +558,97 @@ bool attemptGnssFix(uint32_t numAttempts)
     return false;
 }
 
-void coapEventHandler(WalterModemCoapEvent event, int profileId, void *args) 
+void coapEventHandler(WalterModemCoapEvent event, int profileId, void* /* args */) 
+{
+    if (profileId != COAP_PROFILE) {
+        return;
+    }
+
+    if (event == WALTER_MODEM_COAP_EVENT_DISCONNECTED) {
+        xEventGroupSetBits(waltracEvents, WT_EVENT_COAP_CLOSED);
+    } else if (event == WALTER_MODEM_COAP_EVENT_RING) {
+        xEventGroupSetBits(waltracEvents, WT_EVENT_COAP_RING);
+    }
+}
+
+/* URI path the modem holds for the CoAP profile. Options stay set between requests, but not over a new context */
+static char coapPath[48] = "";
+
+/* Point the next request at a resource, the modem is only asked when it holds a different path */
+static bool coapSetPath(std::initializer_list<const char*> segments)
+{
+    static_assert(WT_CFG_COAP_OPTION_VALUES >= 1 && WT_CFG_COAP_OPTION_VALUES <= 6, "CoAP option values out of range");
+
+    char path[sizeof(coapPath)] = "";
+    size_t pathLen = 0;
+    for (const char* segment : segments) {
+        int written = snprintf(path + pathLen, sizeof(path) - pathLen, "/%s", segment);
+        if (written < 0 || (size_t)written >= sizeof(path) - pathLen) {
+            return false;
+        }
+
+        pathLen += written;
+    }
+
+    if (strcmp(path, coapPath) == 0) {
+        return true;
+    }
+
+    /* Unknown until every command went through */
+    coapPath[0] = '\0';
+
+    /* Several segments per command, the first one replaces the path and the rest extend it */
+    const char* const* segment = segments.begin();
+    WalterModemCoapOptionAction action = WALTER_MODEM_COAP_OPT_SET;
+    while (segment != segments.end()) {
+        char values[sizeof(coapPath)] = "";
+        size_t valuesLen = 0;
+
+        for (uint8_t n = 0; n < WT_CFG_COAP_OPTION_VALUES && segment != segments.end(); n++, segment++) {
+            valuesLen += snprintf(values + valuesLen, sizeof(values) - valuesLen, n == 0 ? "%s" : ",%s", *segment);
+        }
+
+        if (!modem.coapSetOptions(COAP_PROFILE, action, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, values)) {
+            return false;
+        }
+
+        action = WALTER_MODEM_COAP_OPT_EXTEND;
+    }
+
+    strcpy(coapPath, path);
+    return true;
+}
+
+/* Whether the command resource is observed in the current context, the receiver acknowledges sequenced batches there */
+static bool coapObserving = false;
+
+/* Hand a request to the modem, timed as one send phase */
+static bool coapSend(WalterModemCoapSendType type, WalterModemCoapSendMethodRsp method, uint8_t* data, size_t dataLen)
 {
-    if (event == WALTER_MODEM_COAP_EVENT_DISCONNECTED && profileId == COAP_PROFILE) {
-        cmdModeActive = false;
+    PhaseStats::Span span(phaseStats, Messages::TELEMETRY_PHASE_SEND);
+
+    if (!modem.coapSendData(COAP_PROFILE, type, method, dataLen, data)) {
+        phaseStats.count(PhaseStats::COUNTER_SEND_FAILURES);
+        return false;
     }
+
+    return true;
 }
 
 bool coapConnect() 
 {    
     /* Enable LTE network and create CoAP context. */
-    if (!isLteConnected() && !lteConnect()) {
+    if (!radioScheduler.enterLte()) {
         return false;
     }
 
     /* Configure CoAP context */
     if (!modem.coapGetContextStatus(COAP_PROFILE)) {
+        /* A new context starts without options and observations, and the close of the last one is history */
+        coapPath[0] = '\0';
+        coapObserving = false;
+        xEventGroupClearBits(waltracEvents, WT_EVENT_COAP_CLOSED);
+
         if (modem.coapCreateContext(COAP_PROFILE, WT_SERVER_HOST, WT_SERVER_PORT)) {
             ESP_LOGD("Waltrac", "CoAP server context created successfully.");
             return true;
@@ -414,58 +662,115 @@ bool coapConnect()
     return true;
 }
 
-bool coapSendPositionUpdate(uint8_t* data, size_t dataLen) 
+bool coapSendPositionUpdate(uint8_t* data, size_t dataLen, WalterModemCoapSendType type) 
 {    
     if (!coapConnect()) {
         return false;
     }
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "ps")) {
+    /* Once a session is assigned the server looks the device up by its session ID */
+    if (!coapSetPath({"ps", "waltrac", "pos", sessionId != 0 ? sessionHex : macHex})) {
         return false;
     }
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "waltrac")) {
+    if (!coapSend(type, WALTER_MODEM_COAP_SEND_METHOD_POST, data, dataLen)) {
         return false;
     }
-    
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "pos")) {
+
+    return true;
+}
+
+bool sendPositionUpdate(const GnssUpdate& update)
+{
+    /* Messages and send buffer are reused between intervals, so serializing needs no vector. The names keep their
+       capacity and only allocate when a longer name comes in */
+    static Messages::Position position;
+    static Messages::SessionPosition sessionPosition;
+    static uint8_t positionBuf[std::max(Messages::Position::MAX_SIZE, Messages::SessionPosition::MAX_SIZE)];
+
+    size_t positionLen = 0;
+    if (sessionId != 0) {
+        sessionPosition.setHeader(update.valid);
+        sessionPosition.interval = update.interval;
+        sessionPosition.confidence = update.fix.confidence;
+        sessionPosition.satellites = update.fix.satellites;
+        sessionPosition.session = sessionId;
+        sessionPosition.latitude = update.fix.latitude;
+        sessionPosition.longitude = update.fix.longitude;
+        sessionPosition.name = sessionNamed ? "" : runtimeConfig.name();
+
+        positionLen = sessionPosition.serialize(positionBuf, sizeof(positionBuf), signer);
+        if (positionLen == 0 || !coapSendPositionUpdate(positionBuf, positionLen)) {
+            return false;
+        }
+
+        /* Only a delivered name counts as known to the server */
+        sessionNamed = true;
+
+        return true;
+    }
+
+    position.setHeader(update.valid);
+    position.interval = update.interval;
+    position.confidence = update.fix.confidence;
+    position.satellites = update.fix.satellites;
+    memcpy(position.device, macBuf, 6);
+    position.latitude = update.fix.latitude;
+    position.longitude = update.fix.longitude;
+    position.name = runtimeConfig.name();
+
+    positionLen = position.serialize(positionBuf, sizeof(positionBuf), signer);
+    return positionLen > 0 && coapSendPositionUpdate(positionBuf, positionLen);
+}
+
+bool coapSendTelemetry(uint8_t* data, size_t dataLen)
+{
+    if (!coapConnect()) {
         return false;
     }
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, macHex)) {
+    if (!coapSetPath({"ps", "waltrac", "tel", macHex})) {
         return false;
     }
 
-    if (!modem.coapSendData(COAP_PROFILE, WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_POST, dataLen, data)) {
+    if (!coapSend(WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_POST, data, dataLen)) {
         return false;
     }
 
     return true;
 }
 
-bool coapSendCommand(uint8_t* data, size_t dataLen) 
-{    
-    if (!coapConnect()) {
-        return false;
-    }
+bool sendTelemetry()
+{
+    static Messages::Telemetry telemetry;
+    static uint8_t telemetryBuf[Messages::Telemetry::MAX_SIZE];
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "ps")) {
-        return false;
-    }
+    telemetry.setHeader();
+    memcpy(telemetry.device, macBuf, 6);
+    phaseStats.report(telemetry, monotonicMicros());
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "waltrac")) {
+    size_t telemetryLen = telemetry.serialize(telemetryBuf, sizeof(telemetryBuf), signer);
+    if (telemetryLen == 0 || !coapSendTelemetry(telemetryBuf, telemetryLen)) {
         return false;
     }
-    
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "cmd")) {
+
+    ESP_LOGI("Waltrac", "Sent telemetry of the last %us, %u restarts, %u crashes.", (unsigned)telemetry.window, telemetry.restarts, telemetry.crashes);
+
+    phaseStats.reset(monotonicMicros());
+    return true;
+}
+
+bool coapSendCommand(uint8_t* data, size_t dataLen) 
+{    
+    if (!coapConnect()) {
         return false;
     }
 
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "control")) {
+    if (!coapSetPath({"ps", "waltrac", "cmd", "control"})) {
         return false;
     }
 
-    if (!modem.coapSendData(COAP_PROFILE, WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_POST, dataLen, data)) {
+    if (!coapSend(WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_POST, data, dataLen)) {
         return false;
     }
 
@@ -478,71 +783,358 @@ bool coapSubscribeCommands()
         return false;
     }
     
-    // /ps
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "ps")) {
+    // /ps/waltrac/cmd/{deviceId}
+    if (!coapSetPath({"ps", "waltrac", "cmd", macHex})) {
         return false;
     }
 
-    // /waltrac
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "waltrac")) {
+    // set Observe = 0
+    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_OBSERVE, "0")) {
         return false;
     }
-    
-    // /command
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, "cmd")) {
+
+    // set Token
+    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_TOKEN, macHex)) {
         return false;
     }
 
-    // /{deviceId}
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_EXTEND, WALTER_MODEM_COAP_OPT_CODE_URI_PATH, macHex)) {
+    if (!coapSend(WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_GET, nullptr, 0)) {
         return false;
     }
 
-    // set Observe = 0
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_OBSERVE, "0")) {
+    coapObserving = true;
+    return true;
+}
+
+bool getCommand(Messages::CommandView &command)
+{    
+    WalterModemRsp rsp = {};
+
+    if (modem.coapDidRing(COAP_PROFILE, incomingBuf, sizeof(incomingBuf), &rsp)) {
+        if (rsp.data.coapResponse.length > 0) {
+            /* Parse and authenticate in place, the view refers to incomingBuf until the next call */
+            Messages::DecodeStatus status = command.decode(incomingBuf, rsp.data.coapResponse.length, signer);
+            if (status == Messages::DECODE_STATUS_BAD_MAC) {
+                ESP_LOGE("Waltrac", "Verification of the incoming command failed.");
+                return false;
+            } else if (status != Messages::DECODE_STATUS_OK) {
+                ESP_LOGE("Waltrac", "Failed to parse incoming data as command (%s).", Messages::decodeStatusName(status));
+                return false;
+            }
+
+            ESP_LOGI("Waltrac", "Command verified successfully.");
+
+            return true;
+        } else {
+            return false;
+        }
+    } else {
         return false;
     }
+}
 
-    // set Token
-    if(!modem.coapSetOptions(COAP_PROFILE, WALTER_MODEM_COAP_OPT_SET, WALTER_MODEM_COAP_OPT_CODE_TOKEN, macHex)) {
+/* Parse a command argument of up to five decimal digits */
+static bool parseDecimal(std::string_view arg, uint32_t& value)
+{
+    if (arg.empty() || arg.size() > 5) {
         return false;
     }
 
-    if (!modem.coapSendData(COAP_PROFILE, WALTER_MODEM_COAP_SEND_TYPE_CON, WALTER_MODEM_COAP_SEND_METHOD_GET, 0, nullptr)) {
+    value = 0;
+    for (char c : arg) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        value = value * 10 + (c - '0');
+    }
+
+    return true;
+}
+
+bool setSession(std::string_view arg)
+{
+    uint32_t value = 0;
+    if (!parseDecimal(arg, value) || value == 0 || value > UINT16_MAX) {
         return false;
     }
 
+    sessionId = value;
+    sprintf(sessionHex, "%04x", sessionId);
+    sessionNamed = false;
+
     return true;
 }
 
-bool getCommand(Messages::Command &command)
-{    
-    WalterModemRsp rsp = {};
-    uint8_t buffer[274] = {0};
+bool sendBacklog(int64_t now)
+{
+    static_assert(WT_CFG_BACKLOG_BATCH_SIZE > 0 && WT_CFG_BACKLOG_BATCH_SIZE <= Messages::PositionBatch::MAX_FIXES, "backlog batch size out of range");
 
-    if (modem.coapDidRing(COAP_PROFILE, buffer, sizeof(buffer), &rsp)) {
-        if (rsp.data.coapResponse.length > 0) {
-            try {
-                std::vector<uint8_t> data(buffer, buffer + rsp.data.coapResponse.length);
+    static Messages::PositionBatch batch;
+    static FixStore::Entry entries[WT_CFG_BACKLOG_BATCH_SIZE];
+    static uint8_t batchBuf[Messages::PositionBatch::MAX_SIZE];
+
+    for (uint8_t frame = 0; frame < WT_CFG_BACKLOG_FRAMES && fixStore.size() > 0; frame++) {
+        size_t count = fixStore.peek(entries, WT_CFG_BACKLOG_BATCH_SIZE);
+        if (count == 0) {
+            return false;
+        }
 
-                command = Messages::Command::init(data);
-                ESP_LOGD("Waltrac", "Got command from server.");
+        batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            /* Fixes older than the age field can express are sent with the maximum age */
+            int64_t age = now - entries[i].timestamp;
+            entries[i].fix.age = age < 0 ? 0 : (age > UINT16_MAX ? UINT16_MAX : age);
+            batch.addFix(entries[i].fix);
+        }
 
-                if (command.verify(WT_CFG_SECRET)) {
-                    ESP_LOGI("Waltrac", "Command verified successfully.");
-                } else {
-                    ESP_LOGE("Waltrac", "Verification of the incoming command failed.");
-                }
+        batch.setHeader(true, WT_CFG_BATCH_COMPACT);
+        batch.interval = runtimeConfig.interval() > UINT8_MAX ? UINT8_MAX : runtimeConfig.interval();
+        memcpy(batch.device, macBuf, 6);
+        batch.name = runtimeConfig.name();
 
-                return true;
-            } catch(const std::runtime_error &e) {
-                ESP_LOGE("Waltrac", "Failed to parse incoming data as command.");
-                return false;
-            }
-        } else {
+        size_t batchLen = batch.serialize(batchBuf, sizeof(batchBuf), signer);
+        if (batchLen == 0 || !coapSendPositionUpdate(batchBuf, batchLen)) {
+            ESP_LOGW("Waltrac", "Could not send stored fixes, %u remain in the backlog.", (unsigned)fixStore.size());
             return false;
         }
+
+        fixStore.pop(count);
+        delay(250);
+
+        ESP_LOGI("Waltrac", "Sent %u stored fixes, %u remain in the backlog.", (unsigned)count, (unsigned)fixStore.size());
+    }
+
+    return true;
+}
+
+bool acknowledgeFixes(std::string_view arg)
+{
+    uint32_t value = 0;
+    if (!parseDecimal(arg, value) || value > UINT16_MAX) {
+        return false;
+    }
+
+    size_t acknowledged = uplinkWindow.acknowledge(value);
+    if (acknowledged > 0) {
+        ESP_LOGD("Waltrac", "Receiver acknowledged %u fixes, %u wait for an acknowledgement.", (unsigned)acknowledged, (unsigned)uplinkWindow.size());
+    } else if (uplinkWindow.resync(value)) {
+        ESP_LOGW("Waltrac", "Receiver expects fix %u, renumbered %u unacknowledged fixes.", (unsigned)value, (unsigned)uplinkWindow.size());
+    }
+
+    return true;
+}
+
+/* Applies one verified command and tells whether it was EXIT, which ends the waiting for commands */
+static bool applyCommand(const Messages::CommandView& command)
+{
+    Messages::CommandAction action;
+    command.getHeader(action);
+
+    if (action == Messages::COMMAND_ACTION_EXIT) {
+        ESP_LOGD("Waltrac", "Received command EXIT.");
+        return true;
+    } else if (action == Messages::COMMAND_ACTION_SETSESSION) {
+        if (setSession(command.arg())) {
+            ESP_LOGI("Waltrac", "Assigned session %s, sending compact position updates.", sessionHex);
+        } else {
+            ESP_LOGW("Waltrac", "Received invalid session ID.");
+        }
+    } else if (action == Messages::COMMAND_ACTION_ACK) {
+        acknowledgeFixes(command.arg());
+    } else if (action == Messages::COMMAND_ACTION_SETINTERVAL) {
+        uint32_t seconds = 0;
+        if (parseDecimal(command.arg(), seconds) && runtimeConfig.setInterval(seconds)) {
+            applyMotionBounds(seconds);
+            ESP_LOGI("Waltrac", "Interval set to %us.", (unsigned)seconds);
+        } else {
+            ESP_LOGW("Waltrac", "Received invalid interval.");
+        }
+    } else if (action == Messages::COMMAND_ACTION_SETNAME) {
+        if (runtimeConfig.setName(command.arg())) {
+            sessionNamed = false;
+            ESP_LOGI("Waltrac", "Name set to %s.", runtimeConfig.name());
+        } else {
+            ESP_LOGW("Waltrac", "Received invalid name.");
+        }
     } else {
+        ESP_LOGD("Waltrac", "Unknown command.");
+    }
+
+    return false;
+}
+
+/* Applies the commands that arrived and returns how many, exitReceived tells whether one of them was EXIT */
+static size_t applyCommands(bool& exitReceived)
+{
+    Messages::CommandView command;
+    size_t applied = 0;
+
+    exitReceived = false;
+    while (getCommand(command)) {
+        exitReceived |= applyCommand(command);
+        applied++;
+    }
+
+    return applied;
+}
+
+static size_t applyCommands()
+{
+    bool exitReceived = false;
+    return applyCommands(exitReceived);
+}
+
+/* Waits up to waitMillis for commands and applies them. The wait ends with the first commands, or with EXIT if untilExit is set */
+static bool waitForCommands(uint32_t waitMillis, bool untilExit)
+{
+    uint32_t waitStart = millis();
+    uint32_t waited = 0;
+    bool done = false;
+
+    while (!done && waited < waitMillis) {
+        EventBits_t bits = xEventGroupWaitBits(waltracEvents, WT_EVENT_COAP_RING | WT_EVENT_COAP_CLOSED, pdTRUE, pdFALSE, pdMS_TO_TICKS(waitMillis - waited));
+        if (bits & WT_EVENT_COAP_CLOSED) {
+            return false;
+        }
+
+        bool exitReceived = false;
+        size_t applied = applyCommands(exitReceived);
+        done = untilExit ? exitReceived : applied > 0;
+
+        waited = millis() - waitStart;
+    }
+
+    return true;
+}
+
+/* Wait until the receiver acknowledged the count fixes from sequence on, commands arriving meanwhile are applied as well.
+   A resync moves the window ahead of the frame as well and ends the waiting, the next frame carries the new numbers */
+static bool waitForAck(uint16_t sequence, size_t count)
+{
+    uint32_t waitStart = millis();
+    uint32_t waited = 0;
+
+    while ((uint16_t)(uplinkWindow.first() - sequence) < count && waited < WT_CFG_ACK_WAIT_MILLIS) {
+        EventBits_t bits = xEventGroupWaitBits(waltracEvents, WT_EVENT_COAP_RING | WT_EVENT_COAP_CLOSED, pdTRUE, pdFALSE, pdMS_TO_TICKS(WT_CFG_ACK_WAIT_MILLIS - waited));
+        if (bits & WT_EVENT_COAP_CLOSED) {
+            return false;
+        }
+
+        applyCommands();
+        waited = millis() - waitStart;
+    }
+
+    return (uint16_t)(uplinkWindow.first() - sequence) >= count;
+}
+
+/* Every boot but a wake-up from deep sleep announces the device again, read by the GNSS side as well */
+WT_RETAINED static volatile bool discoverPending = true;
+
+/* When the command resource was last polled, in monotonicMicros() */
+WT_RETAINED static int64_t commandsPolledMicros = 0;
+
+bool discoveryPending()
+{
+    return discoverPending;
+}
+
+bool serviceCommands()
+{
+    if (discoverPending) {
+        Messages::Command command;
+        command.setHeader(Messages::COMMAND_ACTION_DISCOVER);
+        command.arg = macHex;
+
+        uint8_t commandBuf[Messages::Command::MAX_SIZE];
+        size_t commandLen = command.serialize(commandBuf, sizeof(commandBuf), signer);
+        if (commandLen == 0 || !coapSendCommand(commandBuf, commandLen)) {
+            ESP_LOGW("Waltrac", "Could not send discover command, trying again with the next LTE window.");
+            return false;
+        }
+
+        discoverPending = false;
+        commandsPolledMicros = monotonicMicros();
+
+        if (!coapSubscribeCommands()) {
+            ESP_LOGW("Waltrac", "Cannot subscribe the command resource.");
+            return false;
+        }
+
+        /* The server answers the subscription, wait for it to finish or to let the device go */
+        uint32_t waitStart = millis();
+        bool answered = waitForCommands(WT_CFG_COMMAND_WAIT_MILLIS, true);
+
+        ESP_LOGI("Waltrac", "Waited %ums for the server to answer DISCOVER.", (unsigned)(millis() - waitStart));
+        return answered;
+    }
+
+    /* Commands that arrived on an observation of this context, e.g. the one of the sequenced batches */
+    if (coapObserving) {
+        applyCommands();
+        return true;
+    }
+
+    if (monotonicMicros() - commandsPolledMicros < (int64_t)WT_CFG_COMMAND_POLL_SECONDS * 1000000) {
+        return false;
+    }
+
+    /* The observation ends with the context, the server hands out queued commands once it is observed again */
+    commandsPolledMicros = monotonicMicros();
+    if (!coapSubscribeCommands()) {
+        ESP_LOGW("Waltrac", "Cannot subscribe the command resource.");
+        return false;
+    }
+
+    return waitForCommands(WT_CFG_COMMAND_POLL_MILLIS, false);
+}
+
+bool sendSequencedFixes(uint8_t interval, int64_t now)
+{
+    static Messages::PositionBatch batch;
+    static FixStore::Entry entries[Messages::PositionBatch::MAX_FIXES];
+    static uint8_t batchBuf[Messages::PositionBatch::MAX_SIZE];
+
+    /* The acknowledgements arrive on the command resource, which has to be observed in every new context */
+    if (!coapConnect()) {
         return false;
     }
-}
\ No newline at end of file
+
+    if (!coapObserving && !coapSubscribeCommands()) {
+        ESP_LOGW("Waltrac", "Cannot observe the command resource, fixes are sent without acknowledgement.");
+    }
+
+    bool sent = false;
+    for (uint8_t frame = 0; frame < WT_CFG_BACKLOG_FRAMES && uplinkWindow.size() > 0; frame++) {
+        size_t count = uplinkWindow.peek(entries, Messages::PositionBatch::MAX_FIXES);
+        uint16_t sequence = uplinkWindow.first();
+
+        batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            int64_t age = now - entries[i].timestamp;
+            entries[i].fix.age = age < 0 ? 0 : (age > UINT16_MAX ? UINT16_MAX : age);
+            batch.addFix(entries[i].fix);
+        }
+
+        batch.setHeader(true, WT_CFG_BATCH_COMPACT, true);
+        batch.interval = interval;
+        memcpy(batch.device, macBuf, 6);
+        batch.sequence = sequence;
+        batch.name = runtimeConfig.name();
+
+        size_t batchLen = batch.serialize(batchBuf, sizeof(batchBuf), signer);
+        if (batchLen == 0 || !coapSendPositionUpdate(batchBuf, batchLen, WALTER_MODEM_COAP_SEND_TYPE_NON)) {
+            return sent;
+        }
+
+        sent = true;
+
+        /* Without an acknowledgement the next frame starts at the same fix again */
+        if (!waitForAck(sequence, count)) {
+            ESP_LOGW("Waltrac", "Fixes %u to %u were not acknowledged, %u wait for the next frame.", sequence, (uint16_t)(sequence + count - 1), (unsigned)uplinkWindow.size());
+            break;
+        }
+    }
+
+    return sent;
+}
@@ -2,9 +2,27 @@
 
 #include <HardwareSerial.h>
 #include <WalterModem.h>
+#include <esp_attr.h>
 #include <esp_mac.h>
-
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string_view>
+
+#include "FixStore.h"
+#include "IntervalTimer.h"
 #include "Messages.h"
+#include "ModemInterface.h"
+#include "MotionPolicy.h"
+#include "PhaseStats.h"
+#include "RadioScheduler.h"
+#include "RuntimeConfig.h"
+#include "SeqlockBuffer.h"
+#include "TtffModel.h"
+#include "UplinkWindow.h"
 
 /**
  * @brief COAP profile used for connection.
@@ -22,14 +40,19 @@
 #define MAX_NETWORK_TIMEOUT_SECONDS 30
 
 /**
- * @brief Time frame for the command mode to be active at startup.
+ * @brief All fixes with a confidence below this number are considered ok.
  */
-#define CMD_TIMEOUT_SECONDS 60
+#define MAX_GNSS_CONFIDENCE 200.0
 
 /**
- * @brief All fixes with a confidence below this number are considered ok.
+ * @brief Seconds a valid GNSS clock is trusted before it is queried from the modem again.
  */
-#define MAX_GNSS_CONFIDENCE 200.0
+#define GNSS_CLOCK_RECHECK_SECONDS 3600
+
+/**
+ * @brief Assistance data that expires within this many seconds is checked with the modem again.
+ */
+#define GNSS_ASSISTANCE_MARGIN_SECONDS 120
 
 /**
  * @brief Number of attempts for getting a valid GNSS fix.
@@ -42,34 +65,368 @@
 #define MAX_GNSS_FIX_DURATION_SECONDS 60
 
 /**
- * @brief The modem instance.
+ * @brief Number of GNSS fixes collected into one PositionBatch before the radio is woken up for sending. 1 sends every fix as a single Position.
  */
-extern WalterModem modem;
+#ifndef WT_CFG_BATCH_SIZE
+#define WT_CFG_BATCH_SIZE 1
+#endif
 
 /**
- * @brief The last received GNSS fix.
+ * @brief Whether batches use the compact delta/varint encoding of the fixes.
  */
-extern WalterModemGNSSFix latestGnssFix;
+#ifndef WT_CFG_BATCH_COMPACT
+#define WT_CFG_BATCH_COMPACT 1
+#endif
+
+/**
+ * @brief Number of stored fixes sent per backlog batch once the uplink works again, at most
+ * Messages::PositionBatch::MAX_FIXES.
+ */
+#ifndef WT_CFG_BACKLOG_BATCH_SIZE
+#define WT_CFG_BACKLOG_BATCH_SIZE 16
+#endif
+
+/**
+ * @brief Number of backlog batches sent after each successful update, limits the time the radio stays busy draining.
+ */
+#ifndef WT_CFG_BACKLOG_FRAMES
+#define WT_CFG_BACKLOG_FRAMES 4
+#endif
+
+/**
+ * @brief Number of URI path segments set with one option command. The modem takes up to 6 comma separated values,
+ * 1 sets every segment with a command of its own.
+ */
+#ifndef WT_CFG_COAP_OPTION_VALUES
+#define WT_CFG_COAP_OPTION_VALUES 6
+#endif
+
+/**
+ * @brief Whether the reporting interval adapts to the motion of the asset. 0 takes a fix every WT_CFG_INTERVAL seconds
+ * and reports every fix.
+ */
+#ifndef WT_CFG_MOTION_ADAPTIVE
+#define WT_CFG_MOTION_ADAPTIVE 1
+#endif
+
+/**
+ * @brief Shortest interval in seconds the motion policy picks for a fast or turning asset. A new interval from the
+ * server scales it by the same factor, see applyMotionBounds().
+ */
+#ifndef WT_CFG_INTERVAL_MIN
+#define WT_CFG_INTERVAL_MIN WT_CFG_INTERVAL
+#endif
+
+/**
+ * @brief Longest interval in seconds the motion policy picks, used while the asset is stationary. Intervals are
+ * reported to the server in one byte, so longer intervals are announced as 255s.
+ */
+#ifndef WT_CFG_INTERVAL_MAX
+#define WT_CFG_INTERVAL_MAX 120
+#endif
+
+/**
+ * @brief Radius in meters around the last reported fix inside which the asset counts as stationary and fixes are
+ * not sent.
+ */
+#ifndef WT_CFG_STATIONARY_RADIUS
+#define WT_CFG_STATIONARY_RADIUS 25
+#endif
+
+/**
+ * @brief Distance in meters the motion policy aims for between two reported fixes of a moving asset.
+ */
+#ifndef WT_CFG_REPORT_DISTANCE
+#define WT_CFG_REPORT_DISTANCE 100
+#endif
+
+/**
+ * @brief Turn rate in degrees per second at which the interval of a moving asset is halved.
+ */
+#ifndef WT_CFG_TURN_RATE
+#define WT_CFG_TURN_RATE 10
+#endif
+
+/**
+ * @brief Seconds after which a stationary asset still reports a fix, so the server can tell it apart from a dead
+ * device. 0 suppresses all fixes while stationary.
+ */
+#ifndef WT_CFG_HEARTBEAT
+#define WT_CFG_HEARTBEAT 900
+#endif
+
+/**
+ * @brief What happens to an interval deadline that passed while the previous interval was still running. 0 runs it
+ * right away to catch up, 1 skips it and waits for the next deadline on the grid.
+ */
+#ifndef WT_CFG_OVERRUN_SKIP
+#define WT_CFG_OVERRUN_SKIP 0
+#endif
+
+/**
+ * @brief Whether an interval starts ahead of its boundary by the time the fix is expected to take, so the fix lands on
+ * the boundary instead of one time to fix after it.
+ */
+#ifndef WT_CFG_PREDICTIVE_START
+#define WT_CFG_PREDICTIVE_START 1
+#endif
+
+/**
+ * @brief Whether the tracker runs as a duty cycle. 1 puts the ESP32 into deep sleep and the modem into PSM between
+ * intervals and keeps the tracker state in RTC memory. 0 keeps everything awake and runs the GNSS and uplink tasks.
+ */
+#ifndef WT_CFG_DEEP_SLEEP
+#define WT_CFG_DEEP_SLEEP 0
+#endif
+
+/**
+ * @brief Seconds between two Telemetry frames with the phase statistics. The frame rides on the LTE window of a
+ * delivered update, so it goes out with the first update after the period. 0 sends no telemetry.
+ */
+#ifndef WT_CFG_TELEMETRY_INTERVAL
+#define WT_CFG_TELEMETRY_INTERVAL 21600
+#endif
+
+/**
+ * @brief Typical current in mA of the ESP32 and the modem together during each phase, in the order of
+ * Messages::TelemetryPhase: clock, assistance, attach, detach, GNSS, send. Turns the phase durations into the charge
+ * estimates of the Telemetry frame.
+ */
+#ifndef WT_CFG_PHASE_CURRENTS
+#define WT_CFG_PHASE_CURRENTS {45, 100, 130, 100, 70, 100}
+#endif
+
+/**
+ * @brief Whether fixes are sent as sequenced batches without CoAP confirmation. The receiver acknowledges them with an
+ * ACK command on the command resource, every frame repeats the fixes that are not acknowledged yet. Needs a receiver
+ * that answers sequenced batches, 0 sends every position confirmable.
+ */
+#ifndef WT_CFG_NON_UPLINKS
+#define WT_CFG_NON_UPLINKS 0
+#endif
+
+/**
+ * @brief Milliseconds the uplink waits for the ACK of a sequenced batch before it lets the radio go. Fixes that are
+ * not acknowledged by then go out again with the next frame.
+ */
+#ifndef WT_CFG_ACK_WAIT_MILLIS
+#define WT_CFG_ACK_WAIT_MILLIS 1500
+#endif
+
+/**
+ * @brief Milliseconds the first LTE window after a boot stays open for the server to answer DISCOVER, it closes early
+ * with EXIT. Later windows only apply the commands that arrive while they are open anyway.
+ */
+#ifndef WT_CFG_COMMAND_WAIT_MILLIS
+#define WT_CFG_COMMAND_WAIT_MILLIS 15000
+#endif
+
+/**
+ * @brief Seconds between two polls of the command resource. The LTE window of a poll observes the resource again,
+ * which makes the server hand out the commands it queued meanwhile. The setting commands take up to this long to
+ * reach the device.
+ */
+#ifndef WT_CFG_COMMAND_POLL_SECONDS
+#define WT_CFG_COMMAND_POLL_SECONDS 60
+#endif
+
+/**
+ * @brief Milliseconds the LTE window of a poll waits for the first queued command.
+ */
+#ifndef WT_CFG_COMMAND_POLL_MILLIS
+#define WT_CFG_COMMAND_POLL_MILLIS 1000
+#endif
+
+/**
+ * @brief Shortest remaining time in milliseconds worth a deep sleep, shorter waits are spent awake.
+ */
+#define MIN_DEEP_SLEEP_MILLIS 2000
+
+/**
+ * @brief Marks tracker state that has to survive the deep sleep between intervals. Places the variable in RTC memory
+ * when WT_CFG_DEEP_SLEEP is on. RTC variables are only initialized at power on, so they have to be constant
+ * initialized.
+ */
+#if WT_CFG_DEEP_SLEEP
+#define WT_RETAINED RTC_DATA_ATTR
+#else
+#define WT_RETAINED
+#endif
+
+/**
+ * @brief Marks state that also has to survive a software reset or a crash, like the telemetry counters. The variable
+ * is not initialized at all, its owner has to recognize garbage after a power on.
+ */
+#define WT_NOINIT RTC_NOINIT_ATTR
+
+/**
+ * @brief Event bit set by gnssEventHandler when a GNSS fix arrived.
+ */
+#define WT_EVENT_GNSS_FIX (1 << 0)
+
+/**
+ * @brief Event bit set while the modem is registered to the LTE network (home or roaming).
+ */
+#define WT_EVENT_LTE_REGISTERED (1 << 1)
+
+/**
+ * @brief Event bit set while the modem is not searching for a network, which is required for GNSS.
+ */
+#define WT_EVENT_LTE_DETACHED (1 << 2)
+
+/**
+ * @brief Event bit set by coapEventHandler when a CoAP response or notification arrived.
+ */
+#define WT_EVENT_COAP_RING (1 << 3)
+
+/**
+ * @brief Event bit set by coapEventHandler when the CoAP context was closed.
+ */
+#define WT_EVENT_COAP_CLOSED (1 << 4)
+
+/**
+ * @brief Number of GNSS updates the GNSS task can hand over before the uplink task picks them up.
+ */
+#define GNSS_UPDATE_QUEUE_LENGTH 4
+
+/**
+ * @brief Stack size of the GNSS and the uplink task in bytes.
+ */
+#define TASK_STACK_SIZE 8192
+
+/**
+ * @brief Priority of the GNSS task.
+ */
+#define GNSS_TASK_PRIORITY 1
+
+/**
+ * @brief Priority of the uplink task. Above the GNSS task, so a handed over update is sent before the next fix
+ * takes the radio.
+ */
+#define UPLINK_TASK_PRIORITY 2
+
+static_assert(WT_CFG_BATCH_SIZE >= 1 && WT_CFG_BATCH_SIZE <= Messages::PositionBatch::MAX_FIXES, "WT_CFG_BATCH_SIZE must be between 1 and PositionBatch::MAX_FIXES");
+static_assert(WT_CFG_INTERVAL_MIN >= 1 && WT_CFG_INTERVAL_MIN <= WT_CFG_INTERVAL_MAX, "WT_CFG_INTERVAL_MIN must be between 1 and WT_CFG_INTERVAL_MAX");
+
+/**
+ * @brief A position update handed from the GNSS task to the uplink task.
+ */
+struct GnssUpdate {
+    bool valid = false;                 // false while searching for satellites, the update carries no coordinates
+    uint32_t takenMillis = 0;           // millis() when the fix arrived
+    int64_t timestamp = 0;              // GNSS time of the fix in seconds since the epoch
+    uint8_t interval = 0;               // seconds until the next fix as announced to the server
+    Messages::PositionBatch::Fix fix;   // age is filled in by the uplink when the update is sent
+};
+
+/**
+ * @brief Tracker state kept from one interval to the next, in RTC memory in duty-cycle mode. latestFixValid is owned
+ * by the GNSS side, the batch by the uplink side.
+ */
+struct TrackerState {
+    bool latestFixValid = false;                                    // false until the initial fix succeeded
+    uint32_t cycles = 0;                                            // intervals since power on
+    uint8_t batchCount = 0;
+    GnssUpdate batch[Messages::PositionBatch::MAX_FIXES];          // fixes collected for the next batch
+};
+
+/**
+ * @brief When the GNSS clock was last seen valid and when the assistance data expires, in monotonicMicros(). Saves
+ * the AT round trips of validateGNSSClock and checkAssistanceStatus while nothing is about to expire.
+ */
+struct GnssValidity {
+    bool clockValid = false;
+    int64_t clockCheckedMicros = 0;         // when the clock was last seen valid
+    bool assistanceKnown = false;           // false until the first assistance status was read
+    int64_t almanacExpiresMicros = 0;       // when the almanac should be updated
+    int64_t ephemerisExpiresMicros = 0;     // when the realtime ephemeris should be updated
+};
 
 /**
- * @brief Flag used to signal when a fix is received.
+ * @brief The modem, WalterModemAdapter on the device.
  */
-extern volatile bool gnssFixRcvd;
+extern ModemInterface& modem;
+
+/**
+ * @brief Event group the modem event handlers report to, see the WT_EVENT_* bits.
+ */
+extern EventGroupHandle_t waltracEvents;
+
+/**
+ * @brief Queue of GnssUpdate from the GNSS task to the uplink task.
+ */
+extern QueueHandle_t gnssUpdates;
+
+/**
+ * @brief Mutex held while a task uses the modem radio. GNSS and LTE cannot run at the same time.
+ */
+extern SemaphoreHandle_t radioMutex;
+
+/**
+ * @brief The HMAC signer holding the precomputed key schedule of WT_CFG_SECRET.
+ */
+extern Messages::Signer signer;
+
+/**
+ * @brief Handoff of GNSS fixes from gnssEventHandler to the task waiting for them.
+ */
+extern SeqlockBuffer<WalterModemGNSSFix> gnssFixBuffer;
+
+/**
+ * @brief State carried over between intervals.
+ */
+extern TrackerState trackerState;
+
+/**
+ * @brief Cached validity of the GNSS clock and assistance data.
+ */
+extern GnssValidity gnssValidity;
+
+/**
+ * @brief Time to fix per acquisition mode, only touched by the GNSS side.
+ */
+extern TtffModel ttffModel;
+
+/**
+ * @brief Absolute deadlines of the intervals, only touched by the GNSS side.
+ */
+extern IntervalTimer intervalTimer;
+
+/**
+ * @brief Motion-adaptive reporting policy, only touched by the GNSS task except for its bounds, see
+ * applyMotionBounds().
+ */
+extern MotionPolicy motionPolicy;
+
+/**
+ * @brief Latency and charge per phase with retry and restart counters, only touched while holding radioMutex.
+ */
+extern PhaseStats phaseStats;
+
+/**
+ * @brief The last received GNSS fix, only touched by the task that consumed it from gnssFixBuffer.
+ */
+extern WalterModemGNSSFix latestGnssFix;
 
 /**
  * @brief Number of (good) satellites found for the last fix.
  */
-extern volatile uint8_t gnssFixNumSatellites;
+extern uint8_t gnssFixNumSatellites;
 
 /**
- * @brief The duration counter for maintaining GNSS timeouts.
+ * @brief Seconds the running or last GNSS attempt took since it was requested, for the GNSS timeouts.
  */
 extern volatile uint32_t gnssFixDurationSeconds;
 
 /**
- * @brief Flag used to signal when the command mode was left.
+ * @brief When the running or last GNSS attempt was requested, in monotonicMicros().
  */
-extern volatile bool cmdModeActive;
+extern int64_t gnssRequestMicros;
+
+/**
+ * @brief When the last GNSS fix arrived, in monotonicMicros().
+ */
+extern int64_t gnssFixMicros;
 
 /**
  * @brief The buffer for the MAC adress to be stored.
@@ -82,19 +439,69 @@ extern uint8_t macBuf[6];
 extern char macHex[13];
 
 /**
- * @brief Buffer for incoming COAP response
+ * @brief Session ID assigned by the server in answer to DISCOVER, 0 while no session is assigned.
+ */
+extern uint16_t sessionId;
+
+/**
+ * @brief The session ID as HEX string. Replaces the MAC address in the position resource once a session is assigned.
+ */
+extern char sessionHex[5];
+
+/**
+ * @brief Whether a session frame carrying the name was delivered in the current session. Cleared by a new session
+ * or name, so the next session frame carries the name again.
+ */
+extern bool sessionNamed;
+
+/**
+ * @brief Buffer for incoming COAP response. Command views returned by getCommand() refer to this buffer.
  */
 extern uint8_t incomingBuf[274];
 
 /**
- * @brief The counter for maintaining dynamic interval.
+ * @brief This function creates the event group, the update queue and the radio mutex. Must be called before the
+ * modem event handlers are installed.
+ *
+ * @return true if all objects could be created, else false.
+ */
+bool initRuntime();
+
+/**
+ * @brief Monotonic time in microseconds that keeps counting across deep sleep, see advanceMonotonicClock().
+ *
+ * @return Microseconds since power on.
+ */
+int64_t monotonicMicros();
+
+/**
+ * @brief Carry the monotonic clock over a deep sleep. Called right before the ESP32 goes to sleep, since the ESP32
+ * timer starts over at every wake-up.
+ *
+ * @param sleepMillis Duration of the coming sleep in milliseconds.
  */
-extern uint8_t cntMntInv;
+void advanceMonotonicClock(uint32_t sleepMillis);
 
 /**
- * @brief The counter for maintaining command update interval.
+ * @brief Forget the cached clock and assistance validity, so the next fix asks the modem again.
  */
-extern uint8_t cntMntCmd;
+void invalidateGnssValidity();
+
+/**
+ * @brief Move the bounds of the motion policy along with the interval. The lower bound keeps its compiled ratio to
+ * WT_CFG_INTERVAL, the upper bound stays at WT_CFG_INTERVAL_MAX unless the lower bound passes it.
+ *
+ * @param interval The interval in seconds as set by the server or compiled in.
+ */
+void applyMotionBounds(uint32_t interval);
+
+/**
+ * @brief Network registration event handler. Keeps WT_EVENT_LTE_REGISTERED and WT_EVENT_LTE_DETACHED up to date.
+ *
+ * @param state The new registration state.
+ * @param args User argument pointer passed to setRegistrationEventHandler.
+ */
+void registrationEventHandler(WalterModemNetworkRegState state, void* args);
 
 /**
  * @brief This function waits for the modem to be connected to the Lte network.
@@ -174,13 +581,22 @@ bool updateGNSSAssistance(WalterModemRsp* rsp);
  */
 bool validateGNSSClock(WalterModemRsp* rsp);
 
+/**
+ * @brief Sync the GNSS clock and fetch due assistance data. Meant for the end of an LTE window, so the following GNSS
+ * window finds both valid and does not have to attach again.
+ *
+ * @return true if clock and assistance data are valid, else false.
+ */
+bool prepareGnss();
+
 /**
  * @brief GNSS event handler
  *
  * Handles GNSS fix events.
  * @note This callback is invoked from the modem driver’s event context.
  *       It must never block or call modem methods directly.
- *       Use it only to set flags or copy data for later processing.
+ *       Use it only to set flags or copy data for later processing,
+ *       the fix is published to gnssFixBuffer and evaluated by the waiting task.
  *
  * @param fix The fix data.
  * @param args User argument pointer passed to gnssSetEventHandler
@@ -224,10 +640,79 @@ bool coapConnect();
  *
  * @param data Pointer to the data sent in this request.
  * @param dataLen Size of the dataset sent in this request.
+ * @param type Confirmable, or non-confirmable for sequenced batches that are acknowledged by the receiver.
  *
  * @return true if the request was successful, else false.
  */
-bool coapSendPositionUpdate(uint8_t* data, size_t dataLen);
+bool coapSendPositionUpdate(uint8_t* data, size_t dataLen, WalterModemCoapSendType type = WALTER_MODEM_COAP_SEND_TYPE_CON);
+
+/**
+ * @brief This function sends a single position update. With a session assigned the compact SessionPosition frame is
+ * sent, which carries the session ID instead of the MAC address and the name only when it changed since the last
+ * frame of the session. Without a session the full Position frame is sent.
+ *
+ * @param update The update to send. Invalid updates carry no coordinates.
+ *
+ * @return true if the update was sent successfully, else false.
+ */
+bool sendPositionUpdate(const GnssUpdate& update);
+
+/**
+ * @brief This function sends fixes from the store-and-forward backlog as position batches, oldest first. Delivered
+ * fixes are removed from the store, the rest waits for the next call.
+ *
+ * @param now The current GNSS time in seconds since the epoch, the age of every fix is derived from it.
+ *
+ * @return true if no batch failed, else false.
+ */
+bool sendBacklog(int64_t now);
+
+/**
+ * @brief This function sends the fixes of the uplink window as non-confirmable sequenced batches and waits up to
+ * WT_CFG_ACK_WAIT_MILLIS for each to be acknowledged. A batch always starts at the oldest unacknowledged fix, the next
+ * batch only goes out once the previous one was acknowledged.
+ *
+ * @param interval Seconds until the next fix as announced to the server.
+ * @param now The current GNSS time in seconds since the epoch, the age of every fix is derived from it.
+ *
+ * @return true if at least one batch was handed to the modem, else false.
+ */
+bool sendSequencedFixes(uint8_t interval, int64_t now);
+
+/**
+ * @brief This function sends a telemetry frame to the CoAP gateway server. Response is not awaited, the function does simple fire & forget.
+ *
+ * @param data Pointer to the data sent in this request.
+ * @param dataLen Size of the dataset sent in this request.
+ *
+ * @return true if the request was successful, else false.
+ */
+bool coapSendTelemetry(uint8_t* data, size_t dataLen);
+
+/**
+ * @brief This function sends the phase statistics of the current window as a Telemetry frame and starts a new
+ * window once it was sent.
+ *
+ * @return true if the frame was sent successfully, else false.
+ */
+bool sendTelemetry();
+
+/**
+ * @brief This function keeps the command channel in the open LTE window. The first call after a boot announces the
+ * device with DISCOVER and waits up to WT_CFG_COMMAND_WAIT_MILLIS for the answer of the server. Later calls poll the
+ * command resource every WT_CFG_COMMAND_POLL_SECONDS and otherwise apply the commands that arrived in this context.
+ *
+ * @return true if the command resource is observed, else false.
+ */
+bool serviceCommands();
+
+/**
+ * @brief Whether the device still has to announce itself with DISCOVER. Until then every update opens an LTE window,
+ * batching and the stationary suppression only start after that.
+ *
+ * @return true until DISCOVER was sent after a boot, else false.
+ */
+bool discoveryPending();
 
 /**
  * @brief This function sends a command to the control backend. Response is not awaited, the function does simple fire & forget.
@@ -247,10 +732,29 @@ bool coapSendCommand(uint8_t *data, size_t dataLen);
 bool coapSubscribeCommands();
 
 /**
- * @brief This functions checks the CoAP input buffer and tries to fill a command object.
+ * @brief This functions checks the CoAP input buffer and tries to parse and verify a command in place.
+ *
+ * @param command Reference to the command view to be filled. The view refers to incomingBuf and is valid until the next call.
+ *
+ * @return true if a well-formed command with a valid HMAC could be obtained, else false.
+ */
+bool getCommand(Messages::CommandView &command);
+
+/**
+ * @brief This function applies the session ID received with a SETSESSION command. The next session frame carries
+ * the name again.
+ *
+ * @param arg The command argument, the session ID in decimal.
+ *
+ * @return true if the argument is a valid session ID between 1 and 65535, else false.
+ */
+bool setSession(std::string_view arg);
+
+/**
+ * @brief This function applies an ACK command to the uplink window.
  *
- * @param command Reference to the command object to be filled.
+ * @param arg The command argument, the sequence number following the last fix the receiver got in decimal.
  *
- * @return true if a valid command could be obtained, else false.
+ * @return true if the argument is a sequence number, else false. An ACK outside of the window is ignored.
  */
-bool getCommand(Messages::Command &command);
\ No newline at end of file
+bool acknowledgeFixes(std::string_view arg);
\ No newline at end of file
@@ -4,5 +4,7 @@
 #define WT_SERVER_PORT 1999
 
 #define WT_CFG_INTERVAL 10
+#define WT_CFG_BATCH_SIZE 1
+#define WT_CFG_BATCH_COMPACT 1
 #define WT_CFG_NAME "InitialName"
 #define WT_CFG_SECRET "[YourSecret]"
\ No newline at end of file
@@ -0,0 +1,238 @@
+// messages_bench.cpp - host benchmarks of the Messages codec
+//
+// Reports ns/frame for the Position and Command paths over name lengths
+// 0-255, then the bulk HMAC verification of a mixed batch of position frames
+// on every batch backend the CPU supports. Built by the root CMakeLists.txt:
+//
+//   cmake -S . -B build && cmake --build build --target messages_bench
+//   ./build/messages_bench [--all] [--min-ms N]
+//
+// --all sweeps every name length instead of the default selection,
+// --min-ms sets the minimum run time per measurement (default 100 ms).
+// Exits with 1 if a frame does not decode or verify on any path, so a short
+// run doubles as a check (ctest runs it with --min-ms 1).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BatchVerifier.h"
+#include "Messages.h"
+
+using namespace Messages;
+
+static const char* KEY = "benchmark-secret";
+
+// Keep results observable so the compiler cannot drop the measured work.
+static volatile size_t sink;
+
+static bool failed = false;
+
+static void expect(bool ok, const char* what, size_t namelen) {
+    if (!ok) {
+        fprintf(stderr, "%s failed for namelen %zu\n", what, namelen);
+        failed = true;
+    }
+}
+
+// Run op repeatedly for at least minMs and return the mean ns per call,
+// best of three runs.
+template<typename Op>
+static double measure(Op op, unsigned minMs) {
+    using Clock = std::chrono::steady_clock;
+
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) {
+        size_t iterations = 0;
+        size_t batch = 64;
+
+        const Clock::time_point start = Clock::now();
+        Clock::time_point now = start;
+        while (now - start < std::chrono::milliseconds(minMs)) {
+            for (size_t i = 0; i < batch; ++i) {
+                sink = sink + op();
+            }
+
+            iterations += batch;
+            batch *= 2;
+            now = Clock::now();
+        }
+
+        const double ns = std::chrono::duration<double, std::nano>(now - start).count() / iterations;
+        if (run == 0 || ns < best) {
+            best = ns;
+        }
+    }
+
+    return best;
+}
+
+static Position makePosition(size_t namelen) {
+    Position p;
+    p.setHeader(true);
+    p.interval = 30;
+    p.confidence = 12;
+    p.satellites = 9;
+    for (size_t i = 0; i < 6; ++i) {
+        p.device[i] = static_cast<uint8_t>(0xA0 + i);
+    }
+    p.latitude = 48.7758459;
+    p.longitude = 9.1829321;
+    p.name.assign(namelen, 'n');
+
+    return p;
+}
+
+int main(int argc, char** argv) {
+    bool all = false;
+    unsigned minMs = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = true;
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            minMs = static_cast<unsigned>(atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "usage: %s [--all] [--min-ms N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<size_t> lengths;
+    if (all) {
+        for (size_t n = 0; n <= 255; ++n) {
+            lengths.push_back(n);
+        }
+    } else {
+        // both sides of each SHA-256 block boundary of the signed Position fields
+        lengths = {0, 16, 36, 37, 64, 100, 101, 128, 164, 165, 192, 228, 229, 255};
+    }
+
+    Signer signer(KEY);
+
+    printf("%-7s %-7s %14s %14s %14s %14s %14s %14s %14s\n",
+           "namelen", "frame", "pos.serialize", "pos.keyed", "pos.decode", "pos.verify", "view.decode", "cmd.serialize", "cmd.roundtrip");
+
+    for (size_t namelen : lengths) {
+        Position position = makePosition(namelen);
+
+        uint8_t frame[Position::MAX_SIZE];
+        const size_t frameLen = position.serialize(frame, sizeof(frame), signer);
+
+        Command command;
+        command.setHeader(COMMAND_ACTION_SETNAME);
+        command.arg.assign(namelen, 'a');
+
+        uint8_t commandBuf[Command::MAX_SIZE];
+
+        // the measured paths have to agree before their speed means anything
+        PositionView checkView;
+        CommandView checkCommand;
+        const size_t commandLen = command.serialize(commandBuf, sizeof(commandBuf), signer);
+        Position decoded;
+        expect(Position::decode(frame, frameLen, decoded) == DECODE_STATUS_OK && decoded.verify(signer), "Position verify", namelen);
+        expect(checkView.decode(frame, frameLen, signer) == DECODE_STATUS_OK, "PositionView decode", namelen);
+        expect(checkCommand.decode(commandBuf, commandLen, signer) == DECODE_STATUS_OK && checkCommand.arg() == command.arg, "Command round trip", namelen);
+
+        // fields, signing with the cached key schedule
+        const double serializeNs = measure([&] {
+            uint8_t out[Position::MAX_SIZE];
+            return position.serialize(out, sizeof(out), signer);
+        }, minMs);
+
+        // same through the key string, which hits the cached key schedule
+        const double keyedNs = measure([&] {
+            uint8_t out[Position::MAX_SIZE];
+            return position.serialize(out, sizeof(out), KEY);
+        }, minMs);
+
+        // owning parse, copies the name
+        const double decodeNs = measure([&] {
+            Position parsed;
+            return static_cast<size_t>(Position::decode(frame, frameLen, parsed)) + parsed.name.size();
+        }, minMs);
+
+        // re-serialize the decoded fields and compare the HMAC
+        const double verifyNs = measure([&] {
+            return static_cast<size_t>(decoded.verify(signer));
+        }, minMs);
+
+        // zero-copy validation plus HMAC over the frame bytes
+        const double viewNs = measure([&] {
+            PositionView view;
+            return static_cast<size_t>(view.decode(frame, frameLen, signer));
+        }, minMs);
+
+        const double commandSerializeNs = measure([&] {
+            return command.serialize(commandBuf, sizeof(commandBuf), signer);
+        }, minMs);
+
+        // serialize, decode in place and verify, as on the downlink
+        const double commandRoundtripNs = measure([&] {
+            const size_t len = command.serialize(commandBuf, sizeof(commandBuf), signer);
+            CommandView view;
+            return static_cast<size_t>(view.decode(commandBuf, len, signer)) + view.arg().size();
+        }, minMs);
+
+        printf("%-7zu %-7zu %14.1f %14.1f %14.1f %14.1f %14.1f %14.1f %14.1f\n",
+               namelen, frameLen, serializeNs, keyedNs, decodeNs, verifyNs, viewNs, commandSerializeNs, commandRoundtripNs);
+    }
+
+    // bulk verification, name lengths cycle through the selection above
+    const size_t BATCH = 1024;
+
+    std::vector<std::vector<uint8_t>> frames(BATCH);
+    std::vector<PositionView> views(BATCH);
+    for (size_t i = 0; i < BATCH; ++i) {
+        frames[i].resize(Position::MAX_SIZE);
+        frames[i].resize(makePosition(lengths[i % lengths.size()]).serialize(frames[i].data(), frames[i].size(), signer));
+        views[i].init(frames[i].data(), frames[i].size());
+    }
+
+    printf("\n%-10s %14s\n", "backend", "ns/frame");
+
+    const double scalarNs = measure([&] {
+        size_t verified = 0;
+        for (const PositionView& view : views) {
+            verified += view.verify(signer);
+        }
+        return verified;
+    }, minMs);
+    printf("%-10s %14.1f\n", "scalar", scalarNs / BATCH);
+
+    size_t scalarVerified = 0;
+    for (const PositionView& view : views) {
+        scalarVerified += view.verify(signer);
+    }
+    if (scalarVerified != BATCH) {
+        fprintf(stderr, "scalar verify failed for %zu of %zu frames\n", BATCH - scalarVerified, BATCH);
+        failed = true;
+    }
+
+    bool ok[BATCH];
+    for (BatchBackend backend : {BATCH_BACKEND_GENERIC, BATCH_BACKEND_AVX2, BATCH_BACKEND_AVX512, BATCH_BACKEND_SHANI}) {
+        if (!BatchVerifier::supported(backend)) {
+            continue;
+        }
+
+        const BatchVerifier verifier(KEY, backend);
+        const double batchNs = measure([&] {
+            return verifier.verify(views.data(), views.size(), ok);
+        }, minMs);
+        printf("%-10s %14.1f\n", BatchVerifier::backendName(backend), batchNs / BATCH);
+
+        const size_t verified = verifier.verify(views.data(), views.size(), ok);
+        if (verified != BATCH || !std::all_of(ok, ok + BATCH, [](bool v) { return v; })) {
+            fprintf(stderr, "%s verify failed for %zu of %zu frames\n", BatchVerifier::backendName(backend), BATCH - verified, BATCH);
+            failed = true;
+        }
+    }
+
+    printf("%-10s %14s\n", "auto", BatchVerifier::backendName(BatchVerifier(KEY).backend()));
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// BatchKernels.h - HMAC-SHA256 verification kernels behind BatchVerifier.
+// Each kernel lives in its own translation unit compiled for its instruction
+// set, BatchVerifier picks one at runtime.
+
+namespace Messages {
+namespace BatchKernels {
+
+// Truncated HMAC at the end of every frame, Payload::HMAC_SIZE
+static constexpr size_t HMAC_SIZE = 16;
+
+// Largest signed part a kernel accepts, Payload::MAX_FIELDS_SIZE
+static constexpr size_t MAX_MESSAGE_SIZE = 505;
+
+// A frame whose trailing HMAC_SIZE bytes are checked against the truncated
+// HMAC of the bytes in front of them. len is at least HMAC_SIZE and the
+// signed part at most MAX_MESSAGE_SIZE bytes.
+struct Frame {
+    const uint8_t* data;
+    size_t len;
+};
+
+// inner and outer are the SHA-256 states after the key ^ ipad and key ^ opad
+// blocks. ok[i] receives the result for frames[i]. Returns the number of
+// frames that verified.
+typedef size_t (*Kernel)(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok);
+
+size_t verifyGeneric(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok);
+
+#if defined(WALTRAC_BATCH_X86)
+size_t verifyAvx2(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok);
+size_t verifyAvx512(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok);
+size_t verifyShaNi(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok);
+#endif
+
+} // namespace BatchKernels
+} // namespace Messages
@@ -0,0 +1,15 @@
+// AVX2 kernel: 8 SHA-256 lanes with AVX2, built with -mavx2.
+
+#include "Sha256Lanes.h"
+
+namespace Messages {
+namespace BatchKernels {
+
+typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+
+size_t verifyAvx2(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok) {
+    return verify_lanes<Lanes8, 8>(inner, outer, frames, count, ok);
+}
+
+} // namespace BatchKernels
+} // namespace Messages
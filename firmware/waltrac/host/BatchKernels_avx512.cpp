@@ -0,0 +1,15 @@
+// AVX-512 kernel: 16 SHA-256 lanes with AVX-512F, built with -mavx512f.
+
+#include "Sha256Lanes.h"
+
+namespace Messages {
+namespace BatchKernels {
+
+typedef uint32_t Lanes16 __attribute__((vector_size(64)));
+
+size_t verifyAvx512(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok) {
+    return verify_lanes<Lanes16, 16>(inner, outer, frames, count, ok);
+}
+
+} // namespace BatchKernels
+} // namespace Messages
@@ -0,0 +1,16 @@
+// Generic kernel: 4 SHA-256 lanes with the baseline instruction set (SSE2 on x86-64),
+// available on every host.
+
+#include "Sha256Lanes.h"
+
+namespace Messages {
+namespace BatchKernels {
+
+typedef uint32_t Lanes4 __attribute__((vector_size(16)));
+
+size_t verifyGeneric(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok) {
+    return verify_lanes<Lanes4, 4>(inner, outer, frames, count, ok);
+}
+
+} // namespace BatchKernels
+} // namespace Messages
@@ -0,0 +1,106 @@
+// SHA-NI kernel: one frame at a time on the x86 SHA extensions, built with
+// -msha -msse4.1. The SHA instructions work on a single message, so this
+// kernel does not use lanes but is still faster per frame than wide SIMD.
+
+#include <immintrin.h>
+
+#include "Sha256Lanes.h"
+
+namespace Messages {
+namespace BatchKernels {
+namespace {
+
+// state holds a..h in the ABEF/CDGH register layout of the SHA instructions.
+inline void compress_shani(__m128i& abef, __m128i& cdgh, const uint8_t* block) {
+    const __m128i BYTE_SWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    const __m128i abefSave = abef;
+    const __m128i cdghSave = cdgh;
+
+    __m128i msg[4];
+    for (size_t i = 0; i < 16; ++i) {
+        __m128i& x = msg[i % 4];
+        if (i < 4) {
+            x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i)), BYTE_SWAP);
+        } else {
+            // W[t] = W[t-16] + s0(W[t-15]) + W[t-7] + s1(W[t-2]) for four words at once
+            const __m128i w7 = _mm_alignr_epi8(msg[(i - 1) % 4], msg[(i - 2) % 4], 4);
+            x = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(x, msg[(i - 3) % 4]), w7), msg[(i - 1) % 4]);
+        }
+
+        __m128i wk = _mm_add_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_K + 4 * i)));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+        wk = _mm_shuffle_epi32(wk, 0x0E);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, wk);
+    }
+
+    abef = _mm_add_epi32(abef, abefSave);
+    cdgh = _mm_add_epi32(cdgh, cdghSave);
+}
+
+inline void load_state(const uint32_t state[8], __m128i& abef, __m128i& cdgh) {
+    const __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    const __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    abef = _mm_alignr_epi8(dcba, efgh, 8);
+    cdgh = _mm_blend_epi16(efgh, dcba, 0xF0);
+}
+
+inline void store_state(__m128i abef, __m128i cdgh, uint32_t state[8]) {
+    const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+} // namespace
+
+size_t verifyShaNi(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok) {
+    constexpr size_t MAX_BLOCKS = (MAX_MESSAGE_SIZE + 9 + 63) / 64;
+
+    alignas(16) uint8_t padded[MAX_BLOCKS * 64];
+    alignas(16) uint8_t outerBlock[64] = {0};
+
+    // outer block: 32 byte inner digest, 0x80, zeros and the length of key block plus digest
+    outerBlock[32] = 0x80;
+    store_be64(outerBlock + 56, (64 + 32) * 8);
+
+    size_t verified = 0;
+    for (size_t f = 0; f < count; ++f) {
+        const size_t blocks = pad_inner(padded, frames[f]);
+
+        __m128i abef;
+        __m128i cdgh;
+        load_state(inner, abef, cdgh);
+        for (size_t block = 0; block < blocks; ++block) {
+            compress_shani(abef, cdgh, padded + 64 * block);
+        }
+
+        uint32_t digest[8];
+        store_state(abef, cdgh, digest);
+        for (size_t i = 0; i < 8; ++i) {
+            outerBlock[4 * i] = static_cast<uint8_t>(digest[i] >> 24);
+            outerBlock[4 * i + 1] = static_cast<uint8_t>(digest[i] >> 16);
+            outerBlock[4 * i + 2] = static_cast<uint8_t>(digest[i] >> 8);
+            outerBlock[4 * i + 3] = static_cast<uint8_t>(digest[i]);
+        }
+
+        load_state(outer, abef, cdgh);
+        compress_shani(abef, cdgh, outerBlock);
+        store_state(abef, cdgh, digest);
+
+        const uint8_t* mac = frames[f].data + frames[f].len - HMAC_SIZE;
+
+        bool match = true;
+        for (size_t i = 0; i < HMAC_SIZE / 4; ++i) {
+            match &= digest[i] == load_be32(mac + 4 * i);
+        }
+
+        ok[f] = match;
+        verified += match;
+    }
+
+    return verified;
+}
+
+} // namespace BatchKernels
+} // namespace Messages
@@ -0,0 +1,147 @@
+#include "BatchVerifier.h"
+
+#include <cstring>
+
+#include "BatchKernels.h"
+#include "Sha256Lanes.h"
+
+namespace Messages {
+
+static_assert(BatchKernels::HMAC_SIZE == Payload::HMAC_SIZE, "kernel HMAC size does not match Payload");
+static_assert(BatchKernels::MAX_MESSAGE_SIZE == Payload::MAX_FIELDS_SIZE, "kernel message limit does not match Payload");
+
+static BatchKernels::Kernel kernel_for(BatchBackend backend) {
+    switch (backend) {
+#if defined(WALTRAC_BATCH_X86)
+        case BATCH_BACKEND_AVX2:    return BatchKernels::verifyAvx2;
+        case BATCH_BACKEND_AVX512:  return BatchKernels::verifyAvx512;
+        case BATCH_BACKEND_SHANI:   return BatchKernels::verifyShaNi;
+#endif
+        default:                    return BatchKernels::verifyGeneric;
+    }
+}
+
+// Midstate of one HMAC pad block, key is at most one block long.
+static void pad_midstate(const uint8_t* key, size_t keylen, uint8_t pad, uint32_t state[8]) {
+    uint8_t block[Sha256::BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(block); ++i) {
+        block[i] = static_cast<uint8_t>((i < keylen ? key[i] : 0) ^ pad);
+    }
+
+    uint32_t w[16];
+    for (size_t i = 0; i < 16; ++i) {
+        w[i] = BatchKernels::load_be32(block + 4 * i);
+    }
+
+    memcpy(state, BatchKernels::SHA256_H0, sizeof(BatchKernels::SHA256_H0));
+    BatchKernels::compress(state, w);
+
+    memset(block, 0, sizeof(block));
+}
+
+BatchVerifier::BatchVerifier(const char* key, BatchBackend backend) noexcept
+    : BatchVerifier(reinterpret_cast<const uint8_t*>(key), key != nullptr ? strlen(key) : 0, backend) {
+}
+
+BatchVerifier::BatchVerifier(const uint8_t* key, size_t keylen, BatchBackend backend) noexcept {
+    setKey(key, keylen);
+
+    // 16 lanes outrun the single stream SHA instructions where both exist,
+    // see the batch section of messages_bench
+    if (backend != BATCH_BACKEND_AUTO && supported(backend)) {
+        backend_ = backend;
+    } else if (supported(BATCH_BACKEND_AVX512)) {
+        backend_ = BATCH_BACKEND_AVX512;
+    } else if (supported(BATCH_BACKEND_SHANI)) {
+        backend_ = BATCH_BACKEND_SHANI;
+    } else if (supported(BATCH_BACKEND_AVX2)) {
+        backend_ = BATCH_BACKEND_AVX2;
+    } else {
+        backend_ = BATCH_BACKEND_GENERIC;
+    }
+}
+
+void BatchVerifier::setKey(const uint8_t* key, size_t keylen) noexcept {
+    // keys longer than the block size are replaced by their digest (RFC 2104)
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    if (keylen > Sha256::BLOCK_SIZE) {
+        Sha256 sha;
+        if (sha.setup() && sha.starts() && sha.update(key, keylen) && sha.finish(digest)) {
+            key = digest;
+            keylen = sizeof(digest);
+        }
+    }
+
+    pad_midstate(key, keylen, 0x36, inner_);
+    pad_midstate(key, keylen, 0x5C, outer_);
+
+    memset(digest, 0, sizeof(digest));
+}
+
+bool BatchVerifier::supported(BatchBackend backend) noexcept {
+    switch (backend) {
+        case BATCH_BACKEND_AUTO:
+        case BATCH_BACKEND_GENERIC:
+            return true;
+#if defined(WALTRAC_BATCH_X86)
+        case BATCH_BACKEND_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case BATCH_BACKEND_AVX512:
+            return __builtin_cpu_supports("avx512f");
+        case BATCH_BACKEND_SHANI:
+            return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* BatchVerifier::backendName(BatchBackend backend) noexcept {
+    switch (backend) {
+        case BATCH_BACKEND_AUTO:    return "auto";
+        case BATCH_BACKEND_GENERIC: return "generic";
+        case BATCH_BACKEND_AVX2:    return "avx2";
+        case BATCH_BACKEND_AVX512:  return "avx512";
+        case BATCH_BACKEND_SHANI:   return "sha-ni";
+    }
+
+    return "unknown";
+}
+
+size_t BatchVerifier::verify(const PositionView* views, size_t count, bool* ok) const noexcept {
+    const BatchKernels::Kernel kernel = kernel_for(backend_);
+
+    BatchKernels::Frame frames[CHUNK_SIZE];
+    size_t index[CHUNK_SIZE];
+    bool results[CHUNK_SIZE];
+
+    size_t verified = 0;
+    for (size_t base = 0; base < count; base += CHUNK_SIZE) {
+        const size_t end = count - base < CHUNK_SIZE ? count : base + CHUNK_SIZE;
+
+        // invalid views never reach a kernel
+        size_t n = 0;
+        for (size_t i = base; i < end; ++i) {
+            ok[i] = false;
+            if (views[i].valid() && views[i].size() <= BatchKernels::MAX_MESSAGE_SIZE + Payload::HMAC_SIZE) {
+                frames[n] = {views[i].data(), views[i].size()};
+                index[n] = i;
+                ++n;
+            }
+        }
+
+        verified += kernel(inner_, outer_, frames, n, results);
+
+        for (size_t i = 0; i < n; ++i) {
+            ok[index[i]] = results[i];
+        }
+    }
+
+    return verified;
+}
+
+size_t verifyBatch(const PositionView* views, size_t count, const char* key, bool* ok) noexcept {
+    return BatchVerifier(key).verify(views, count, ok);
+}
+
+} // namespace Messages
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Messages.h"
+
+// BatchVerifier.h - bulk HMAC verification of position frames for the ingest side.
+// Host builds only, see the root CMakeLists.txt.
+
+namespace Messages {
+
+typedef enum
+{
+    BATCH_BACKEND_AUTO,         // fastest backend the CPU supports
+    BATCH_BACKEND_GENERIC,      // 4 lanes on the baseline instruction set, always available
+    BATCH_BACKEND_AVX2,         // 8 lanes
+    BATCH_BACKEND_AVX512,       // 16 lanes
+    BATCH_BACKEND_SHANI         // one frame at a time on the SHA extensions
+} BatchBackend;
+
+// Verifies the trailing HMAC of many frames at once. The key schedule is
+// kept as raw SHA-256 midstates and the frames are hashed in parallel SIMD
+// lanes, or on the SHA extensions where the CPU has them. The backend is
+// chosen once at construction from the CPU features.
+class BatchVerifier {
+public:
+    // Frames handled per kernel call, verify() splits larger batches.
+    static constexpr size_t CHUNK_SIZE = 64;
+
+    explicit BatchVerifier(const char* key, BatchBackend backend = BATCH_BACKEND_AUTO) noexcept;
+    BatchVerifier(const uint8_t* key, size_t keylen, BatchBackend backend = BATCH_BACKEND_AUTO) noexcept;
+
+    // Whether the CPU and the build support a backend.
+    static bool supported(BatchBackend backend) noexcept;
+
+    static const char* backendName(BatchBackend backend) noexcept;
+
+    // Backend in use, never BATCH_BACKEND_AUTO. An unsupported requested
+    // backend falls back to the automatic choice.
+    BatchBackend backend() const noexcept { return backend_; }
+
+    // Check the trailing HMAC of every view, ok[i] receives the result for
+    // views[i] and is false for views that are not valid(). Returns the
+    // number of frames that verified.
+    size_t verify(const PositionView* views, size_t count, bool* ok) const noexcept;
+
+private:
+    void setKey(const uint8_t* key, size_t keylen) noexcept;
+
+    uint32_t inner_[8] = {0};       // state after absorbing key ^ ipad
+    uint32_t outer_[8] = {0};       // state after absorbing key ^ opad
+    BatchBackend backend_ = BATCH_BACKEND_GENERIC;
+};
+
+// One-shot convenience, derives the key schedule on every call.
+size_t verifyBatch(const PositionView* views, size_t count, const char* key, bool* ok) noexcept;
+
+} // namespace Messages
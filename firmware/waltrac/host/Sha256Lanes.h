@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "BatchKernels.h"
+
+// Sha256Lanes.h - SHA-256 over N independent messages at once.
+//
+// V is a GCC vector of N uint32_t lanes, or plain uint32_t for one lane. The
+// kernel is written once and compiled by every kernel translation unit with
+// its own instruction set flags. Everything here has internal linkage, so no
+// two translation units share a copy built for a different CPU.
+
+namespace Messages {
+namespace BatchKernels {
+namespace {
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t SHA256_H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t load_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void store_be64(uint8_t* p, uint64_t v) {
+    for (size_t i = 0; i < 8; ++i) {
+        p[7 - i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+// Copy the signed part of a frame behind the 64 byte key block of the inner
+// hash and append the SHA-256 padding. Returns the number of 64 byte blocks.
+inline size_t pad_inner(uint8_t* out, const Frame& frame) {
+    const size_t len = frame.len - HMAC_SIZE;
+    const size_t blocks = (len + 9 + 63) / 64;
+
+    memcpy(out, frame.data, len);
+    out[len] = 0x80;
+    memset(out + len + 1, 0, blocks * 64 - len - 1);
+    store_be64(out + blocks * 64 - 8, (64 + static_cast<uint64_t>(len)) * 8);
+
+    return blocks;
+}
+
+template<typename V>
+inline V rotr(V x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// One SHA-256 block on every lane, w holds the 16 message words of each lane.
+template<typename V>
+inline void compress(V s[8], const V w16[16]) {
+    V w[64];
+    for (size_t i = 0; i < 16; ++i) {
+        w[i] = w16[i];
+    }
+
+    for (size_t i = 16; i < 64; ++i) {
+        const V s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const V s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    V a = s[0], b = s[1], c = s[2], d = s[3];
+    V e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (size_t i = 0; i < 64; ++i) {
+        const V t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        const V t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+}
+
+// Verify frames N at a time. Lanes run the same number of blocks, lanes with
+// shorter frames keep their state once their last block is done.
+template<typename V, size_t N>
+size_t verify_lanes(const uint32_t inner[8], const uint32_t outer[8], const Frame* frames, size_t count, bool* ok) {
+    static_assert(sizeof(V) == N * sizeof(uint32_t), "lane count does not match the vector type");
+
+    constexpr size_t MAX_BLOCKS = (MAX_MESSAGE_SIZE + 9 + 63) / 64;
+
+    alignas(64) uint8_t padded[N][MAX_BLOCKS * 64];
+    alignas(64) uint32_t words[16][N];
+    alignas(64) uint32_t digest[8][N];
+
+    size_t verified = 0;
+    for (size_t base = 0; base < count; base += N) {
+        const size_t lanes = count - base < N ? count - base : N;
+
+        size_t blocks[N];
+        size_t maxBlocks = 0;
+        for (size_t lane = 0; lane < N; ++lane) {
+            blocks[lane] = lane < lanes ? pad_inner(padded[lane], frames[base + lane]) : 0;
+            maxBlocks = blocks[lane] > maxBlocks ? blocks[lane] : maxBlocks;
+        }
+
+        V state[8];
+        for (size_t i = 0; i < 8; ++i) {
+            state[i] = V{} + inner[i];
+        }
+
+        for (size_t block = 0; block < maxBlocks; ++block) {
+            V w[16];
+            for (size_t j = 0; j < 16; ++j) {
+                for (size_t lane = 0; lane < N; ++lane) {
+                    words[j][lane] = block < blocks[lane] ? load_be32(padded[lane] + block * 64 + 4 * j) : 0;
+                }
+
+                memcpy(&w[j], words[j], sizeof(V));
+            }
+
+            uint32_t activeLanes[N];
+            for (size_t lane = 0; lane < N; ++lane) {
+                activeLanes[lane] = block < blocks[lane] ? 0xFFFFFFFF : 0;
+            }
+
+            V active;
+            memcpy(&active, activeLanes, sizeof(V));
+
+            V next[8];
+            for (size_t i = 0; i < 8; ++i) {
+                next[i] = state[i];
+            }
+
+            compress(next, w);
+
+            for (size_t i = 0; i < 8; ++i) {
+                state[i] = (next[i] & active) | (state[i] & ~active);
+            }
+        }
+
+        // outer hash over the 32 byte inner digest, a single padded block
+        V w[16];
+        for (size_t i = 0; i < 8; ++i) {
+            w[i] = state[i];
+        }
+
+        w[8] = V{} + 0x80000000u;
+        for (size_t i = 9; i < 15; ++i) {
+            w[i] = V{};
+        }
+
+        w[15] = V{} + static_cast<uint32_t>((64 + 32) * 8);
+
+        V out[8];
+        for (size_t i = 0; i < 8; ++i) {
+            out[i] = V{} + outer[i];
+        }
+
+        compress(out, w);
+
+        for (size_t i = 0; i < HMAC_SIZE / 4; ++i) {
+            memcpy(digest[i], &out[i], sizeof(V));
+        }
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const Frame& frame = frames[base + lane];
+            const uint8_t* mac = frame.data + frame.len - HMAC_SIZE;
+
+            bool match = true;
+            for (size_t i = 0; i < HMAC_SIZE / 4; ++i) {
+                match &= digest[i][lane] == load_be32(mac + 4 * i);
+            }
+
+            ok[base + lane] = match;
+            verified += match;
+        }
+    }
+
+    return verified;
+}
+
+} // namespace
+} // namespace BatchKernels
+} // namespace Messages
@@ -0,0 +1,758 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include "ModemSimulator.h"
+#include "SimKernel.h"
+#include "WaltracConfig.h"
+
+namespace sim {
+
+/* 2026-01-01T00:00:00Z, the UTC time at the start of every simulation */
+static constexpr int64_t EPOCH_SECONDS = 1767225600;
+
+static constexpr double EARTH_RADIUS = 6371000.0;
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+/* CoAP retransmission parameters of RFC 7252 */
+static constexpr int64_t ACK_TIMEOUT_MICROS = 2000000;
+static constexpr double ACK_RANDOM_FACTOR = 1.5;
+static constexpr int MAX_RETRANSMIT = 4;
+
+void ModemSimulator::configure(const Config& config)
+{
+    config_ = config;
+    random_.seed(config.seed);
+    trajectoryRandom_.seed(config.seed + 1);
+    signer_.setKey(WT_CFG_SECRET);
+
+    trajectoryAt_ = 0;
+    latitude_ = config_.startLatitude;
+    longitude_ = config_.startLongitude;
+    heading_ = std::uniform_real_distribution<double>(0.0, 360.0)(trajectoryRandom_);
+}
+
+void ModemSimulator::atCommand(int64_t extraMicros)
+{
+    stats_.atCommands++;
+    Kernel::instance().sleep(config_.atMicros + extraMicros);
+}
+
+int64_t ModemSimulator::draw(int64_t min, int64_t max)
+{
+    return std::uniform_int_distribution<int64_t>(min, std::max(min, max))(random_);
+}
+
+bool ModemSimulator::chance(double probability)
+{
+    return probability > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(random_) < probability;
+}
+
+void ModemSimulator::account()
+{
+    int64_t now = Kernel::instance().now();
+    int64_t span = now - accountedAt_;
+    int64_t from = accountedAt_;
+    accountedAt_ = now;
+
+    if (span <= 0) {
+        return;
+    }
+
+    if (espAsleep_) {
+        stats_.espSleepCharge += config_.espSleep * span;
+    } else {
+        stats_.espAwakeCharge += config_.espAwake * span;
+        stats_.espAwakeMicros += span;
+    }
+
+    if (gnssActive_) {
+        stats_.gnssCharge += config_.modemGnss * span;
+        stats_.gnssMicros += span;
+    } else if (registration_ == REG_ATTACHING) {
+        stats_.lteCharge += config_.modemAttach * span;
+        stats_.lteMicros += span;
+    } else if (registration_ == REG_REGISTERED) {
+        /* Connected for the tail after the last packet, paging or PSM after that */
+        int64_t connected = std::min(std::max<int64_t>(connectedUntil_ - from, 0), span);
+        double idle = psm_ && espAsleep_ ? config_.modemPsm : config_.modemIdle;
+
+        stats_.lteCharge += config_.modemConnected * connected + idle * (span - connected);
+        stats_.lteMicros += span;
+    } else {
+        stats_.modemIdleCharge += (espAsleep_ ? config_.modemPsm : config_.modemOff) * span;
+    }
+}
+
+void ModemSimulator::boot()
+{
+    account();
+    espAsleep_ = false;
+
+    /* The handlers belong to the firmware image of the last boot, setup() registers them again */
+    registrationHandler_ = nullptr;
+    gnssHandler_ = nullptr;
+    coapHandler_ = nullptr;
+
+    if (Kernel::instance().wokeFromSleep()) {
+        return;
+    }
+
+    /* Any other boot resets the modem, only the assistance data in its flash survives */
+    registrationGeneration_++;
+    gnssGeneration_++;
+    opState_ = WALTER_MODEM_OPSTATE_MINIMUM;
+    registration_ = REG_OFF;
+    clockValid_ = false;
+    psm_ = false;
+    connectedUntil_ = 0;
+    gnssActive_ = false;
+    acqMode_ = WALTER_MODEM_GNSS_ACQ_MODE_COLD_WARM_START;
+    contextOpen_ = false;
+    uriPath_.clear();
+    observe_ = false;
+    rings_.clear();
+}
+
+void ModemSimulator::finish()
+{
+    account();
+}
+
+bool ModemSimulator::begin()
+{
+    atCommand();
+    return true;
+}
+
+void ModemSimulator::sleep(uint32_t sleepMillis)
+{
+    account();
+    espAsleep_ = true;
+
+    /* Like the modem driver, sleeps whole seconds */
+    uint32_t sleepSeconds = (sleepMillis + SLEEP_RESOLUTION_MILLIS - 1) / SLEEP_RESOLUTION_MILLIS;
+    Kernel::instance().restart((int64_t)sleepSeconds * SLEEP_RESOLUTION_MILLIS * 1000);
+}
+
+bool ModemSimulator::configPSM(WalterModemPSMMode mode)
+{
+    atCommand();
+    account();
+
+    psm_ = (mode == WALTER_MODEM_PSM_ENABLE);
+    return true;
+}
+
+void ModemSimulator::setRegistration(Registration registration)
+{
+    account();
+
+    if (registration_ == REG_REGISTERED && registration != REG_REGISTERED) {
+        connectedUntil_ = 0;
+        closeContext();
+    }
+
+    registration_ = registration;
+
+    /* The network sets the clock with NITZ on registration */
+    if (registration == REG_REGISTERED && config_.nitz) {
+        clockValid_ = true;
+    }
+
+    if (registrationHandler_ != nullptr) {
+        registrationHandler_(getNetworkRegState(), registrationArgs_);
+    }
+}
+
+bool ModemSimulator::setOpState(WalterModemOpState state)
+{
+    atCommand();
+
+    opState_ = state;
+    uint32_t generation = ++registrationGeneration_;
+    int64_t now = Kernel::instance().now();
+
+    if (state == WALTER_MODEM_OPSTATE_FULL) {
+        if (registration_ != REG_OFF || gnssActive_) {
+            return registration_ != REG_OFF;
+        }
+
+        stats_.attaches++;
+        setRegistration(REG_ATTACHING);
+
+        Kernel::instance().schedule(now + draw(config_.attachMinMicros, config_.attachMaxMicros), [this, generation]() {
+            if (generation == registrationGeneration_) {
+                setRegistration(REG_REGISTERED);
+            }
+        });
+    } else if (registration_ != REG_OFF) {
+        Kernel::instance().schedule(now + config_.detachMicros, [this, generation]() {
+            if (generation == registrationGeneration_) {
+                stats_.detaches++;
+                setRegistration(REG_OFF);
+            }
+        });
+    }
+
+    return true;
+}
+
+bool ModemSimulator::definePDPContext()
+{
+    atCommand();
+    return true;
+}
+
+bool ModemSimulator::setNetworkSelectionMode(WalterModemNetworkSelMode /* mode */)
+{
+    atCommand();
+    return true;
+}
+
+WalterModemNetworkRegState ModemSimulator::getNetworkRegState()
+{
+    switch (registration_) {
+    case REG_REGISTERED:
+        return WALTER_MODEM_NETWORK_REG_REGISTERED_HOME;
+    case REG_ATTACHING:
+        return WALTER_MODEM_NETWORK_REG_SEARCHING;
+    default:
+        return WALTER_MODEM_NETWORK_REG_NOT_SEARCHING;
+    }
+}
+
+void ModemSimulator::setRegistrationEventHandler(RegistrationEventHandler handler, void* args)
+{
+    registrationHandler_ = handler;
+    registrationArgs_ = args;
+}
+
+bool ModemSimulator::gnssConfig(WalterModemGNSSSensMode /* sensMode */, WalterModemGNSSAcqMode acqMode)
+{
+    atCommand();
+
+    acqMode_ = acqMode;
+    return true;
+}
+
+int64_t ModemSimulator::utcSeconds() const
+{
+    return EPOCH_SECONDS + Kernel::instance().now() / 1000000;
+}
+
+void ModemSimulator::advanceTrajectory(int64_t to)
+{
+    const int64_t cycle = config_.parkedMicros + config_.drivingMicros;
+
+    while (trajectoryAt_ < to) {
+        int64_t phase = trajectoryAt_ % cycle;
+
+        if (phase < config_.parkedMicros) {
+            trajectoryAt_ = std::min(to, trajectoryAt_ + config_.parkedMicros - phase);
+            continue;
+        }
+
+        /* Drive in one second steps, the heading wanders a little with every step */
+        int64_t step = std::min({(int64_t)1000000, to - trajectoryAt_, cycle - phase});
+        double distance = config_.speed * step / 1000000.0;
+
+        latitude_ += distance * cos(heading_ * DEG_TO_RAD) / EARTH_RADIUS / DEG_TO_RAD;
+        longitude_ += distance * sin(heading_ * DEG_TO_RAD) / (EARTH_RADIUS * cos(latitude_ * DEG_TO_RAD)) / DEG_TO_RAD;
+        heading_ = fmod(heading_ + std::uniform_real_distribution<double>(-4.0, 4.0)(trajectoryRandom_) + 360.0, 360.0);
+
+        trajectoryAt_ += step;
+    }
+}
+
+void ModemSimulator::deliverFix(uint32_t generation, bool hot)
+{
+    if (generation != gnssGeneration_ || !gnssActive_) {
+        return;
+    }
+
+    account();
+    gnssActive_ = false;
+    clockValid_ = true;
+
+    int64_t now = Kernel::instance().now();
+    advanceTrajectory(now);
+
+    /* A few meters of noise around the true position */
+    std::normal_distribution<double> noise(0.0, 3.0);
+
+    WalterModemGNSSFix fix = {};
+    fix.fixId = (uint8_t)stats_.fixes;
+    fix.timestamp = utcSeconds();
+    fix.timeToFix = (now - lastFixAt_) / 1000;
+    fix.estimatedConfidence = hot ? draw(5, 30) : draw(10, 80);
+    fix.latitude = latitude_ + noise(random_) / EARTH_RADIUS / DEG_TO_RAD;
+    fix.longitude = longitude_ + noise(random_) / (EARTH_RADIUS * cos(latitude_ * DEG_TO_RAD)) / DEG_TO_RAD;
+    fix.satCount = 10;
+    for (int i = 0; i < fix.satCount; i++) {
+        fix.sats[i].satNo = i + 1;
+        fix.sats[i].signalStrength = draw(24, 42);
+    }
+
+    stats_.fixes++;
+    lastFixAt_ = now;
+
+    if (gnssHandler_ != nullptr) {
+        gnssHandler_(&fix, gnssArgs_);
+    }
+}
+
+bool ModemSimulator::gnssPerformAction(WalterModemGNSSAction action)
+{
+    atCommand();
+    account();
+
+    if (action == WALTER_MODEM_GNSS_ACTION_CANCEL) {
+        if (gnssActive_) {
+            gnssActive_ = false;
+            gnssGeneration_++;
+            stats_.fixesCancelled++;
+        }
+
+        return true;
+    }
+
+    /* GNSS and LTE share the radio, the modem refuses a fix while LTE is up */
+    if (opState_ == WALTER_MODEM_OPSTATE_FULL || registration_ != REG_OFF) {
+        return false;
+    }
+
+    gnssActive_ = true;
+    uint32_t generation = ++gnssGeneration_;
+
+    /* Without a valid clock the fix never arrives, the firmware has to time out */
+    if (!clockValid_ || chance(config_.fixFailure)) {
+        return true;
+    }
+
+    int64_t now = Kernel::instance().now();
+    bool ephemerisValid = ephemerisAt_ >= 0 && now < ephemerisAt_ + config_.ephemerisValidSeconds * 1000000;
+    bool hot = acqMode_ == WALTER_MODEM_GNSS_ACQ_MODE_HOT_START && ephemerisValid && lastFixAt_ >= 0;
+
+    int64_t ttff = hot ? draw(config_.hotFixMinMicros, config_.hotFixMaxMicros) : draw(config_.coldFixMinMicros, config_.coldFixMaxMicros);
+    if (!ephemerisValid) {
+        ttff = (int64_t)(ttff * config_.unassistedFactor);
+    }
+
+    Kernel::instance().schedule(now + ttff, [this, generation, hot]() {
+        deliverFix(generation, hot);
+    });
+
+    return true;
+}
+
+bool ModemSimulator::gnssGetUTCTime(WalterModemRsp* rsp)
+{
+    atCommand();
+    stats_.clockQueries++;
+
+    rsp->type = WALTER_MODEM_RSP_DATA_TYPE_CLOCK;
+    rsp->data.clock.epochTime = clockValid_ ? utcSeconds() : 0;
+    return true;
+}
+
+bool ModemSimulator::gnssGetAssistanceStatus(WalterModemRsp* rsp)
+{
+    atCommand();
+
+    int64_t now = Kernel::instance().now();
+    auto details = [now](WalterModemGNSSAssistanceTypeDetails& out, int64_t updatedAt, int64_t validSeconds) {
+        int64_t expiresAt = updatedAt + validSeconds * 1000000;
+
+        out = {};
+        out.available = updatedAt >= 0 && now < expiresAt;
+        out.lastUpdate = out.available ? (now - updatedAt) / 1000000 : 0;
+        out.timeToUpdate = out.available ? (expiresAt - now) / 1000000 : 0;
+        out.timeToExpire = out.timeToUpdate;
+    };
+
+    rsp->type = WALTER_MODEM_RSP_DATA_TYPE_GNSS_ASSISTANCE_DATA;
+    details(rsp->data.gnssAssistance.almanac, almanacAt_, config_.almanacValidSeconds);
+    details(rsp->data.gnssAssistance.realtimeEphemeris, ephemerisAt_, config_.ephemerisValidSeconds);
+    rsp->data.gnssAssistance.predictedEphemeris = {};
+
+    return true;
+}
+
+bool ModemSimulator::gnssUpdateAssistance(WalterModemGNSSAssistanceType type)
+{
+    atCommand();
+
+    if (registration_ != REG_REGISTERED) {
+        return false;
+    }
+
+    transmit();
+    Kernel::instance().sleep(config_.assistanceMicros);
+    transmit();
+
+    stats_.assistanceUpdates++;
+
+    int64_t now = Kernel::instance().now();
+    if (type == WALTER_MODEM_GNSS_ASSISTANCE_TYPE_ALMANAC) {
+        almanacAt_ = now;
+    } else {
+        ephemerisAt_ = now;
+    }
+
+    return true;
+}
+
+void ModemSimulator::gnssSetEventHandler(GnssEventHandler handler, void* args)
+{
+    gnssHandler_ = handler;
+    gnssArgs_ = args;
+}
+
+void ModemSimulator::transmit()
+{
+    account();
+
+    stats_.lteCharge += config_.modemTx * config_.txMicros;
+    connectedUntil_ = std::max(connectedUntil_, Kernel::instance().now() + config_.connectedTailMicros);
+}
+
+void ModemSimulator::closeContext()
+{
+    if (!contextOpen_) {
+        return;
+    }
+
+    contextOpen_ = false;
+    rings_.clear();
+
+    if (coapHandler_ != nullptr) {
+        coapHandler_(WALTER_MODEM_COAP_EVENT_DISCONNECTED, coapProfile_, coapArgs_);
+    }
+}
+
+bool ModemSimulator::coapGetContextStatus(int /* profileId */)
+{
+    atCommand();
+    return contextOpen_;
+}
+
+bool ModemSimulator::coapCreateContext(int profileId, const char* /* serverName */, int /* port */)
+{
+    atCommand(config_.roundTripMicros);
+
+    if (registration_ != REG_REGISTERED) {
+        return false;
+    }
+
+    transmit();
+    contextOpen_ = true;
+    coapProfile_ = profileId;
+
+    /* Options belong to the context, a new one starts without any */
+    uriPath_.clear();
+    observe_ = false;
+
+    if (coapHandler_ != nullptr) {
+        coapHandler_(WALTER_MODEM_COAP_EVENT_CONNECTED, coapProfile_, coapArgs_);
+    }
+
+    return true;
+}
+
+bool ModemSimulator::coapSetOptions(int /* profileId */, WalterModemCoapOptionAction action, WalterModemCoapOptionCode code, const char* values)
+{
+    atCommand();
+    stats_.uriOptions++;
+
+    if (code == WALTER_MODEM_COAP_OPT_CODE_URI_PATH) {
+        if (action == WALTER_MODEM_COAP_OPT_SET || action == WALTER_MODEM_COAP_OPT_DELETE) {
+            uriPath_.clear();
+        }
+
+        /* Repeatable options take up to 6 comma separated values per command */
+        if (action == WALTER_MODEM_COAP_OPT_SET || action == WALTER_MODEM_COAP_OPT_EXTEND) {
+            std::string list = values != nullptr ? values : "";
+            size_t start = 0;
+            for (int n = 0; n < 6; n++) {
+                size_t end = list.find(',', start);
+                uriPath_.push_back(list.substr(start, end - start));
+                if (end == std::string::npos) {
+                    break;
+                }
+
+                start = end + 1;
+            }
+        }
+    } else if (code == WALTER_MODEM_COAP_OPT_CODE_OBSERVE) {
+        observe_ = (action == WALTER_MODEM_COAP_OPT_SET);
+    }
+
+    return true;
+}
+
+bool ModemSimulator::coapSendData(int /* profileId */, WalterModemCoapSendType type, WalterModemCoapSendMethodRsp methodRsp, int length, uint8_t* payload)
+{
+    atCommand();
+
+    if (!contextOpen_ || registration_ != REG_REGISTERED) {
+        return false;
+    }
+
+    std::string path;
+    for (const std::string& segment : uriPath_) {
+        path += (path.empty() ? "" : "/") + segment;
+    }
+
+    /* A GET with Observe on the command resource subscribes the device */
+    if (methodRsp == WALTER_MODEM_COAP_SEND_METHOD_GET && observe_) {
+        path += "?observe";
+    }
+
+    auto delivery = std::make_shared<Delivery>();
+    delivery->payload.assign(payload, payload + (payload != nullptr ? length : 0));
+    delivery->path = path;
+    delivery->confirmable = (type == WALTER_MODEM_COAP_SEND_TYPE_CON);
+    delivery->sentAt = Kernel::instance().now();
+
+    stats_.uplinks++;
+    deliver(delivery);
+
+    return true;
+}
+
+void ModemSimulator::deliver(std::shared_ptr<Delivery> delivery)
+{
+    if (!contextOpen_ || registration_ != REG_REGISTERED) {
+        if (!delivery->received) {
+            stats_.lost++;
+        }
+
+        return;
+    }
+
+    transmit();
+    stats_.transmissions++;
+
+    int64_t now = Kernel::instance().now();
+    bool requestLost = chance(config_.packetLoss);
+    bool ackLost = delivery->confirmable && chance(config_.packetLoss);
+
+    /* The server drops duplicates by message ID */
+    if (!requestLost && !delivery->received) {
+        delivery->received = true;
+        Kernel::instance().schedule(now + config_.roundTripMicros / 2, [this, delivery]() {
+            receive(*delivery);
+        });
+    }
+
+    if (!delivery->confirmable || (!requestLost && !ackLost) || delivery->attempt >= MAX_RETRANSMIT) {
+        if (!delivery->received) {
+            stats_.lost++;
+        }
+
+        return;
+    }
+
+    /* Unacknowledged CON messages are repeated with exponential backoff */
+    double factor = std::uniform_real_distribution<double>(1.0, ACK_RANDOM_FACTOR)(random_);
+    int64_t timeout = (int64_t)(ACK_TIMEOUT_MICROS * factor) << delivery->attempt;
+    delivery->attempt++;
+
+    Kernel::instance().schedule(now + timeout, [this, delivery]() {
+        deliver(delivery);
+    });
+}
+
+void ModemSimulator::receive(const Delivery& delivery)
+{
+    const std::vector<uint8_t>& payload = delivery.payload;
+    const std::string& path = delivery.path;
+    int64_t now = Kernel::instance().now();
+
+    stats_.delivered++;
+    stats_.bytesDelivered += payload.size();
+
+    if (path == "ps/waltrac/cmd/control") {
+        Messages::CommandView command;
+        Messages::CommandAction action;
+        if (command.decode(payload.data(), payload.size(), signer_) == Messages::DECODE_STATUS_OK) {
+            command.getHeader(action);
+            if (action == Messages::COMMAND_ACTION_DISCOVER) {
+                deviceId_ = std::string(command.arg());
+                discoverPending_ = true;
+            }
+        }
+    } else if (path.rfind("ps/waltrac/cmd/", 0) == 0 && path.size() > 8 && path.compare(path.size() - 8, 8, "?observe") == 0) {
+        /* A setting the operator entered reaches the device once it observes its command resource again */
+        if (config_.serverInterval > 0 && !intervalSent_ && now >= config_.serverIntervalAtMicros) {
+            intervalSent_ = true;
+            pushCommand(Messages::COMMAND_ACTION_SETINTERVAL, std::to_string(config_.serverInterval), now + config_.roundTripMicros);
+        }
+
+        /* Like the control application, answer the subscription after a discovery with a session and let the device
+           go, later subscriptions only carry acknowledgements */
+        if (!discoverPending_) {
+            return;
+        }
+
+        discoverPending_ = false;
+        if (config_.assignSession) {
+            session_ = std::uniform_int_distribution<int>(1, 0xFFFF)(random_);
+            pushCommand(Messages::COMMAND_ACTION_SETSESSION, std::to_string(session_), now + config_.serverSessionMicros);
+        }
+
+        pushCommand(Messages::COMMAND_ACTION_EXIT, "", now + config_.serverExitMicros);
+    } else if (path.rfind("ps/waltrac/pos/", 0) == 0) {
+        if (!payload.empty() && (payload[0] & Messages::PositionBatch::HEADER_BATCH) && (payload[0] & Messages::PositionBatch::HEADER_SEQUENCED)) {
+            if (!receiveSequenced(payload, now)) {
+                return;
+            }
+        }
+
+        /* Bit 0 of every position header flags a fix, the others tell the server that the tracker is still searching */
+        if (payload.empty() || !(payload[0] & 0x01)) {
+            stats_.searchingDelivered++;
+            return;
+        }
+
+        /* The interval the tracker announces sits right after the header in every position format */
+        if (payload.size() > 1) {
+            stats_.intervalTotal += payload[1];
+            stats_.intervalMin = stats_.positionsDelivered == 0 ? payload[1] : std::min<uint32_t>(stats_.intervalMin, payload[1]);
+        }
+
+        stats_.positionsDelivered++;
+
+        /* Latency of the newest fix, the one a live map would show */
+        if (lastFixAt_ >= 0 && lastFixAt_ <= delivery.sentAt) {
+            int64_t latency = now - lastFixAt_;
+            stats_.latencyTotalMicros += latency;
+            stats_.latencyMaxMicros = std::max(stats_.latencyMaxMicros, latency);
+            stats_.latencySamples++;
+        }
+    } else if (path.rfind("ps/waltrac/tel/", 0) == 0) {
+        Messages::Telemetry frame;
+        if (Messages::Telemetry::decode(payload.data(), payload.size(), frame) == Messages::DECODE_STATUS_OK && frame.verify(signer_)) {
+            addTelemetry(frame);
+        }
+    }
+}
+
+bool ModemSimulator::receiveSequenced(const std::vector<uint8_t>& payload, int64_t now)
+{
+    Messages::PositionBatch batch;
+    if (Messages::PositionBatch::decode(payload.data(), payload.size(), batch) != Messages::DECODE_STATUS_OK || !batch.verify(signer_)) {
+        return false;
+    }
+
+    /* Same rule as the control application: start over at a batch far ahead of or behind the expected sequence */
+    uint16_t behind = nextSequence_ - batch.sequence;
+    if (!sequenceKnown_ || (behind > Messages::PositionBatch::SEQUENCE_WINDOW && behind < 0x8000)) {
+        sequenceKnown_ = true;
+        nextSequence_ = batch.sequence;
+        behind = 0;
+    }
+
+    uint16_t end = batch.sequence + batch.count;
+    uint16_t fresh = 0;
+    if (behind < 0x8000) {
+        fresh = behind < batch.count ? batch.count - behind : 0;
+        stats_.duplicateFixes += batch.count - fresh;
+    } else {
+        /* Ahead of the expected sequence, the device moved the fixes in between to its backlog */
+        fresh = batch.count;
+    }
+
+    if (fresh > 0) {
+        nextSequence_ = end;
+        stats_.sequencedFixes += fresh;
+    }
+
+    /* The acknowledgement is a notification like any command, so it can be lost on the way back */
+    if (!chance(config_.packetLoss)) {
+        pushCommand(Messages::COMMAND_ACTION_ACK, std::to_string(nextSequence_), now + config_.serverAckMicros);
+    }
+
+    return fresh > 0;
+}
+
+void ModemSimulator::addTelemetry(const Messages::Telemetry& frame)
+{
+    Messages::Telemetry& sum = stats_.telemetry;
+
+    stats_.telemetryFrames++;
+    sum.window += frame.window;
+    sum.awake += frame.awake;
+    sum.restarts += frame.restarts;
+    sum.crashes += frame.crashes;
+    sum.gnssRetries += frame.gnssRetries;
+    sum.gnssTimeouts += frame.gnssTimeouts;
+    sum.attachFailures += frame.attachFailures;
+    sum.sendFailures += frame.sendFailures;
+    sum.count = std::max(sum.count, frame.count);
+
+    for (uint8_t i = 0; i < frame.count; i++) {
+        Messages::Telemetry::Phase& phase = sum.phases[i];
+        phase.samples += frame.phases[i].samples;
+        phase.totalMillis += frame.phases[i].totalMillis;
+        phase.maxMillis = std::max(phase.maxMillis, frame.phases[i].maxMillis);
+        phase.charge += frame.phases[i].charge;
+        for (uint8_t b = 0; b < Messages::Telemetry::BUCKETS; b++) {
+            phase.buckets[b] += frame.phases[i].buckets[b];
+        }
+    }
+}
+
+void ModemSimulator::pushCommand(Messages::CommandAction action, const std::string& arg, int64_t at)
+{
+    Kernel::instance().schedule(at, [this, action, arg]() {
+        /* The notification only reaches a device that is still attached */
+        if (!contextOpen_ || registration_ != REG_REGISTERED) {
+            return;
+        }
+
+        Messages::Command command;
+        command.setHeader(action);
+        command.arg = arg;
+
+        std::vector<uint8_t> frame(Messages::Command::MAX_SIZE);
+        frame.resize(command.serialize(frame.data(), frame.size(), signer_));
+
+        transmit();
+        rings_.push_back(frame);
+        stats_.commands++;
+
+        if (coapHandler_ != nullptr) {
+            coapHandler_(WALTER_MODEM_COAP_EVENT_RING, coapProfile_, coapArgs_);
+        }
+    });
+}
+
+bool ModemSimulator::coapDidRing(int profileId, uint8_t* targetBuf, uint16_t targetBufSize, WalterModemRsp* rsp)
+{
+    atCommand();
+
+    if (rings_.empty()) {
+        return false;
+    }
+
+    const std::vector<uint8_t>& frame = rings_.front();
+    uint16_t length = std::min<size_t>(frame.size(), targetBufSize);
+    memcpy(targetBuf, frame.data(), length);
+    rings_.pop_front();
+
+    rsp->type = WALTER_MODEM_RSP_DATA_TYPE_COAP;
+    rsp->data.coapResponse.profileId = profileId;
+    rsp->data.coapResponse.length = length;
+    return true;
+}
+
+void ModemSimulator::coapSetEventHandler(CoapEventHandler handler, void* args)
+{
+    coapHandler_ = handler;
+    coapArgs_ = args;
+}
+
+} // namespace sim
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Messages.h"
+#include "ModemInterface.h"
+
+// ModemSimulator.h - the Walter modem, the network and the Waltrac server on
+// the virtual clock of sim::Kernel.
+//
+// Every modem call takes the time of an AT command round trip. Attaching,
+// GNSS fixes and CoAP deliveries complete in the background and report back
+// through the event handlers like the real modem does. Latencies are drawn
+// from the configured ranges with a seeded generator, so a run is
+// reproducible. An energy meter integrates the current of the ESP32 and of
+// the modem over the virtual time.
+
+namespace sim {
+
+class ModemSimulator : public ModemInterface {
+public:
+    struct Config {
+        uint32_t seed = 1;
+
+        int64_t atMicros = 20000;                   // round trip of one AT command
+        int64_t attachMinMicros = 2000000;          // registration after CFUN=1
+        int64_t attachMaxMicros = 8000000;
+        int64_t detachMicros = 300000;
+        bool nitz = true;                           // whether the network sets the clock on registration
+
+        int64_t coldFixMinMicros = 25000000;        // cold or warm start with valid assistance
+        int64_t coldFixMaxMicros = 45000000;
+        int64_t hotFixMinMicros = 2000000;
+        int64_t hotFixMaxMicros = 6000000;
+        double unassistedFactor = 3.0;              // slowdown without valid ephemeris
+        double fixFailure = 0.02;                   // chance that a fix never arrives
+        int64_t almanacValidSeconds = 7 * 86400;
+        int64_t ephemerisValidSeconds = 4 * 3600;
+        int64_t assistanceMicros = 3000000;         // download of one assistance data set
+
+        double packetLoss = 0.0;                    // chance that one CoAP transmission is lost, either way
+        int64_t roundTripMicros = 300000;
+        int64_t serverSessionMicros = 5000000;      // from the command subscription to SETSESSION
+        int64_t serverExitMicros = 10000000;        // from the command subscription to EXIT
+        int64_t serverAckMicros = 200000;           // from a sequenced batch to its ACK
+        bool assignSession = true;
+        uint32_t serverInterval = 0;                // SETINTERVAL the operator sends, 0 never
+        int64_t serverIntervalAtMicros = 0;         // goes out with the first command subscription after this time
+
+        double startLatitude = 48.7758;
+        double startLongitude = 9.1829;
+        int64_t parkedMicros = 1800000000;          // the asset alternates parking and driving
+        int64_t drivingMicros = 1200000000;
+        double speed = 13.0;                        // m/s while driving
+
+        // Currents in mA
+        double espAwake = 40.0;
+        double espSleep = 0.01;
+        double modemOff = 0.5;                      // CFUN=0 or idle GNSS, UART awake
+        double modemAttach = 90.0;
+        double modemConnected = 60.0;               // RRC connected, held for the tail after each packet
+        double modemIdle = 2.0;                     // registered, DRX paging
+        double modemPsm = 0.005;                    // registered in PSM while the ESP32 sleeps
+        double modemGnss = 30.0;
+        double modemTx = 180.0;                     // on top of connected while a packet is on the air
+        int64_t txMicros = 50000;
+        int64_t connectedTailMicros = 10000000;
+    };
+
+    struct Stats {
+        uint32_t atCommands = 0;
+        uint32_t uriOptions = 0;            // coapSetOptions calls
+        uint32_t attaches = 0;
+        uint32_t detaches = 0;
+        uint32_t fixes = 0;
+        uint32_t fixesCancelled = 0;
+        uint32_t assistanceUpdates = 0;
+        uint32_t clockQueries = 0;
+
+        uint32_t uplinks = 0;               // payloads handed to the modem
+        uint32_t transmissions = 0;         // including CoAP retransmissions
+        uint32_t delivered = 0;
+        uint32_t lost = 0;
+        uint32_t positionsDelivered = 0;
+        uint32_t searchingDelivered = 0;    // position frames without a fix
+        uint64_t intervalTotal = 0;         // seconds to the next fix as announced by position frames with a fix
+        uint32_t intervalMin = 0;
+        uint32_t sequencedFixes = 0;        // fixes of sequenced batches the server had not seen before
+        uint32_t duplicateFixes = 0;        // repeated fixes of sequenced batches
+        uint64_t bytesDelivered = 0;
+        int64_t latencyTotalMicros = 0;     // from the newest fix to its delivery at the server
+        int64_t latencyMaxMicros = 0;
+        uint32_t latencySamples = 0;
+        uint32_t commands = 0;              // commands pushed to the device
+        uint32_t telemetryFrames = 0;
+        Messages::Telemetry telemetry;      // sum of all delivered telemetry frames
+
+        double espAwakeCharge = 0;          // mA * microseconds per consumer
+        double espSleepCharge = 0;
+        double lteCharge = 0;
+        double gnssCharge = 0;
+        double modemIdleCharge = 0;
+        int64_t espAwakeMicros = 0;
+        int64_t gnssMicros = 0;
+        int64_t lteMicros = 0;              // attaching or registered
+    };
+
+    ModemSimulator() { configure(Config()); }
+
+    // Replaces the configuration and starts over with a fresh generator and trajectory, call before the run.
+    void configure(const Config& config);
+
+    // Called by the kernel on every boot, before setup() runs.
+    void boot();
+
+    // Integrates the current up to now, call once at the end of a run.
+    void finish();
+
+    const Stats& stats() const { return stats_; }
+    const Config& config() const { return config_; }
+
+    bool begin() override;
+    void sleep(uint32_t sleepMillis) override;
+    bool configPSM(WalterModemPSMMode mode) override;
+
+    bool setOpState(WalterModemOpState state) override;
+    bool definePDPContext() override;
+    bool setNetworkSelectionMode(WalterModemNetworkSelMode mode) override;
+    WalterModemNetworkRegState getNetworkRegState() override;
+    void setRegistrationEventHandler(RegistrationEventHandler handler, void* args) override;
+
+    bool gnssConfig(WalterModemGNSSSensMode sensMode, WalterModemGNSSAcqMode acqMode) override;
+    bool gnssPerformAction(WalterModemGNSSAction action) override;
+    bool gnssGetUTCTime(WalterModemRsp* rsp) override;
+    bool gnssGetAssistanceStatus(WalterModemRsp* rsp) override;
+    bool gnssUpdateAssistance(WalterModemGNSSAssistanceType type) override;
+    void gnssSetEventHandler(GnssEventHandler handler, void* args) override;
+
+    bool coapGetContextStatus(int profileId) override;
+    bool coapCreateContext(int profileId, const char* serverName, int port) override;
+    bool coapSetOptions(int profileId, WalterModemCoapOptionAction action, WalterModemCoapOptionCode code, const char* values) override;
+    bool coapSendData(int profileId, WalterModemCoapSendType type, WalterModemCoapSendMethodRsp methodRsp, int length, uint8_t* payload) override;
+    bool coapDidRing(int profileId, uint8_t* targetBuf, uint16_t targetBufSize, WalterModemRsp* rsp) override;
+    void coapSetEventHandler(CoapEventHandler handler, void* args) override;
+
+private:
+    struct Delivery {
+        std::vector<uint8_t> payload;
+        std::string path;
+        bool confirmable = true;
+        int64_t sentAt = 0;
+        bool received = false;          // by the server, the acknowledgement may still be lost
+        int attempt = 0;
+    };
+
+    enum Registration {
+        REG_OFF,
+        REG_ATTACHING,
+        REG_REGISTERED,
+    };
+
+    void atCommand(int64_t extraMicros = 0);
+    int64_t draw(int64_t min, int64_t max);
+    bool chance(double probability);
+
+    void account();
+    void setRegistration(Registration registration);
+    void transmit();
+
+    int64_t utcSeconds() const;
+    void advanceTrajectory(int64_t to);
+    void deliverFix(uint32_t generation, bool hot);
+
+    void deliver(std::shared_ptr<Delivery> delivery);
+    void receive(const Delivery& delivery);
+    bool receiveSequenced(const std::vector<uint8_t>& payload, int64_t now);
+    void addTelemetry(const Messages::Telemetry& frame);
+    void pushCommand(Messages::CommandAction action, const std::string& arg, int64_t at);
+    void closeContext();
+
+    Config config_;
+    Stats stats_;
+    std::mt19937 random_;
+    std::mt19937 trajectoryRandom_;     // separate, so the route does not change with the radio parameters
+    Messages::Signer signer_;
+
+    /* Energy */
+    int64_t accountedAt_ = 0;
+    bool espAsleep_ = false;
+    bool psm_ = false;
+    int64_t connectedUntil_ = 0;
+
+    /* LTE */
+    WalterModemOpState opState_ = WALTER_MODEM_OPSTATE_MINIMUM;
+    Registration registration_ = REG_OFF;
+    uint32_t registrationGeneration_ = 0;
+    bool clockValid_ = false;
+    RegistrationEventHandler registrationHandler_ = nullptr;
+    void* registrationArgs_ = nullptr;
+
+    /* GNSS */
+    WalterModemGNSSAcqMode acqMode_ = WALTER_MODEM_GNSS_ACQ_MODE_COLD_WARM_START;
+    bool gnssActive_ = false;
+    uint32_t gnssGeneration_ = 0;
+    int64_t almanacAt_ = -1;
+    int64_t ephemerisAt_ = -1;
+    int64_t lastFixAt_ = -1;
+    GnssEventHandler gnssHandler_ = nullptr;
+    void* gnssArgs_ = nullptr;
+
+    /* Trajectory */
+    int64_t trajectoryAt_ = 0;
+    double latitude_ = 0;
+    double longitude_ = 0;
+    double heading_ = 0;
+
+    /* CoAP */
+    bool contextOpen_ = false;
+    int coapProfile_ = 0;
+    std::vector<std::string> uriPath_;
+    bool observe_ = false;
+    std::deque<std::vector<uint8_t>> rings_;
+    std::string deviceId_;
+    uint16_t session_ = 0;
+    bool discoverPending_ = false;      // the next command subscription gets a session and EXIT
+    bool intervalSent_ = false;
+    bool sequenceKnown_ = false;
+    uint16_t nextSequence_ = 0;         // expected sequence number of the next new fix
+    CoapEventHandler coapHandler_ = nullptr;
+    void* coapArgs_ = nullptr;
+};
+
+} // namespace sim
@@ -0,0 +1,69 @@
+#include <dlfcn.h>
+
+#include <cstring>
+
+#include "SimFirmware.h"
+
+namespace sim {
+
+Firmware::~Firmware()
+{
+    unload();
+}
+
+void Firmware::unload()
+{
+    if (handle_ == nullptr) {
+        return;
+    }
+
+    /* Keep RTC memory before the image goes away */
+    char* begin = nullptr;
+    char* end = nullptr;
+    rtcMemory_(&begin, &end);
+    retained_.assign(begin, end);
+
+    rtcNoinitMemory_(&begin, &end);
+    noinit_.assign(begin, end);
+
+    dlclose(handle_);
+    handle_ = nullptr;
+}
+
+bool Firmware::boot(bool wokeFromSleep)
+{
+    unload();
+
+    handle_ = dlopen(path_.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle_ == nullptr) {
+        error_ = dlerror();
+        return false;
+    }
+
+    setup_ = reinterpret_cast<void (*)()>(dlsym(handle_, "simSetup"));
+    loop_ = reinterpret_cast<void (*)()>(dlsym(handle_, "simLoop"));
+    rtcMemory_ = reinterpret_cast<void (*)(char**, char**)>(dlsym(handle_, "simRtcMemory"));
+    rtcNoinitMemory_ = reinterpret_cast<void (*)(char**, char**)>(dlsym(handle_, "simRtcNoinitMemory"));
+    if (setup_ == nullptr || loop_ == nullptr || rtcMemory_ == nullptr || rtcNoinitMemory_ == nullptr) {
+        error_ = "firmware module lacks simSetup(), simLoop(), simRtcMemory() or simRtcNoinitMemory()";
+        return false;
+    }
+
+    /* A timer wake-up finds RTC memory as it was, any other boot initializes it */
+    char* begin = nullptr;
+    char* end = nullptr;
+    rtcMemory_(&begin, &end);
+    if (wokeFromSleep && retained_.size() == (size_t)(end - begin)) {
+        memcpy(begin, retained_.data(), retained_.size());
+    }
+
+    /* Memory the bootloader leaves alone keeps its content over every boot of this run */
+    rtcNoinitMemory_(&begin, &end);
+    if (noinit_.size() == (size_t)(end - begin)) {
+        memcpy(begin, noinit_.data(), noinit_.size());
+    }
+
+    return true;
+}
+
+} // namespace sim
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// SimFirmware.h - the firmware image of the simulated ESP32.
+//
+// The firmware is built as a module and loaded again on every boot, so each
+// boot starts with freshly initialized globals and function statics, like
+// after a reset. Only RTC memory (RTC_DATA_ATTR) is copied over a deep
+// sleep, and RTC_NOINIT_ATTR memory over every restart.
+
+namespace sim {
+
+class Firmware {
+public:
+    explicit Firmware(std::string path) : path_(std::move(path)) {}
+    ~Firmware();
+
+    // Replaces the image of the last boot with a fresh one. Returns false with error() set if it cannot be loaded.
+    bool boot(bool wokeFromSleep);
+
+    void setup() { setup_(); }
+    void loop() { loop_(); }
+
+    const std::string& error() const { return error_; }
+
+private:
+    void unload();
+
+    std::string path_;
+    std::string error_;
+    void* handle_ = nullptr;
+    void (*setup_)() = nullptr;
+    void (*loop_)() = nullptr;
+    void (*rtcMemory_)(char** begin, char** end) = nullptr;
+    void (*rtcNoinitMemory_)(char** begin, char** end) = nullptr;
+    std::vector<char> retained_;
+    std::vector<char> noinit_;
+};
+
+} // namespace sim
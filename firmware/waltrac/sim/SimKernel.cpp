@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "SimKernel.h"
+
+namespace sim {
+
+Kernel& Kernel::instance()
+{
+    static Kernel kernel;
+    return kernel;
+}
+
+const char* Kernel::currentTaskName() const
+{
+    return current_ != nullptr ? current_->name.c_str() : "kernel";
+}
+
+void Kernel::createTask(const std::string& name, int priority, std::function<void()> body)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    tasks_.push_back(std::make_unique<Task>());
+    Task* task = tasks_.back().get();
+    task->name = name;
+    task->priority = priority;
+    task->order = nextOrder_++;
+    task->waiting = true;
+    task->wakeAt = now_;
+
+    task->thread = std::thread([this, task, body]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task->resume.wait(lock, [&]() { return current_ == task; });
+        task->started = true;
+        task->waiting = false;
+
+        if (!task->abort) {
+            lock.unlock();
+            try {
+                body();
+            } catch (const TaskExit&) {
+            }
+            lock.lock();
+        }
+
+        task->finished = true;
+        current_ = nullptr;
+        kernelWake_.notify_all();
+    });
+}
+
+void Kernel::exitTask()
+{
+    throw TaskExit();
+}
+
+void Kernel::yieldTask(Task& task, std::unique_lock<std::mutex>& lock)
+{
+    current_ = nullptr;
+    kernelWake_.notify_all();
+    task.resume.wait(lock, [&]() { return current_ == &task; });
+}
+
+void Kernel::resumeTask(Task& task, std::unique_lock<std::mutex>& lock)
+{
+    current_ = &task;
+    task.resume.notify_all();
+    kernelWake_.wait(lock, [&]() { return current_ == nullptr; });
+}
+
+bool Kernel::wait(const std::function<bool()>& ready, int64_t timeoutMicros)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    Task* task = current_;
+    if (task == nullptr) {
+        fprintf(stderr, "sim: blocking call outside of a task\n");
+        abort();
+    }
+
+    task->ready = ready;
+    task->wakeAt = timeoutMicros < 0 ? -1 : now_ + timeoutMicros;
+    task->result = false;
+    task->waiting = true;
+
+    yieldTask(*task, lock);
+
+    task->waiting = false;
+    task->ready = nullptr;
+
+    if (task->abort) {
+        lock.unlock();
+        throw TaskExit();
+    }
+
+    return task->result;
+}
+
+void Kernel::restart(int64_t sleepMicros)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        restartPending_ = true;
+        restartFromSleep_ = sleepMicros >= 0;
+        restartAt_ = now_ + std::max<int64_t>(sleepMicros, 0);
+
+        if (restartFromSleep_) {
+            sleeps_++;
+            sleepTime_ += restartAt_ - now_;
+        } else {
+            resets_++;
+        }
+
+        for (auto& task : tasks_) {
+            task->abort = true;
+        }
+    }
+
+    throw TaskExit();
+}
+
+void Kernel::schedule(int64_t at, std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timers_.emplace(std::max(at, now_), std::move(callback));
+}
+
+void Kernel::reapFinished()
+{
+    std::vector<std::unique_ptr<Task>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = tasks_.begin(); it != tasks_.end();) {
+            if ((*it)->finished) {
+                finished.push_back(std::move(*it));
+                it = tasks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto& task : finished) {
+        task->thread.join();
+    }
+}
+
+void Kernel::abortAll(std::unique_lock<std::mutex>& lock)
+{
+    for (auto& task : tasks_) {
+        task->abort = true;
+    }
+
+    for (auto& task : tasks_) {
+        if (!task->finished) {
+            resumeTask(*task, lock);
+        }
+    }
+}
+
+void Kernel::run(int64_t until)
+{
+    bootTime_ = now_;
+    wokeFromSleep_ = false;
+    if (boot_) {
+        boot_();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        lock.unlock();
+        reapFinished();
+        lock.lock();
+
+        /* Boot again once every task is gone and the deep sleep is over */
+        if (restartPending_ && tasks_.empty() && now_ >= restartAt_) {
+            restartPending_ = false;
+            bootTime_ = now_;
+            wokeFromSleep_ = restartFromSleep_;
+
+            lock.unlock();
+            if (boot_) {
+                boot_();
+            }
+            lock.lock();
+            continue;
+        }
+
+        /* Modem events of this instant come first */
+        auto timer = timers_.begin();
+        if (timer != timers_.end() && timer->first <= now_) {
+            std::function<void()> callback = std::move(timer->second);
+            timers_.erase(timer);
+
+            lock.unlock();
+            callback();
+            lock.lock();
+            continue;
+        }
+
+        /* The highest priority task that can go on runs next, tasks that are torn down before all others */
+        Task* next = nullptr;
+        for (auto& task : tasks_) {
+            if (!task->waiting || task->finished) {
+                continue;
+            }
+
+            bool ready = task->ready && task->ready();
+            bool due = task->wakeAt >= 0 && task->wakeAt <= now_;
+            if (!ready && !due && !task->abort) {
+                continue;
+            }
+
+            task->result = ready;
+            if (next == nullptr || (task->abort && !next->abort) || (task->abort == next->abort && (task->priority > next->priority || (task->priority == next->priority && task->order < next->order)))) {
+                next = task.get();
+            }
+        }
+
+        if (next != nullptr) {
+            next->order = nextOrder_++;
+            resumeTask(*next, lock);
+            continue;
+        }
+
+        /* Everything waits, jump to the next point in time something happens */
+        int64_t wakeAt = -1;
+        if (!timers_.empty()) {
+            wakeAt = timers_.begin()->first;
+        }
+        for (auto& task : tasks_) {
+            if (task->waiting && task->wakeAt >= 0 && (wakeAt < 0 || task->wakeAt < wakeAt)) {
+                wakeAt = task->wakeAt;
+            }
+        }
+        if (restartPending_ && tasks_.empty() && (wakeAt < 0 || restartAt_ < wakeAt)) {
+            wakeAt = restartAt_;
+        }
+
+        if (wakeAt < 0) {
+            break;
+        }
+
+        if (wakeAt > until) {
+            now_ = until;
+            break;
+        }
+
+        now_ = std::max(now_, wakeAt);
+    }
+
+    /* Tear down whatever still runs */
+    abortAll(lock);
+    lock.unlock();
+    reapFinished();
+}
+
+} // namespace sim
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SimKernel.h - deterministic virtual time for running the firmware on Linux.
+//
+// Every firmware task runs on its own thread, but only one of them runs at
+// a time: a task runs until it blocks in delay(), an RTOS primitive or a
+// modem call, then the kernel picks the next task. Once every task is
+// blocked the clock jumps to the earliest timeout or timer. Runs are
+// therefore reproducible and take as long as the firmware computes, not as
+// long as it waits.
+
+namespace sim {
+
+class Kernel {
+public:
+    // Thrown inside a task to unwind it when it is deleted or the ESP32 restarts.
+    struct TaskExit {};
+
+    static Kernel& instance();
+
+    // Virtual time in microseconds since the start of the simulation.
+    int64_t now() const { return now_; }
+
+    // Virtual time of the last (re)boot, millis() and esp_timer count from here.
+    int64_t bootTime() const { return bootTime_; }
+
+    // Whether the last boot was a timer wake-up from deep sleep.
+    bool wokeFromSleep() const { return wokeFromSleep_; }
+
+    // Start a task, higher priorities run first when several tasks are ready.
+    void createTask(const std::string& name, int priority, std::function<void()> body);
+
+    // Task context. Ends the calling task.
+    [[noreturn]] void exitTask();
+
+    // Task context. Blocks until ready() returns true or timeoutMicros passed, a negative timeout waits forever.
+    // ready is evaluated by the kernel while no task runs. Returns whether ready() was true.
+    bool wait(const std::function<bool()>& ready, int64_t timeoutMicros);
+
+    // Task context. Lets the virtual clock advance by duration.
+    void sleep(int64_t durationMicros) { wait(nullptr, durationMicros); }
+
+    // Task context. Restarts the ESP32, right away or after a deep sleep of sleepMicros. Does not return.
+    [[noreturn]] void restart(int64_t sleepMicros = -1);
+
+    // Run a callback at the given virtual time, outside of any task. Used for modem events.
+    void schedule(int64_t at, std::function<void()> callback);
+
+    // Called to boot the ESP32, at the start and after every restart.
+    void onBoot(std::function<void()> boot) { boot_ = std::move(boot); }
+
+    // Run until the virtual clock reaches until or nothing is left to run.
+    void run(int64_t until);
+
+    // Number of restarts, split into deep sleeps and resets.
+    uint32_t sleeps() const { return sleeps_; }
+    uint32_t resets() const { return resets_; }
+
+    // Virtual time spent in deep sleep.
+    int64_t sleepTime() const { return sleepTime_; }
+
+    // Name of the task that runs, for the log.
+    const char* currentTaskName() const;
+
+private:
+    struct Task {
+        std::string name;
+        int priority = 0;
+        uint64_t order = 0;                 // FIFO among equal priorities
+        std::thread thread;
+        std::function<bool()> ready;
+        int64_t wakeAt = -1;                // -1 waits without timeout
+        bool started = false;
+        bool waiting = false;
+        bool abort = false;
+        bool finished = false;
+        bool result = false;                // what wait() returns
+        std::condition_variable resume;
+    };
+
+    Kernel() = default;
+
+    void resumeTask(Task& task, std::unique_lock<std::mutex>& lock);
+    void yieldTask(Task& task, std::unique_lock<std::mutex>& lock);
+    void abortAll(std::unique_lock<std::mutex>& lock);
+    void reapFinished();
+
+    std::mutex mutex_;
+    std::condition_variable kernelWake_;
+    std::vector<std::unique_ptr<Task>> tasks_;
+    Task* current_ = nullptr;
+    uint64_t nextOrder_ = 0;
+
+    std::multimap<int64_t, std::function<void()>> timers_;
+
+    std::function<void()> boot_;
+    bool restartPending_ = false;
+    int64_t restartAt_ = 0;
+    bool restartFromSleep_ = false;
+
+    int64_t now_ = 0;
+    int64_t bootTime_ = 0;
+    bool wokeFromSleep_ = false;
+    uint32_t sleeps_ = 0;
+    uint32_t resets_ = 0;
+    int64_t sleepTime_ = 0;
+};
+
+} // namespace sim
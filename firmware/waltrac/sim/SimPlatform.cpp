@@ -0,0 +1,468 @@
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <cstdarg>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "SimKernel.h"
+#include "SimPlatform.h"
+
+// SimPlatform.cpp - Arduino core, ESP-IDF and FreeRTOS on top of sim::Kernel.
+
+using sim::Kernel;
+
+/* Arduino */
+
+HardwareSerial Serial;
+HardwareSerial Serial2;
+EspClass ESP;
+
+uint32_t millis()
+{
+    return (Kernel::instance().now() - Kernel::instance().bootTime()) / 1000;
+}
+
+uint32_t micros()
+{
+    return Kernel::instance().now() - Kernel::instance().bootTime();
+}
+
+void delay(uint32_t ms)
+{
+    Kernel::instance().sleep((int64_t)ms * 1000);
+}
+
+void EspClass::restart()
+{
+    Kernel::instance().restart();
+}
+
+/* ESP-IDF */
+
+int64_t esp_timer_get_time()
+{
+    return Kernel::instance().now() - Kernel::instance().bootTime();
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause()
+{
+    return Kernel::instance().wokeFromSleep() ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_reset_reason_t esp_reset_reason()
+{
+    Kernel& kernel = Kernel::instance();
+    if (kernel.wokeFromSleep()) {
+        return ESP_RST_DEEPSLEEP;
+    }
+
+    return kernel.sleeps() + kernel.resets() == 0 ? ESP_RST_POWERON : ESP_RST_SW;
+}
+
+uint32_t esp_random()
+{
+    /* Fixed seed, runs stay reproducible */
+    static std::mt19937 random(0x57414c54);
+    return random();
+}
+
+static uint8_t simMac[6] = {0x02, 0x57, 0x41, 0x4c, 0x00, 0x01};
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t /* type */)
+{
+    memcpy(mac, simMac, sizeof(simMac));
+    return 0;
+}
+
+static esp_log_level_t logLevel = ESP_LOG_WARN;
+static std::map<std::string, esp_log_level_t> tagLevels;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0) {
+        logLevel = level;
+        tagLevels.clear();
+    } else {
+        tagLevels[tag] = level;
+    }
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    auto it = tagLevels.find(tag);
+    if (level > (it != tagLevels.end() ? it->second : logLevel)) {
+        return;
+    }
+
+    static const char letters[] = "NEWIDV";
+    int64_t now = Kernel::instance().now();
+    printf("[%6" PRIi64 ".%03" PRIi64 "] %c (%s) ", now / 1000000, now / 1000 % 1000, letters[level], tag);
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    putchar('\n');
+}
+
+/* FreeRTOS, a timeout of portMAX_DELAY blocks forever */
+
+static int64_t ticksToMicros(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? -1 : (int64_t)ticks * 1000;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t /* stackDepth */, void* parameters, UBaseType_t priority, TaskHandle_t* created)
+{
+    Kernel::instance().createTask(name, priority, [function, parameters]() {
+        function(parameters);
+    });
+
+    if (created != nullptr) {
+        *created = nullptr;
+    }
+
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task != nullptr) {
+        fprintf(stderr, "sim: vTaskDelete only deletes the calling task\n");
+        abort();
+    }
+
+    Kernel::instance().exitTask();
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return millis();
+}
+
+struct SimEventGroup {
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new SimEventGroup();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t ticks)
+{
+    auto satisfied = [group, bits, waitForAll]() {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+
+    if (!satisfied() && ticks > 0) {
+        Kernel::instance().wait(satisfied, ticksToMicros(ticks));
+    }
+
+    EventBits_t result = group->bits;
+    if (clearOnExit && satisfied()) {
+        group->bits &= ~bits;
+    }
+
+    return result;
+}
+
+struct SimQueue {
+    size_t length = 0;
+    size_t itemSize = 0;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    SimQueue* queue = new SimQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    auto space = [queue]() { return queue->items.size() < queue->length; };
+
+    if (!space() && (ticks == 0 || !Kernel::instance().wait(space, ticksToMicros(ticks)))) {
+        return pdFALSE;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+
+    /* Like FreeRTOS, a receiver of higher priority that was waiting for the item runs right away */
+    Kernel::instance().sleep(0);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    auto available = [queue]() { return !queue->items.empty(); };
+
+    if (!available() && (ticks == 0 || !Kernel::instance().wait(available, ticksToMicros(ticks)))) {
+        return pdFALSE;
+    }
+
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->items.size();
+}
+
+struct SimMutex {
+    bool taken = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new SimMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    auto free = [mutex]() { return !mutex->taken; };
+
+    if (!free() && (ticks == 0 || !Kernel::instance().wait(free, ticksToMicros(ticks)))) {
+        return pdFALSE;
+    }
+
+    mutex->taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    mutex->taken = false;
+    return pdTRUE;
+}
+
+/* LittleFS, the flash content outlives restarts */
+
+LittleFSFS LittleFS;
+
+static std::map<std::string, std::vector<uint8_t>> flashFiles;
+static std::map<std::string, bool> flashDirs;
+
+static std::string parentOf(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos || slash == 0 ? "/" : path.substr(0, slash);
+}
+
+void File::setName()
+{
+    size_t slash = path_.rfind('/');
+    name_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+}
+
+size_t File::read(uint8_t* buffer, size_t len)
+{
+    auto it = flashFiles.find(path_);
+    if (!open_ || directory_ || it == flashFiles.end() || position_ >= it->second.size()) {
+        return 0;
+    }
+
+    len = std::min(len, it->second.size() - position_);
+    memcpy(buffer, it->second.data() + position_, len);
+    position_ += len;
+    return len;
+}
+
+size_t File::write(const uint8_t* buffer, size_t len)
+{
+    auto it = flashFiles.find(path_);
+    if (!open_ || directory_ || it == flashFiles.end()) {
+        return 0;
+    }
+
+    std::vector<uint8_t>& content = it->second;
+    if (content.size() < position_ + len) {
+        content.resize(position_ + len);
+    }
+
+    memcpy(content.data() + position_, buffer, len);
+    position_ += len;
+    return len;
+}
+
+size_t File::size() const
+{
+    auto it = flashFiles.find(path_);
+    return it != flashFiles.end() ? it->second.size() : 0;
+}
+
+bool File::seek(uint32_t position)
+{
+    if (!open_ || directory_ || position > size()) {
+        return false;
+    }
+
+    position_ = position;
+    return true;
+}
+
+File File::openNextFile()
+{
+    if (!open_ || !directory_) {
+        return File();
+    }
+
+    /* position_ counts the entries handed out so far */
+    size_t index = 0;
+    for (const auto& file : flashFiles) {
+        if (parentOf(file.first) == path_ && index++ == position_) {
+            position_++;
+            return File(file.first, false, 0);
+        }
+    }
+
+    return File();
+}
+
+bool LittleFSFS::begin(bool /* formatOnFail */)
+{
+    flashDirs["/"] = true;
+    return true;
+}
+
+bool LittleFSFS::exists(const char* path)
+{
+    return flashFiles.count(path) > 0 || flashDirs.count(path) > 0;
+}
+
+bool LittleFSFS::mkdir(const char* path)
+{
+    flashDirs[path] = true;
+    return true;
+}
+
+bool LittleFSFS::remove(const char* path)
+{
+    return flashFiles.erase(path) > 0;
+}
+
+File LittleFSFS::open(const char* path, const char* mode)
+{
+    if (flashDirs.count(path) > 0) {
+        return File(path, true, 0);
+    }
+
+    if (mode[0] == 'r') {
+        return flashFiles.count(path) > 0 ? File(path, false, 0) : File();
+    }
+
+    if (flashDirs.count(parentOf(path)) == 0) {
+        return File();
+    }
+
+    std::vector<uint8_t>& content = flashFiles[path];
+    if (mode[0] == 'w') {
+        content.clear();
+    }
+
+    return File(path, false, mode[0] == 'a' ? content.size() : 0);
+}
+
+/* Preferences, the NVS entries outlive restarts as well */
+
+static std::map<std::string, std::vector<uint8_t>> nvsEntries;
+
+bool Preferences::begin(const char* name, bool readOnly, const char* /* partitionLabel */)
+{
+    namespace_ = name;
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+}
+
+void Preferences::end()
+{
+    open_ = false;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len)
+{
+    if (!open_ || readOnly_) {
+        return 0;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    nvsEntries[namespace_ + "/" + key].assign(bytes, bytes + len);
+    return len;
+}
+
+size_t Preferences::getBytesLength(const char* key)
+{
+    auto it = nvsEntries.find(namespace_ + "/" + key);
+    return open_ && it != nvsEntries.end() ? it->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen)
+{
+    auto it = nvsEntries.find(namespace_ + "/" + key);
+    if (!open_ || it == nvsEntries.end() || it->second.size() > maxLen) {
+        return 0;
+    }
+
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+namespace sim {
+
+void setMac(const uint8_t mac[6])
+{
+    memcpy(simMac, mac, sizeof(simMac));
+}
+
+size_t flashUsage()
+{
+    size_t bytes = 0;
+    for (const auto& file : flashFiles) {
+        bytes += file.second.size();
+    }
+
+    return bytes;
+}
+
+} // namespace sim
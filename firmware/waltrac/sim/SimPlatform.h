@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Knobs of the simulated ESP32 that the firmware has no API for.
+
+namespace sim {
+
+// MAC address esp_read_mac() reports.
+void setMac(const uint8_t mac[6]);
+
+// Bytes stored in the simulated LittleFS.
+size_t flashUsage();
+
+} // namespace sim
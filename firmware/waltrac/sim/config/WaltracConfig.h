@@ -0,0 +1,31 @@
+#pragma once
+
+// Tracker configuration of the simulator. Every value can be overridden with WALTRAC_SIM_DEFINES.
+
+#ifndef WT_SERVER_HOST
+#define WT_SERVER_HOST "waltrac.sim"
+#endif
+
+#ifndef WT_SERVER_PORT
+#define WT_SERVER_PORT 1999
+#endif
+
+#ifndef WT_CFG_INTERVAL
+#define WT_CFG_INTERVAL 10
+#endif
+
+#ifndef WT_CFG_BATCH_SIZE
+#define WT_CFG_BATCH_SIZE 1
+#endif
+
+#ifndef WT_CFG_BATCH_COMPACT
+#define WT_CFG_BATCH_COMPACT 1
+#endif
+
+#ifndef WT_CFG_NAME
+#define WT_CFG_NAME "Simulator"
+#endif
+
+#ifndef WT_CFG_SECRET
+#define WT_CFG_SECRET "SimulatorSecret"
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+// Arduino core for the simulator, on the virtual clock of sim::Kernel.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "HardwareSerial.h"
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+class EspClass {
+public:
+    [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Serial ports of the simulator, the log goes to stdout anyway.
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void flush() {}
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
+
+#include "Arduino.h"
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// LittleFS for the simulator, files live in memory and survive simulated restarts like flash.
+
+class File {
+public:
+    File() = default;
+    File(const std::string& path, bool directory, size_t position) : path_(path), directory_(directory), open_(true), position_(position) { setName(); }
+
+    explicit operator bool() const { return open_; }
+
+    size_t read(uint8_t* buffer, size_t len);
+    size_t write(const uint8_t* buffer, size_t len);
+    size_t size() const;
+    bool seek(uint32_t position);
+    void close() { open_ = false; }
+    const char* name() const { return name_.c_str(); }
+    File openNextFile();
+
+private:
+    void setName();
+
+    std::string path_;
+    std::string name_;
+    bool directory_ = false;
+    bool open_ = false;
+    size_t position_ = 0;               // read/write position, or the next entry of a directory
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false);
+    bool exists(const char* path);
+    bool mkdir(const char* path);
+    bool remove(const char* path);
+    File open(const char* path, const char* mode = "r");
+};
+
+extern LittleFSFS LittleFS;
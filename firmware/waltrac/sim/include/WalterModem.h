@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+
+// The types of the Walter modem library that ModemInterface uses, for building the firmware without the library.
+// Names and values follow the library, only the members the firmware touches are declared.
+
+typedef enum {
+    WALTER_MODEM_OPSTATE_MINIMUM = 0,
+    WALTER_MODEM_OPSTATE_FULL = 1,
+    WALTER_MODEM_OPSTATE_NO_RF = 4,
+    WALTER_MODEM_OPSTATE_MANUFACTURING = 5,
+} WalterModemOpState;
+
+typedef enum {
+    WALTER_MODEM_NETWORK_REG_NOT_SEARCHING = 0,
+    WALTER_MODEM_NETWORK_REG_REGISTERED_HOME = 1,
+    WALTER_MODEM_NETWORK_REG_SEARCHING = 2,
+    WALTER_MODEM_NETWORK_REG_DENIED = 3,
+    WALTER_MODEM_NETWORK_REG_UNKNOWN = 4,
+    WALTER_MODEM_NETWORK_REG_REGISTERED_ROAMING = 5,
+} WalterModemNetworkRegState;
+
+typedef enum {
+    WALTER_MODEM_NETWORK_SEL_MODE_AUTOMATIC = 0,
+    WALTER_MODEM_NETWORK_SEL_MODE_MANUAL = 1,
+    WALTER_MODEM_NETWORK_SEL_MODE_UNREGISTER = 2,
+} WalterModemNetworkSelMode;
+
+typedef enum {
+    WALTER_MODEM_PSM_DISABLE = 0,
+    WALTER_MODEM_PSM_ENABLE = 1,
+    WALTER_MODEM_PSM_RESET = 2,
+} WalterModemPSMMode;
+
+typedef enum {
+    WALTER_MODEM_GNSS_SENS_MODE_LOW = 1,
+    WALTER_MODEM_GNSS_SENS_MODE_MEDIUM = 2,
+    WALTER_MODEM_GNSS_SENS_MODE_HIGH = 3,
+} WalterModemGNSSSensMode;
+
+typedef enum {
+    WALTER_MODEM_GNSS_ACQ_MODE_COLD_WARM_START = 0,
+    WALTER_MODEM_GNSS_ACQ_MODE_HOT_START = 1,
+} WalterModemGNSSAcqMode;
+
+typedef enum {
+    WALTER_MODEM_GNSS_ACTION_GET_SINGLE_FIX = 0,
+    WALTER_MODEM_GNSS_ACTION_CANCEL = 1,
+} WalterModemGNSSAction;
+
+typedef enum {
+    WALTER_MODEM_GNSS_ASSISTANCE_TYPE_ALMANAC = 0,
+    WALTER_MODEM_GNSS_ASSISTANCE_TYPE_REALTIME_EPHEMERIS = 1,
+    WALTER_MODEM_GNSS_ASSISTANCE_TYPE_PREDICTED_EPHEMERIS = 2,
+} WalterModemGNSSAssistanceType;
+
+typedef enum {
+    WALTER_MODEM_COAP_EVENT_CONNECTED,
+    WALTER_MODEM_COAP_EVENT_DISCONNECTED,
+    WALTER_MODEM_COAP_EVENT_RING,
+} WalterModemCoapEvent;
+
+typedef enum {
+    WALTER_MODEM_COAP_OPT_SET = 0,
+    WALTER_MODEM_COAP_OPT_DELETE = 1,
+    WALTER_MODEM_COAP_OPT_READ = 2,
+    WALTER_MODEM_COAP_OPT_EXTEND = 3,
+} WalterModemCoapOptionAction;
+
+typedef enum {
+    WALTER_MODEM_COAP_OPT_CODE_OBSERVE = 6,
+    WALTER_MODEM_COAP_OPT_CODE_URI_PATH = 11,
+    WALTER_MODEM_COAP_OPT_CODE_TOKEN = 255,
+} WalterModemCoapOptionCode;
+
+typedef enum {
+    WALTER_MODEM_COAP_SEND_TYPE_CON = 0,
+    WALTER_MODEM_COAP_SEND_TYPE_NON = 1,
+    WALTER_MODEM_COAP_SEND_TYPE_ACK = 2,
+    WALTER_MODEM_COAP_SEND_TYPE_RST = 3,
+} WalterModemCoapSendType;
+
+typedef enum {
+    WALTER_MODEM_COAP_SEND_METHOD_NONE = 0,
+    WALTER_MODEM_COAP_SEND_METHOD_GET = 1,
+    WALTER_MODEM_COAP_SEND_METHOD_POST = 2,
+    WALTER_MODEM_COAP_SEND_METHOD_PUT = 3,
+    WALTER_MODEM_COAP_SEND_METHOD_DELETE = 4,
+} WalterModemCoapSendMethodRsp;
+
+typedef enum {
+    WALTER_MODEM_RSP_DATA_TYPE_NO_DATA,
+    WALTER_MODEM_RSP_DATA_TYPE_CLOCK,
+    WALTER_MODEM_RSP_DATA_TYPE_GNSS_ASSISTANCE_DATA,
+    WALTER_MODEM_RSP_DATA_TYPE_COAP,
+} WalterModemRspDataType;
+
+typedef struct {
+    uint8_t satNo;
+    uint8_t signalStrength;
+} WalterModemGNSSSat;
+
+typedef struct {
+    uint8_t fixId;
+    int64_t timestamp;
+    uint32_t timeToFix;
+    double estimatedConfidence;
+    double latitude;
+    double longitude;
+    double height;
+    double northSpeed;
+    double eastSpeed;
+    double downSpeed;
+    uint8_t satCount;
+    WalterModemGNSSSat sats[32];
+} WalterModemGNSSFix;
+
+typedef struct {
+    bool available;
+    int lastUpdate;
+    int timeToUpdate;
+    int timeToExpire;
+} WalterModemGNSSAssistanceTypeDetails;
+
+typedef struct {
+    WalterModemRspDataType type;
+    struct {
+        struct {
+            int64_t epochTime;
+        } clock;
+        struct {
+            WalterModemGNSSAssistanceTypeDetails almanac;
+            WalterModemGNSSAssistanceTypeDetails realtimeEphemeris;
+            WalterModemGNSSAssistanceTypeDetails predictedEphemeris;
+        } gnssAssistance;
+        struct {
+            int profileId;
+            int messageId;
+            uint16_t length;
+        } coapResponse;
+    } data;
+} WalterModemRsp;
@@ -0,0 +1,7 @@
+#pragma once
+
+// The firmware is loaded afresh on every simulated boot, only this section is carried over a deep sleep.
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+
+// Carried over every boot but the first, like RTC memory that is not initialized by the bootloader.
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))
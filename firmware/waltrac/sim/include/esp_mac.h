@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+} esp_mac_type_t;
+
+typedef int esp_err_t;
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Microseconds since the last boot on the virtual clock.
+int64_t esp_timer_get_time();
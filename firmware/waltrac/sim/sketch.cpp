@@ -0,0 +1,37 @@
+// The firmware module: the sketch as the Arduino builder sees it, with the core header first, and the entry points
+// the simulator looks up on every boot.
+#include <Arduino.h>
+
+#include "../waltrac.ino"
+
+extern "C" {
+
+/* The linker emits the bounds of a section once any variable is placed in it */
+extern char __start_rtc_data[] __attribute__((weak));
+extern char __stop_rtc_data[] __attribute__((weak));
+extern char __start_rtc_noinit[] __attribute__((weak));
+extern char __stop_rtc_noinit[] __attribute__((weak));
+
+void simSetup()
+{
+    setup();
+}
+
+void simLoop()
+{
+    loop();
+}
+
+void simRtcMemory(char** begin, char** end)
+{
+    *begin = __start_rtc_data;
+    *end = __stop_rtc_data;
+}
+
+void simRtcNoinitMemory(char** begin, char** end)
+{
+    *begin = __start_rtc_noinit;
+    *end = __stop_rtc_noinit;
+}
+
+}
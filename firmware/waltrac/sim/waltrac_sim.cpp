@@ -0,0 +1,226 @@
+#include <esp_log.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "ModemSimulator.h"
+#include "SimFirmware.h"
+#include "SimKernel.h"
+#include "SimPlatform.h"
+
+// waltrac_sim - runs the unmodified tracker firmware against the modem model
+// on virtual time and reports what a real deployment would care about: how
+// long the ESP32 is awake, the charge drawn from the battery and how fresh
+// the positions are when they reach the server.
+
+static sim::ModemSimulator simulator;
+
+ModemInterface& modem = simulator;
+
+static void usage(const char* program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  --hours H            simulated time, default 24\n");
+    printf("  --seed N             seed of all random draws, default 1\n");
+    printf("  --loss P             chance that one CoAP transmission is lost, default 0\n");
+    printf("  --fix-failure P      chance that a GNSS fix never arrives, default 0.02\n");
+    printf("  --hot-fix MIN:MAX    hot start time to fix in seconds, default 2:6\n");
+    printf("  --cold-fix MIN:MAX   cold start time to fix in seconds, default 25:45\n");
+    printf("  --attach MIN:MAX     LTE attach time in seconds, default 2:8\n");
+    printf("  --no-nitz            the network does not set the clock\n");
+    printf("  --no-session         the server does not assign a session\n");
+    printf("  --set-interval S@H   the operator sets the interval to S seconds after H hours\n");
+    printf("  --battery MAH        battery capacity for the lifetime estimate, default 2000\n");
+    printf("  --log LEVEL          none, error, warn, info, debug or verbose, default warn\n");
+}
+
+static bool parseRange(const char* arg, int64_t& min, int64_t& max)
+{
+    double low = 0;
+    double high = 0;
+    if (sscanf(arg, "%lf:%lf", &low, &high) != 2 || low < 0 || high < low) {
+        return false;
+    }
+
+    min = (int64_t)(low * 1000000);
+    max = (int64_t)(high * 1000000);
+    return true;
+}
+
+static bool parseLevel(const char* arg, esp_log_level_t& level)
+{
+    static const char* const names[] = {"none", "error", "warn", "info", "debug", "verbose"};
+    for (int i = 0; i < 6; i++) {
+        if (strcmp(arg, names[i]) == 0) {
+            level = (esp_log_level_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static double hoursOf(int64_t micros)
+{
+    return micros / 3600e6;
+}
+
+static double milliAmpHours(double charge)
+{
+    return charge / 3600e6;
+}
+
+int main(int argc, char** argv)
+{
+    sim::ModemSimulator::Config config;
+    double hours = 24;
+    double battery = 2000;
+    esp_log_level_t level = ESP_LOG_WARN;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (option == "--help" || option == "-h") {
+            usage(argv[0]);
+            return 0;
+        } else if (option == "--no-nitz") {
+            config.nitz = false;
+            continue;
+        } else if (option == "--no-session") {
+            config.assignSession = false;
+            continue;
+        } else if (value == nullptr) {
+            ok = false;
+        } else if (option == "--hours") {
+            hours = atof(value);
+            ok = hours > 0;
+        } else if (option == "--seed") {
+            config.seed = strtoul(value, nullptr, 10);
+        } else if (option == "--loss") {
+            config.packetLoss = atof(value);
+            ok = config.packetLoss >= 0 && config.packetLoss <= 1;
+        } else if (option == "--fix-failure") {
+            config.fixFailure = atof(value);
+            ok = config.fixFailure >= 0 && config.fixFailure <= 1;
+        } else if (option == "--hot-fix") {
+            ok = parseRange(value, config.hotFixMinMicros, config.hotFixMaxMicros);
+        } else if (option == "--cold-fix") {
+            ok = parseRange(value, config.coldFixMinMicros, config.coldFixMaxMicros);
+        } else if (option == "--attach") {
+            ok = parseRange(value, config.attachMinMicros, config.attachMaxMicros);
+        } else if (option == "--set-interval") {
+            unsigned seconds = 0;
+            double after = 0;
+            ok = sscanf(value, "%u@%lf", &seconds, &after) == 2 && seconds > 0 && after >= 0;
+            config.serverInterval = seconds;
+            config.serverIntervalAtMicros = (int64_t)(after * 3600e6);
+        } else if (option == "--battery") {
+            battery = atof(value);
+            ok = battery > 0;
+        } else if (option == "--log") {
+            ok = parseLevel(value, level);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Invalid option %s\n", option.c_str());
+            usage(argv[0]);
+            return 1;
+        }
+
+        i++;
+    }
+
+    esp_log_level_set("*", level);
+    simulator.configure(config);
+
+    /* Every boot loads a fresh firmware image and starts the Arduino loop task, which runs setup() once and then loop() */
+    sim::Kernel& kernel = sim::Kernel::instance();
+    sim::Firmware firmware(WALTRAC_SIM_FIRMWARE);
+    bool loaded = true;
+
+    kernel.onBoot([&kernel, &firmware, &loaded]() {
+        simulator.boot();
+
+        if (!firmware.boot(kernel.wokeFromSleep())) {
+            loaded = false;
+            return;
+        }
+
+        kernel.createTask("loopTask", 1, [&firmware]() {
+            firmware.setup();
+            for (;;) {
+                firmware.loop();
+            }
+        });
+    });
+
+    int64_t duration = (int64_t)(hours * 3600e6);
+    kernel.run(duration);
+    simulator.finish();
+
+    if (!loaded) {
+        fprintf(stderr, "Could not load the firmware: %s\n", firmware.error().c_str());
+        return 1;
+    }
+
+    const sim::ModemSimulator::Stats& stats = simulator.stats();
+    int64_t elapsed = kernel.now();
+
+    double total = stats.espAwakeCharge + stats.espSleepCharge + stats.lteCharge + stats.gnssCharge + stats.modemIdleCharge;
+    double averageCurrent = elapsed > 0 ? total / elapsed : 0;
+    double latency = stats.latencySamples > 0 ? stats.latencyTotalMicros / 1e6 / stats.latencySamples : 0;
+
+    printf("\n");
+    printf("Simulated %.2fh, seed %u, packet loss %.1f%%\n", hoursOf(elapsed), (unsigned)config.seed, config.packetLoss * 100);
+    printf("\n");
+    printf("ESP32 awake        %.2fh (%.1f%% duty cycle), %u deep sleeps, %u resets\n", hoursOf(stats.espAwakeMicros), elapsed > 0 ? 100.0 * stats.espAwakeMicros / elapsed : 0, (unsigned)kernel.sleeps(), (unsigned)kernel.resets());
+    printf("GNSS active        %.2fh, %u fixes, %u cancelled\n", hoursOf(stats.gnssMicros), (unsigned)stats.fixes, (unsigned)stats.fixesCancelled);
+    printf("LTE up             %.2fh, %u attaches, %u detaches, %u assistance downloads\n", hoursOf(stats.lteMicros), (unsigned)stats.attaches, (unsigned)stats.detaches, (unsigned)stats.assistanceUpdates);
+    printf("AT commands        %u, %u CoAP options, %u clock queries\n", (unsigned)stats.atCommands, (unsigned)stats.uriOptions, (unsigned)stats.clockQueries);
+    printf("\n");
+    printf("Uplinks            %u sent, %u transmissions, %u delivered, %u lost, %llu bytes\n", (unsigned)stats.uplinks, (unsigned)stats.transmissions, (unsigned)stats.delivered, (unsigned)stats.lost, (unsigned long long)stats.bytesDelivered);
+    printf("Positions          %u delivered, fix to server %.1fs mean, %.1fs max, %u searching reports\n", (unsigned)stats.positionsDelivered, latency, stats.latencyMaxMicros / 1e6, (unsigned)stats.searchingDelivered);
+    if (stats.positionsDelivered > 0) {
+        printf("Intervals          %.1fs mean, %us shortest as announced by the tracker\n", (double)stats.intervalTotal / stats.positionsDelivered, (unsigned)stats.intervalMin);
+    }
+    if (stats.sequencedFixes > 0 || stats.duplicateFixes > 0) {
+        printf("Sequenced fixes    %u new, %u repeated\n", (unsigned)stats.sequencedFixes, (unsigned)stats.duplicateFixes);
+    }
+    printf("Commands           %u pushed to the device\n", (unsigned)stats.commands);
+    printf("Backlog in flash   %u bytes\n", (unsigned)sim::flashUsage());
+
+    /* What the fleet dashboard would see, summed over the telemetry frames of the run */
+    if (stats.telemetryFrames > 0) {
+        const Messages::Telemetry& telemetry = stats.telemetry;
+
+        printf("\n");
+        printf("Telemetry          %u frames over %.2fh, %.2fh awake\n", (unsigned)stats.telemetryFrames, telemetry.window / 3600.0, telemetry.awake / 3600.0);
+        printf("  Counters         %u restarts, %u crashes, %u GNSS retries, %u GNSS timeouts, %u attach failures, %u send failures\n", telemetry.restarts, telemetry.crashes, telemetry.gnssRetries, telemetry.gnssTimeouts, telemetry.attachFailures, telemetry.sendFailures);
+        printf("  %-16s %7s %9s %9s %9s  %s\n", "Phase", "Samples", "Mean", "Max", "Charge", "Histogram (<125ms, <250ms, ... >=32s)");
+        for (uint8_t i = 0; i < telemetry.count; i++) {
+            const Messages::Telemetry::Phase& phase = telemetry.phases[i];
+
+            printf("  %-16s %7u %8.2fs %8.2fs %7.2fmAh ", Messages::telemetryPhaseName((Messages::TelemetryPhase)i), phase.samples, phase.samples > 0 ? phase.totalMillis / 1000.0 / phase.samples : 0, phase.maxMillis / 1000.0, phase.charge / 1000.0);
+            for (uint8_t b = 0; b < Messages::Telemetry::BUCKETS; b++) {
+                printf(" %u", phase.buckets[b]);
+            }
+            printf("\n");
+        }
+    }
+    printf("\n");
+    printf("Charge             %.2fmAh total\n", milliAmpHours(total));
+    printf("  ESP32 awake      %.2fmAh\n", milliAmpHours(stats.espAwakeCharge));
+    printf("  ESP32 asleep     %.2fmAh\n", milliAmpHours(stats.espSleepCharge));
+    printf("  LTE              %.2fmAh\n", milliAmpHours(stats.lteCharge));
+    printf("  GNSS             %.2fmAh\n", milliAmpHours(stats.gnssCharge));
+    printf("  Modem idle       %.2fmAh\n", milliAmpHours(stats.modemIdleCharge));
+    printf("Average current    %.2fmA, %.1f days on %.0fmAh\n", averageCurrent, averageCurrent > 0 ? battery / averageCurrent / 24 : 0, battery);
+
+    return 0;
+}
@@ -0,0 +1,689 @@
+// messages_test.cpp - host tests of the Messages codec
+//
+// Known answers of the SHA-256 backend and the HMAC signer, encode/decode
+// round trips of every message, the DecodeStatus of malformed frames, and the
+// bulk verification kernels against the scalar verify(). Built and registered
+// with ctest by the root CMakeLists.txt:
+//
+//   cmake -S . -B build && cmake --build build && ctest --test-dir build
+//
+// Prints every failed check and exits with 1 if there was any.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BatchVerifier.h"
+#include "MessageSchema.h"
+#include "Messages.h"
+
+using namespace Messages;
+
+static const char* KEY = "test-secret";
+
+static unsigned failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+static bool check(bool ok, const char* what, const char* file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        failures++;
+    }
+
+    return ok;
+}
+
+static std::vector<uint8_t> fromHex(const char* hex) {
+    std::vector<uint8_t> out;
+    for (size_t i = 0; hex[i] != '\0' && hex[i + 1] != '\0'; i += 2) {
+        unsigned byte = 0;
+        sscanf(hex + i, "%2x", &byte);
+        out.push_back(static_cast<uint8_t>(byte));
+    }
+
+    return out;
+}
+
+static std::vector<uint8_t> bytes(const char* text) {
+    return std::vector<uint8_t>(text, text + strlen(text));
+}
+
+// Scaled coordinates survive the wire exactly, doubles only up to the scale.
+static bool sameCoordinate(double a, double b) {
+    return std::fabs(a - b) < 0.5 / Position::SCALE;
+}
+
+// --- SHA-256 and HMAC known answers ------------------------------------------
+
+static void testSha256() {
+    struct Vector {
+        std::vector<uint8_t> message;
+        const char* digest;
+    };
+
+    const Vector vectors[] = {
+        {bytes(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {bytes("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {bytes("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {std::vector<uint8_t>(1000000, 'a'), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+    };
+
+    for (const Vector& vector : vectors) {
+        // in uneven pieces, so the buffering across block boundaries is exercised
+        Sha256 sha;
+        CHECK(sha.setup() && sha.starts());
+        for (size_t offset = 0, piece = 1; offset < vector.message.size(); offset += piece, piece = piece * 3 % 127 + 1) {
+            CHECK(sha.update(vector.message.data() + offset, std::min(piece, vector.message.size() - offset)));
+        }
+
+        uint8_t digest[Sha256::DIGEST_SIZE];
+        CHECK(sha.finish(digest));
+        CHECK(std::vector<uint8_t>(digest, digest + sizeof(digest)) == fromHex(vector.digest));
+    }
+
+    // resuming from a copied state gives the same digest as hashing in one go
+    const std::vector<uint8_t> message(200, 0x5a);
+    Sha256 prefix;
+    Sha256 resumed;
+    CHECK(prefix.setup() && prefix.starts() && prefix.update(message.data(), 70));
+    CHECK(resumed.setup() && resumed.copyFrom(prefix) && resumed.update(message.data() + 70, message.size() - 70));
+
+    Sha256 whole;
+    CHECK(whole.setup() && whole.starts() && whole.update(message.data(), message.size()));
+
+    uint8_t a[Sha256::DIGEST_SIZE];
+    uint8_t b[Sha256::DIGEST_SIZE];
+    CHECK(resumed.finish(a) && whole.finish(b) && memcmp(a, b, sizeof(a)) == 0);
+}
+
+// RFC 4231, the signer sends the leading 16 bytes of HMAC-SHA256.
+static void testHmac() {
+    struct Vector {
+        std::vector<uint8_t> key;
+        std::vector<uint8_t> data;
+        const char* mac;
+    };
+
+    std::vector<uint8_t> counting;
+    for (uint8_t i = 1; i <= 25; ++i) {
+        counting.push_back(i);
+    }
+
+    const Vector vectors[] = {
+        {std::vector<uint8_t>(20, 0x0b), bytes("Hi There"), "b0344c61d8db38535ca8afceaf0bf12b"},
+        {bytes("Jefe"), bytes("what do ya want for nothing?"), "5bdcc146bf60754e6a042426089575c7"},
+        {std::vector<uint8_t>(20, 0xaa), std::vector<uint8_t>(50, 0xdd), "773ea91e36800e46854db8ebd09181a7"},
+        {counting, std::vector<uint8_t>(50, 0xcd), "82558a389a443c0ea4cc819899f2083a"},
+        {std::vector<uint8_t>(20, 0x0c), bytes("Test With Truncation"), "a3b6167473100ee06e0c796c2955552b"},
+        {std::vector<uint8_t>(131, 0xaa), bytes("Test Using Larger Than Block-Size Key - Hash Key First"), "60e431591ee0b67f0d8a26aacbf5b77f"},
+        {std::vector<uint8_t>(131, 0xaa),
+         bytes("This is a test using a larger than block-size key and a larger than block-size data. The key needs to be hashed before being used by the HMAC algorithm."),
+         "9b09ffa71b942fcb27635fbcd5b0e944"},
+    };
+
+    for (const Vector& vector : vectors) {
+        Signer signer(vector.key.data(), vector.key.size());
+        CHECK(signer.hasKey());
+
+        // twice, signing must not disturb the cached key schedule
+        for (int round = 0; round < 2; ++round) {
+            uint8_t mac[16];
+            CHECK(signer.sign(vector.data.data(), vector.data.size(), mac));
+            CHECK(std::vector<uint8_t>(mac, mac + sizeof(mac)) == fromHex(vector.mac));
+        }
+    }
+
+    Signer empty;
+    uint8_t mac[16];
+    CHECK(!empty.hasKey());
+    CHECK(!empty.sign(mac, 0, mac));
+}
+
+// The const char* key overloads cache the last key, switching keys must not mix them up.
+static void testKeyCache() {
+    const std::string longKey(100, 'x');
+    const char* keys[] = {"first", "second", "", "first", longKey.c_str(), "second"};
+
+    Position position;
+    position.setHeader(true);
+    position.name = "cache";
+
+    for (const char* key : keys) {
+        const Signer signer(key);
+
+        uint8_t keyed[Position::MAX_SIZE];
+        uint8_t withSigner[Position::MAX_SIZE];
+        const size_t len = position.serialize(keyed, sizeof(keyed), key);
+        CHECK(len > 0 && position.serialize(withSigner, sizeof(withSigner), signer) == len && memcmp(keyed, withSigner, len) == 0);
+
+        Position decoded;
+        CHECK(Position::decode(keyed, len, decoded) == DECODE_STATUS_OK);
+        CHECK(decoded.verify(key));
+        CHECK(!decoded.verify(strcmp(key, "first") == 0 ? "second" : "first"));
+    }
+
+    CHECK(position.serialize(nullptr, 0, "first") == 0);
+    CHECK(!position.verify(static_cast<const char*>(nullptr)));
+}
+
+// --- Round trips ---------------------------------------------------------------
+
+static Position makePosition(size_t namelen) {
+    Position p;
+    p.setHeader(true);
+    p.interval = 30;
+    p.confidence = 12;
+    p.satellites = 9;
+    for (size_t i = 0; i < 6; ++i) {
+        p.device[i] = static_cast<uint8_t>(0xA0 + i);
+    }
+    p.latitude = -33.8567844;
+    p.longitude = 151.2152967;
+    p.name.assign(namelen, 'n');
+
+    return p;
+}
+
+static PositionBatch makeBatch(bool compact, bool sequenced, uint16_t sequence, uint8_t count) {
+    PositionBatch batch;
+    batch.setHeader(true, compact, sequenced);
+    batch.interval = 10;
+    for (size_t i = 0; i < 6; ++i) {
+        batch.device[i] = static_cast<uint8_t>(0x10 + i);
+    }
+    batch.sequence = sequence;
+    batch.name = "walter";
+
+    for (uint8_t i = 0; i < count; ++i) {
+        PositionBatch::Fix fix;
+        fix.age = static_cast<uint16_t>((count - i) * 10);
+        fix.confidence = i;
+        fix.satellites = static_cast<uint8_t>(4 + i);
+        fix.latitude = 51.0 + i * 0.0001234;
+        fix.longitude = 4.0 - i * 0.0004321;
+        batch.addFix(fix);
+    }
+
+    return batch;
+}
+
+static void checkSameBatch(const PositionBatch& a, const PositionBatch& b) {
+    CHECK(a.header == b.header);
+    CHECK(a.interval == b.interval);
+    CHECK(memcmp(a.device, b.device, sizeof(a.device)) == 0);
+    CHECK(!a.sequenced() || a.sequence == b.sequence);
+    CHECK(a.name == b.name);
+
+    if (!CHECK(a.count == b.count)) {
+        return;
+    }
+
+    for (size_t i = 0; i < a.count; ++i) {
+        CHECK(a.fixes[i].age == b.fixes[i].age);
+        CHECK(a.fixes[i].confidence == b.fixes[i].confidence);
+        CHECK(a.fixes[i].satellites == b.fixes[i].satellites);
+        CHECK(sameCoordinate(a.fixes[i].latitude, b.fixes[i].latitude));
+        CHECK(sameCoordinate(a.fixes[i].longitude, b.fixes[i].longitude));
+    }
+}
+
+// Serialize, decode and serialize again, which has to give the same bytes.
+static void roundTripBatch(const PositionBatch& batch, const Signer& signer) {
+    PositionBatch source = batch;
+
+    uint8_t frame[PositionBatch::MAX_SIZE];
+    const size_t len = source.serialize(frame, sizeof(frame), signer);
+    if (!CHECK(len > 0 && len == source.serializedSize())) {
+        return;
+    }
+
+    PositionBatch decoded;
+    CHECK(PositionBatch::decode(frame, len, decoded) == DECODE_STATUS_OK);
+    CHECK(decoded.verify(signer));
+    checkSameBatch(source, decoded);
+
+    uint8_t again[PositionBatch::MAX_SIZE];
+    CHECK(decoded.serialize(again, sizeof(again), signer) == len && memcmp(frame, again, len) == 0);
+
+    // the view only takes batches without sequence
+    PositionBatchView view;
+    if (batch.sequenced()) {
+        CHECK(view.decode(frame, len, signer) == DECODE_STATUS_BAD_HEADER);
+        return;
+    }
+
+    if (!CHECK(view.decode(frame, len, signer) == DECODE_STATUS_OK && view.count() == batch.count)) {
+        return;
+    }
+
+    CHECK(view.name() == batch.name);
+    for (size_t i = 0; i < view.count(); ++i) {
+        const PositionBatch::Fix fix = view.fix(i);
+        CHECK(fix.age == batch.fixes[i].age);
+        CHECK(sameCoordinate(fix.latitude, batch.fixes[i].latitude));
+        CHECK(sameCoordinate(fix.longitude, batch.fixes[i].longitude));
+    }
+}
+
+static void testPosition(const Signer& signer) {
+    for (size_t namelen : {0, 1, 36, 37, 100, 255}) {
+        Position position = makePosition(namelen);
+
+        uint8_t frame[Position::MAX_SIZE];
+        const size_t len = position.serialize(frame, sizeof(frame), signer);
+        if (!CHECK(len == position.serializedSize())) {
+            continue;
+        }
+
+        Position decoded;
+        CHECK(Position::decode(frame, len, decoded) == DECODE_STATUS_OK);
+        CHECK(decoded.verify(signer));
+        CHECK(decoded.verify(KEY));
+        CHECK(decoded.header == position.header && decoded.interval == position.interval);
+        CHECK(decoded.confidence == position.confidence && decoded.satellites == position.satellites);
+        CHECK(memcmp(decoded.device, position.device, sizeof(position.device)) == 0);
+        CHECK(sameCoordinate(decoded.latitude, position.latitude) && sameCoordinate(decoded.longitude, position.longitude));
+        CHECK(decoded.name == position.name);
+
+        PositionView view;
+        CHECK(view.decode(frame, len, signer) == DECODE_STATUS_OK);
+        CHECK(view.name() == position.name);
+        CHECK(view.latitudeRaw() == static_cast<int32_t>(std::round(position.latitude * Position::SCALE)));
+
+        // the key overloads sign like the cached key schedule
+        uint8_t keyed[Position::MAX_SIZE];
+        CHECK(position.serialize(keyed, sizeof(keyed), KEY) == len && memcmp(frame, keyed, len) == 0);
+    }
+
+    // names beyond the one byte length do not encode
+    Position tooLong = makePosition(256);
+    uint8_t frame[Position::MAX_SIZE + 1];
+    CHECK(tooLong.serialize(frame, sizeof(frame), signer) == 0);
+
+    // extremes of the scaled coordinates
+    Position corner = makePosition(0);
+    corner.latitude = -90.0;
+    corner.longitude = 180.0;
+    const size_t len = corner.serialize(frame, sizeof(frame), signer);
+    Position decoded;
+    CHECK(Position::decode(frame, len, decoded) == DECODE_STATUS_OK);
+    CHECK(decoded.latitude == -90.0 && decoded.longitude == 180.0);
+}
+
+static void testSessionPosition(const Signer& signer) {
+    SessionPosition position;
+    position.setHeader(true);
+    position.interval = 60;
+    position.confidence = 3;
+    position.satellites = 11;
+    position.session = 0xBEEF;
+    position.latitude = 89.9999999;
+    position.longitude = -179.9999999;
+
+    for (const char* name : {"", "tracker"}) {
+        position.name = name;
+
+        uint8_t frame[SessionPosition::MAX_SIZE];
+        const size_t len = position.serialize(frame, sizeof(frame), signer);
+
+        SessionPosition decoded;
+        CHECK(SessionPosition::decode(frame, len, decoded) == DECODE_STATUS_OK);
+        CHECK(decoded.verify(signer));
+        CHECK(decoded.session == position.session && decoded.name == position.name);
+        CHECK(sameCoordinate(decoded.latitude, position.latitude) && sameCoordinate(decoded.longitude, position.longitude));
+
+        SessionPositionView view;
+        CHECK(view.decode(frame, len, signer) == DECODE_STATUS_OK && view.session() == position.session && view.name() == position.name);
+
+        // a session frame is no plain position, the short one fails on its size already
+        PositionView plain;
+        CHECK(plain.init(frame, len) == (position.name.empty() ? DECODE_STATUS_TOO_SHORT : DECODE_STATUS_BAD_HEADER));
+    }
+}
+
+static void testPositionBatch(const Signer& signer) {
+    for (bool compact : {false, true}) {
+        for (bool sequenced : {false, true}) {
+            for (int count : {1, 2, 7, static_cast<int>(PositionBatch::MAX_FIXES)}) {
+                roundTripBatch(makeBatch(compact, sequenced, 1234, static_cast<uint8_t>(count)), signer);
+            }
+        }
+    }
+
+    // sequence numbers at and across the wrap
+    for (uint16_t sequence : {0x0000, 0x7FFF, 0x8000, 0xFFF8, 0xFFFF}) {
+        roundTripBatch(makeBatch(true, true, sequence, PositionBatch::MAX_FIXES), signer);
+    }
+
+    // compact extremes: largest varints for age and time steps and the widest coordinate jumps
+    PositionBatch extremes;
+    extremes.setHeader(true, true, true);
+    extremes.sequence = 0xFFFF;
+
+    PositionBatch::Fix fix;
+    fix.age = UINT16_MAX;
+    fix.confidence = 255;
+    fix.satellites = 255;
+    fix.latitude = -90.0;
+    fix.longitude = -180.0;
+    extremes.addFix(fix);
+
+    fix.age = 0;
+    fix.latitude = 90.0;
+    fix.longitude = 180.0;
+    extremes.addFix(fix);
+
+    fix.latitude = -90.0;
+    fix.longitude = -180.0;
+    extremes.addFix(fix);
+    roundTripBatch(extremes, signer);
+
+    extremes.setHeader(true, true, false);
+    roundTripBatch(extremes, signer);
+
+    // a full batch of wide jumps with the longest name fits MAX_SIZE
+    PositionBatch worst;
+    worst.setHeader(true, true, true);
+    worst.name.assign(255, 'w');
+    for (uint8_t i = 0; i < PositionBatch::MAX_FIXES; ++i) {
+        fix.age = static_cast<uint16_t>(UINT16_MAX - i * 4096);
+        fix.latitude = i % 2 ? 90.0 : -90.0;
+        fix.longitude = i % 2 ? 180.0 : -180.0;
+        worst.addFix(fix);
+    }
+    CHECK(worst.serializedSize() <= PositionBatch::MAX_SIZE);
+    roundTripBatch(worst, signer);
+
+    // compact fixes have to be oldest first, a younger fix in front does not encode
+    PositionBatch unordered = makeBatch(true, false, 0, 2);
+    std::swap(unordered.fixes[0], unordered.fixes[1]);
+    uint8_t frame[PositionBatch::MAX_SIZE];
+    CHECK(unordered.serialize(frame, sizeof(frame), signer) == 0);
+
+    // an empty batch does not encode either
+    PositionBatch empty = makeBatch(false, false, 0, 0);
+    CHECK(empty.serialize(frame, sizeof(frame), signer) == 0);
+}
+
+static void testCommand(const Signer& signer) {
+    const CommandAction actions[] = {
+        COMMAND_ACTION_DISCOVER, COMMAND_ACTION_SETINTERVAL, COMMAND_ACTION_SETNAME,
+        COMMAND_ACTION_EXIT, COMMAND_ACTION_SETSESSION, COMMAND_ACTION_ACK,
+    };
+
+    for (CommandAction action : actions) {
+        for (size_t arglen : {0, 5, 255}) {
+            Command command;
+            command.setHeader(action);
+            command.arg.assign(arglen, 'a');
+
+            uint8_t frame[Command::MAX_SIZE];
+            const size_t len = command.serialize(frame, sizeof(frame), signer);
+
+            Command decoded;
+            CHECK(Command::decode(frame, len, decoded) == DECODE_STATUS_OK);
+            CHECK(decoded.verify(signer));
+            CHECK(decoded.arg == command.arg);
+
+            CommandAction decodedAction;
+            decoded.getHeader(decodedAction);
+            CHECK(decodedAction == action);
+
+            CommandView view;
+            CHECK(view.decode(frame, len, signer) == DECODE_STATUS_OK);
+            view.getHeader(decodedAction);
+            CHECK(decodedAction == action && view.arg() == command.arg);
+        }
+    }
+
+    // one beyond the last action is not a command
+    Command command;
+    command.header = 0x80 | (COMMAND_ACTION_ACK + 1);
+    uint8_t frame[Command::MAX_SIZE];
+    const size_t len = command.serialize(frame, sizeof(frame), signer);
+    CommandView view;
+    CHECK(view.init(frame, len) == DECODE_STATUS_BAD_HEADER);
+}
+
+static void testTelemetry(const Signer& signer) {
+    Telemetry telemetry;
+    telemetry.setHeader();
+    for (size_t i = 0; i < 6; ++i) {
+        telemetry.device[i] = static_cast<uint8_t>(i);
+    }
+    telemetry.window = 6 * 3600;
+    telemetry.awake = 1234;
+    telemetry.restarts = 1;
+    telemetry.crashes = 2;
+    telemetry.gnssRetries = 3;
+    telemetry.gnssTimeouts = 4;
+    telemetry.attachFailures = 5;
+    telemetry.sendFailures = UINT16_MAX;
+    telemetry.count = TELEMETRY_PHASE_COUNT;
+    for (uint8_t i = 0; i < telemetry.count; ++i) {
+        Telemetry::Phase& phase = telemetry.phases[i];
+        phase.samples = static_cast<uint16_t>(100 + i);
+        phase.totalMillis = 1000000u * i;
+        phase.maxMillis = UINT32_MAX - i;
+        phase.charge = 42u * i;
+        for (uint8_t b = 0; b < Telemetry::BUCKETS; ++b) {
+            phase.buckets[b] = static_cast<uint16_t>(b * i);
+        }
+    }
+
+    uint8_t frame[Telemetry::MAX_SIZE];
+    const size_t len = telemetry.serialize(frame, sizeof(frame), signer);
+
+    Telemetry decoded;
+    CHECK(Telemetry::decode(frame, len, decoded) == DECODE_STATUS_OK);
+    CHECK(decoded.verify(signer));
+    CHECK(decoded.window == telemetry.window && decoded.awake == telemetry.awake && decoded.sendFailures == telemetry.sendFailures);
+
+    if (CHECK(decoded.count == telemetry.count)) {
+        for (uint8_t i = 0; i < decoded.count; ++i) {
+            CHECK(memcmp(&decoded.phases[i].buckets, &telemetry.phases[i].buckets, sizeof(telemetry.phases[i].buckets)) == 0);
+            CHECK(decoded.phases[i].samples == telemetry.phases[i].samples && decoded.phases[i].maxMillis == telemetry.phases[i].maxMillis);
+        }
+    }
+}
+
+// --- Malformed frames ----------------------------------------------------------
+
+// Every prefix of a frame fails with TOO_SHORT below the fixed part plus the
+// HMAC and with BAD_LENGTH above, one extra byte gives TRAILING_BYTES, and a
+// missing marker bit BAD_HEADER. A flipped bit anywhere keeps the frame
+// parseable but no longer verifies.
+template<typename Message, typename Schema>
+static void checkMalformed(const char* what, const std::vector<uint8_t>& frame, const Signer& signer) {
+    const size_t fixedLen = Schema::min_size + Payload::HMAC_SIZE;
+    Message out;
+
+    CHECK(Message::decode(frame.data(), frame.size(), out) == DECODE_STATUS_OK);
+    CHECK(Message::decode(nullptr, frame.size(), out) == DECODE_STATUS_TOO_SHORT);
+
+    for (size_t len = 0; len < frame.size(); ++len) {
+        const DecodeStatus expected = len < fixedLen ? DECODE_STATUS_TOO_SHORT : DECODE_STATUS_BAD_LENGTH;
+        const DecodeStatus status = Message::decode(frame.data(), len, out);
+        if (status != expected) {
+            fprintf(stderr, "%s truncated to %zu of %zu bytes: %s, expected %s\n", what, len, frame.size(), decodeStatusName(status), decodeStatusName(expected));
+            failures++;
+        }
+    }
+
+    std::vector<uint8_t> trailing = frame;
+    trailing.push_back(0);
+    CHECK(Message::decode(trailing.data(), trailing.size(), out) == DECODE_STATUS_TRAILING_BYTES);
+
+    std::vector<uint8_t> unmarked = frame;
+    unmarked[0] &= ~0x80;
+    CHECK(Message::decode(unmarked.data(), unmarked.size(), out) == DECODE_STATUS_BAD_HEADER);
+
+    for (size_t i = 1; i < frame.size(); ++i) {
+        std::vector<uint8_t> tampered = frame;
+        tampered[i] ^= 0x01;
+        if (Message::decode(tampered.data(), tampered.size(), out) == DECODE_STATUS_OK && out.verify(signer)) {
+            fprintf(stderr, "%s verifies with byte %zu flipped\n", what, i);
+            failures++;
+        }
+    }
+}
+
+template<typename Message>
+static std::vector<uint8_t> frameOf(Message message, const Signer& signer) {
+    std::vector<uint8_t> frame(message.serializedSize());
+    frame.resize(message.serialize(frame.data(), frame.size(), signer));
+    return frame;
+}
+
+static void testMalformed(const Signer& signer) {
+    checkMalformed<Position, PositionSchema>("position", frameOf(makePosition(5), signer), signer);
+
+    SessionPosition session;
+    session.setHeader(true);
+    session.name = "abc";
+    checkMalformed<SessionPosition, SessionPositionSchema>("session position", frameOf(session, signer), signer);
+
+    checkMalformed<PositionBatch, PositionBatchSchema>("batch", frameOf(makeBatch(false, false, 0, 3), signer), signer);
+    checkMalformed<PositionBatch, PositionBatchSchema>("compact batch", frameOf(makeBatch(true, false, 0, 3), signer), signer);
+    checkMalformed<PositionBatch, SequencedBatchSchema>("sequenced batch", frameOf(makeBatch(true, true, 0xFFFF, 3), signer), signer);
+
+    Command command;
+    command.setHeader(COMMAND_ACTION_ACK);
+    command.arg = "65535";
+    checkMalformed<Command, CommandSchema>("command", frameOf(command, signer), signer);
+
+    Telemetry telemetry;
+    telemetry.setHeader();
+    telemetry.count = 2;
+    checkMalformed<Telemetry, TelemetrySchema>("telemetry", frameOf(telemetry, signer), signer);
+
+    // a batch count of zero or beyond MAX_FIXES is a bad length
+    std::vector<uint8_t> batch = frameOf(makeBatch(false, false, 0, 1), signer);
+    PositionBatch out;
+    batch[8] = 0;
+    CHECK(PositionBatch::decode(batch.data(), batch.size(), out) == DECODE_STATUS_BAD_LENGTH);
+    batch[8] = PositionBatch::MAX_FIXES + 1;
+    CHECK(PositionBatch::decode(batch.data(), batch.size(), out) == DECODE_STATUS_BAD_LENGTH);
+
+    // the views report a wrong HMAC as BAD_MAC and stay empty
+    std::vector<uint8_t> frame = frameOf(makePosition(5), signer);
+    frame.back() ^= 0x80;
+    PositionView view;
+    CHECK(view.decode(frame.data(), frame.size(), signer) == DECODE_STATUS_BAD_MAC && !view.valid());
+
+    Signer other("other-secret");
+    frame = frameOf(command, signer);
+    CommandView commandView;
+    CHECK(commandView.decode(frame.data(), frame.size(), other) == DECODE_STATUS_BAD_MAC && !commandView.valid());
+    CHECK(commandView.decode(frame.data(), frame.size(), signer) == DECODE_STATUS_OK);
+
+    for (DecodeStatus status : {DECODE_STATUS_OK, DECODE_STATUS_TOO_SHORT, DECODE_STATUS_BAD_LENGTH, DECODE_STATUS_TRAILING_BYTES, DECODE_STATUS_BAD_HEADER, DECODE_STATUS_BAD_MAC}) {
+        CHECK(strcmp(decodeStatusName(status), "unknown") != 0);
+    }
+}
+
+// --- Bulk verification ---------------------------------------------------------
+
+// Every kernel has to agree with the scalar verify(), frame by frame, for
+// intact frames, wrong HMACs, changed fields and empty views, in batches that
+// do not fill the last chunk.
+static void checkKernels(const char* key, size_t keylen) {
+    Signer signer(reinterpret_cast<const uint8_t*>(key), keylen);
+
+    const size_t COUNT = 3 * BatchVerifier::CHUNK_SIZE + 5;
+    std::vector<std::vector<uint8_t>> frames(COUNT);
+    std::vector<PositionView> views(COUNT);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        frames[i] = frameOf(makePosition(i % 256), signer);
+
+        switch (i % 7) {
+            case 1: frames[i].back() ^= 0x01; break;                               // last HMAC byte
+            case 3: frames[i][frames[i].size() - Payload::HMAC_SIZE] ^= 0x80; break; // first HMAC byte
+            case 5: frames[i][2] ^= 0x10; break;                                    // confidence
+            default: break;
+        }
+
+        // every 11th view stays empty
+        if (i % 11 != 10) {
+            CHECK(views[i].init(frames[i].data(), frames[i].size()) == DECODE_STATUS_OK);
+        }
+    }
+
+    std::vector<char> expected(COUNT);
+    size_t expectedCount = 0;
+    for (size_t i = 0; i < COUNT; ++i) {
+        expected[i] = views[i].valid() && views[i].verify(signer);
+        expectedCount += expected[i];
+    }
+    CHECK(expectedCount > 0 && expectedCount < COUNT);
+
+    for (BatchBackend backend : {BATCH_BACKEND_GENERIC, BATCH_BACKEND_AVX2, BATCH_BACKEND_AVX512, BATCH_BACKEND_SHANI}) {
+        if (!BatchVerifier::supported(backend)) {
+            continue;
+        }
+
+        const BatchVerifier verifier(reinterpret_cast<const uint8_t*>(key), keylen, backend);
+        CHECK(verifier.backend() == backend);
+
+        bool ok[COUNT];
+        const size_t verified = verifier.verify(views.data(), views.size(), ok);
+        CHECK(verified == expectedCount);
+
+        for (size_t i = 0; i < COUNT; ++i) {
+            if (ok[i] != static_cast<bool>(expected[i])) {
+                fprintf(stderr, "%s: frame %zu (key %zu bytes, name %zu bytes) %s, scalar %s\n", BatchVerifier::backendName(backend), i, keylen, i % 256,
+                        ok[i] ? "verified" : "rejected", expected[i] ? "verified" : "rejected");
+                failures++;
+            }
+        }
+
+        // odd counts below one chunk
+        CHECK(verifier.verify(views.data(), 3, ok) == static_cast<size_t>(expected[0] + expected[1] + expected[2]));
+        CHECK(verifier.verify(views.data(), 0, ok) == 0);
+    }
+}
+
+static void testBatchVerifier() {
+    checkKernels(KEY, strlen(KEY));
+
+    // keys beyond one block are hashed first
+    const std::string longKey(131, 'k');
+    checkKernels(longKey.c_str(), longKey.size());
+
+    PositionView views[2];
+    bool ok[2];
+    std::vector<uint8_t> frame = frameOf(makePosition(3), Signer(KEY));
+    views[0].init(frame.data(), frame.size());
+    CHECK(verifyBatch(views, 2, KEY, ok) == 1 && ok[0] && !ok[1]);
+
+    CHECK(BatchVerifier::supported(BATCH_BACKEND_GENERIC));
+    CHECK(BatchVerifier(KEY).backend() != BATCH_BACKEND_AUTO);
+}
+
+int main() {
+    const Signer signer(KEY);
+
+    testSha256();
+    testHmac();
+    testKeyCache();
+    testPosition(signer);
+    testSessionPosition(signer);
+    testPositionBatch(signer);
+    testCommand(signer);
+    testTelemetry(signer);
+    testMalformed(signer);
+    testBatchVerifier();
+
+    if (failures > 0) {
+        fprintf(stderr, "%u checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
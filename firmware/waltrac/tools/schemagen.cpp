@@ -0,0 +1,510 @@
+// schemagen.cpp - emit the Python and JavaScript decoders from MessageSchema.h
+//
+// Host tool, not part of the sketch. Regenerate after every schema change with
+// the schema target of the root CMakeLists.txt, or by hand:
+//
+//   ./schemagen python > service/waltrac/messages_schema.py
+//   ./schemagen js > web/waltrac/messages.js
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "MessageSchema.h"
+
+using namespace Messages;
+using Schema::FieldInfo;
+
+struct MessageInfo {
+    const char* pythonName;     // decode_<pythonName>, <PYTHON>_MIN_SIZE
+    const char* jsName;         // decode<JsName>
+    size_t minSize;             // fields and HMAC
+    const FieldInfo* fields;
+    size_t fieldCount;
+};
+
+template<typename S>
+static MessageInfo describe(const char* pythonName, const char* jsName) {
+    static constexpr auto fields = S::describe();
+    return {pythonName, jsName, S::min_size + Payload::HMAC_SIZE, fields.data(), fields.size()};
+}
+
+static std::string upper(const char* s) {
+    std::string out(s);
+    for (char& c : out) {
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+    }
+
+    return out;
+}
+
+// --- Python ------------------------------------------------------------------
+
+static const char* PYTHON_RUNTIME = R"(from __future__ import annotations
+
+import struct
+from typing import Any, Dict, List, Tuple
+
+
+class DecodeError(ValueError):
+	"""Raised when a frame cannot be decoded, `status` matches Messages::decodeStatusName()."""
+
+	def __init__(self, status: str) -> None:
+		super().__init__(status)
+		self.status = status
+
+
+def _need(offset: int, end: int, n: int) -> None:
+	if end - offset < n:
+		raise DecodeError('bad length')
+
+def _read_header(data: bytes, offset: int, end: int, required: int, forbidden: int, value_mask: int, max_value: int) -> Tuple[int, int]:
+	_need(offset, end, 1)
+	v = data[offset]
+	if (v & required) != required or (v & forbidden) or (v & value_mask) > max_value:
+		raise DecodeError('bad header')
+
+	return (v, offset + 1)
+
+def _read_u8(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 1)
+	return (data[offset], offset + 1)
+
+def _read_u16(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 2)
+	return (struct.unpack_from('>H', data, offset)[0], offset + 2)
+
+def _read_u32(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 4)
+	return (struct.unpack_from('>I', data, offset)[0], offset + 4)
+
+def _read_bytes(data: bytes, offset: int, end: int, n: int) -> Tuple[bytes, int]:
+	_need(offset, end, n)
+	return (bytes(data[offset : offset + n]), offset + n)
+
+def _read_scaled_i32(data: bytes, offset: int, end: int, scale: int) -> Tuple[float, int]:
+	_need(offset, end, 4)
+	return (float(struct.unpack_from('>i', data, offset)[0]) / scale, offset + 4)
+
+def _read_str8(data: bytes, offset: int, end: int) -> Tuple[str, int]:
+	_need(offset, end, 1)
+	n = data[offset]
+	_need(offset + 1, end, n)
+
+	# The firmware takes names as bytes, bytes that are not UTF-8 survive as surrogate escapes
+	value = bytes(data[offset + 1 : offset + 1 + n]).decode('utf-8', 'surrogateescape')
+	return (value, offset + 1 + n)
+
+def _read_varint(data: bytes, offset: int, end: int, max_bytes: int) -> Tuple[int, int]:
+	value = 0
+	for i in range(max_bytes):
+		if offset >= end:
+			break
+
+		b = data[offset]
+		offset += 1
+		value |= (b & 0x7F) << (7 * i)
+
+		if not b & 0x80:
+			return (value, offset)
+
+	raise DecodeError('bad length')
+
+def _zigzag_decode(value: int) -> int:
+	return (value >> 1) ^ -(value & 1)
+
+def _read_batch_fixes(data: bytes, offset: int, end: int, header: int) -> Tuple[List[Dict[str, Any]], int]:
+	count, offset = _read_u8(data, offset, end)
+	if count < 1 or count > BATCH_MAX_FIXES:
+		raise DecodeError('bad length')
+
+	compact = bool(header & BATCH_HEADER_COMPACT)
+	fixes: List[Dict[str, Any]] = []
+	age = lat_int = lon_int = 0
+
+	for i in range(count):
+		if not compact:
+			_need(offset, end, BATCH_FIX_SIZE)
+			age, confidence, satellites, lat_int, lon_int = struct.unpack_from('>HBBii', data, offset)
+			offset += BATCH_FIX_SIZE
+		elif i == 0:
+			age, offset = _read_varint(data, offset, end, 3)
+			_need(offset, end, 10)
+			if age > 0xFFFF:
+				raise DecodeError('bad length')
+
+			confidence, satellites, lat_int, lon_int = struct.unpack_from('>BBii', data, offset)
+			offset += 10
+		else:
+			seconds, offset = _read_varint(data, offset, end, 3)
+			_need(offset, end, 2)
+			confidence, satellites = struct.unpack_from('>BB', data, offset)
+			offset += 2
+
+			dlat, offset = _read_varint(data, offset, end, 5)
+			dlon, offset = _read_varint(data, offset, end, 5)
+
+			age -= seconds
+			lat_int += _zigzag_decode(dlat)
+			lon_int += _zigzag_decode(dlon)
+
+			if age < 0 or not -2**31 <= lat_int < 2**31 or not -2**31 <= lon_int < 2**31:
+				raise DecodeError('bad length')
+
+		fixes.append({
+			'age': age,
+			'confidence': confidence,
+			'satellites': satellites,
+			'latitude': float(lat_int) / BATCH_SCALE,
+			'longitude': float(lon_int) / BATCH_SCALE,
+		})
+
+	return (fixes, offset)
+
+def _read_telemetry_phases(data: bytes, offset: int, end: int) -> Tuple[List[Dict[str, Any]], int]:
+	count, offset = _read_u8(data, offset, end)
+	_need(offset, end, count * TELEMETRY_PHASE_SIZE)
+
+	phases: List[Dict[str, Any]] = []
+	for i in range(count):
+		samples, total_millis, max_millis, charge = struct.unpack_from('>HIII', data, offset)
+		buckets = list(struct.unpack_from('>%dH' % TELEMETRY_BUCKETS, data, offset + 14))
+		offset += TELEMETRY_PHASE_SIZE
+
+		phases.append({
+			'phase': TELEMETRY_PHASES[i] if i < len(TELEMETRY_PHASES) else str(i),
+			'samples': samples,
+			'total_millis': total_millis,
+			'max_millis': max_millis,
+			'charge': charge,
+			'buckets': buckets,
+		})
+
+	return (phases, offset)
+)";
+
+static void emitPythonField(const FieldInfo& f) {
+    printf("\tfields['%s'], offset = ", f.name);
+
+    switch (f.kind) {
+        case Schema::FIELD_KIND_HEADER:
+            printf("_read_header(data, offset, end, 0x%02X, 0x%02X, 0x%02X, 0x%02X)\n", f.required, f.forbidden, f.valueMask, f.maxValue);
+            break;
+        case Schema::FIELD_KIND_U8:
+            printf("_read_u8(data, offset, end)\n");
+            break;
+        case Schema::FIELD_KIND_U16:
+            printf("_read_u16(data, offset, end)\n");
+            break;
+        case Schema::FIELD_KIND_U32:
+            printf("_read_u32(data, offset, end)\n");
+            break;
+        case Schema::FIELD_KIND_BYTES:
+            printf("_read_bytes(data, offset, end, %zu)\n", f.size);
+            break;
+        case Schema::FIELD_KIND_SCALED_I32:
+            printf("_read_scaled_i32(data, offset, end, %lld)\n", static_cast<long long>(f.scale));
+            break;
+        case Schema::FIELD_KIND_STR8:
+            printf("_read_str8(data, offset, end)\n");
+            break;
+        case Schema::FIELD_KIND_BATCH_FIXES:
+            printf("_read_batch_fixes(data, offset, end, data[0])\n");
+            break;
+        case Schema::FIELD_KIND_TELEMETRY_PHASES:
+            printf("_read_telemetry_phases(data, offset, end)\n");
+            break;
+    }
+}
+
+static void emitPython(const MessageInfo* messages, size_t count) {
+    printf("# messages_schema.py - generated by firmware/waltrac/tools/schemagen.cpp from\n");
+    printf("# firmware/waltrac/MessageSchema.h, do not edit.\n\n");
+    fputs(PYTHON_RUNTIME, stdout);
+
+    printf("\n\nHMAC_SIZE = %zu\n\n", Payload::HMAC_SIZE);
+    printf("BATCH_SCALE = %lld\n", static_cast<long long>(PositionBatch::SCALE));
+    printf("BATCH_MAX_FIXES = %u\n", PositionBatch::MAX_FIXES);
+    printf("BATCH_HEADER_COMPACT = 0x%02X\n", PositionBatch::HEADER_COMPACT);
+    printf("BATCH_HEADER_SEQUENCED = 0x%02X\n", PositionBatch::HEADER_SEQUENCED);
+    printf("BATCH_SEQUENCE_WINDOW = %u\n", PositionBatch::SEQUENCE_WINDOW);
+    printf("BATCH_FIX_SIZE = %zu\n", PositionBatch::FIX_SIZE);
+    printf("TELEMETRY_PHASE_SIZE = %zu\n", Telemetry::PHASE_SIZE);
+    printf("TELEMETRY_BUCKETS = %u\n", Telemetry::BUCKETS);
+    printf("TELEMETRY_BUCKET_BASE_MILLIS = %u\n", (unsigned)Telemetry::BUCKET_BASE_MILLIS);
+    printf("TELEMETRY_PHASES = [");
+    for (int i = 0; i < TELEMETRY_PHASE_COUNT; ++i) {
+        printf("%s'%s'", i > 0 ? ", " : "", telemetryPhaseName(static_cast<TelemetryPhase>(i)));
+    }
+    printf("]\n");
+
+    for (size_t m = 0; m < count; ++m) {
+        const MessageInfo& msg = messages[m];
+        const std::string constant = upper(msg.pythonName) + "_MIN_SIZE";
+
+        printf("\n\n%s = %zu\n\n", constant.c_str(), msg.minSize);
+        printf("def decode_%s(data: bytes) -> Dict[str, Any]:\n", msg.pythonName);
+        printf("\tif len(data) < %s:\n", constant.c_str());
+        printf("\t\traise DecodeError('too short')\n\n");
+        printf("\tend = len(data) - HMAC_SIZE\n");
+        printf("\toffset = 0\n");
+        printf("\tfields: Dict[str, Any] = {}\n\n");
+
+        for (size_t i = 0; i < msg.fieldCount; ++i) {
+            emitPythonField(msg.fields[i]);
+        }
+
+        printf("\n\tif offset != end:\n");
+        printf("\t\traise DecodeError('trailing bytes')\n\n");
+        printf("\tfields['hmac'] = bytes(data[end:])\n");
+        printf("\treturn fields\n");
+    }
+}
+
+// --- JavaScript --------------------------------------------------------------
+
+static const char* JS_RUNTIME = R"("use strict";
+
+class DecodeError extends Error {
+    constructor(status) {
+        super(status);
+        this.name = "DecodeError";
+        this.status = status;
+    }
+}
+
+function need(offset, end, n) {
+    if (end - offset < n) throw new DecodeError("bad length");
+}
+
+function readHeader(view, offset, end, required, forbidden, valueMask, maxValue) {
+    need(offset, end, 1);
+    const v = view.getUint8(offset);
+    if ((v & required) !== required || (v & forbidden) || (v & valueMask) > maxValue) throw new DecodeError("bad header");
+    return [v, offset + 1];
+}
+
+function readU8(view, offset, end) {
+    need(offset, end, 1);
+    return [view.getUint8(offset), offset + 1];
+}
+
+function readU16(view, offset, end) {
+    need(offset, end, 2);
+    return [view.getUint16(offset, false), offset + 2];
+}
+
+function readU32(view, offset, end) {
+    need(offset, end, 4);
+    return [view.getUint32(offset, false), offset + 4];
+}
+
+function readBytes(view, offset, end, n) {
+    need(offset, end, n);
+    return [new Uint8Array(view.buffer, view.byteOffset + offset, n), offset + n];
+}
+
+function readScaledI32(view, offset, end, scale) {
+    need(offset, end, 4);
+    return [view.getInt32(offset, false) / scale, offset + 4];
+}
+
+function readStr8(view, offset, end) {
+    need(offset, end, 1);
+    const n = view.getUint8(offset);
+    need(offset + 1, end, n);
+    const value = new TextDecoder().decode(new Uint8Array(view.buffer, view.byteOffset + offset + 1, n));
+    return [value, offset + 1 + n];
+}
+
+function readVarint(view, offset, end, maxBytes) {
+    let value = 0;
+    for (let i = 0; i < maxBytes && offset < end; i++) {
+        const b = view.getUint8(offset++);
+        value += (b & 0x7f) * 2 ** (7 * i);
+        if (!(b & 0x80)) return [value, offset];
+    }
+    throw new DecodeError("bad length");
+}
+
+function zigzagDecode(v) {
+    return v % 2 ? -(v + 1) / 2 : v / 2;
+}
+
+function readBatchFixes(view, offset, end, header) {
+    let count;
+    [count, offset] = readU8(view, offset, end);
+    if (count < 1 || count > BATCH_MAX_FIXES) throw new DecodeError("bad length");
+
+    const compact = header & BATCH_HEADER_COMPACT;
+    const fixes = [];
+    let age = 0, lat = 0, lon = 0;
+
+    for (let i = 0; i < count; i++) {
+        let confidence, satellites;
+        if (!compact) {
+            need(offset, end, BATCH_FIX_SIZE);
+            age = view.getUint16(offset, false);
+            confidence = view.getUint8(offset + 2);
+            satellites = view.getUint8(offset + 3);
+            lat = view.getInt32(offset + 4, false);
+            lon = view.getInt32(offset + 8, false);
+            offset += BATCH_FIX_SIZE;
+        } else if (i === 0) {
+            [age, offset] = readVarint(view, offset, end, 3);
+            need(offset, end, 10);
+            if (age > 0xffff) throw new DecodeError("bad length");
+            confidence = view.getUint8(offset);
+            satellites = view.getUint8(offset + 1);
+            lat = view.getInt32(offset + 2, false);
+            lon = view.getInt32(offset + 6, false);
+            offset += 10;
+        } else {
+            let seconds, dlat, dlon;
+            [seconds, offset] = readVarint(view, offset, end, 3);
+            need(offset, end, 2);
+            confidence = view.getUint8(offset);
+            satellites = view.getUint8(offset + 1);
+            offset += 2;
+            [dlat, offset] = readVarint(view, offset, end, 5);
+            [dlon, offset] = readVarint(view, offset, end, 5);
+
+            age -= seconds;
+            lat += zigzagDecode(dlat);
+            lon += zigzagDecode(dlon);
+            if (age < 0 || lat < -(2 ** 31) || lat >= 2 ** 31 || lon < -(2 ** 31) || lon >= 2 ** 31) throw new DecodeError("bad length");
+        }
+        fixes.push({ age, confidence, satellites, latitude: lat / BATCH_SCALE, longitude: lon / BATCH_SCALE });
+    }
+
+    return [fixes, offset];
+}
+
+function readTelemetryPhases(view, offset, end) {
+    let count;
+    [count, offset] = readU8(view, offset, end);
+    need(offset, end, count * TELEMETRY_PHASE_SIZE);
+
+    const phases = [];
+    for (let i = 0; i < count; i++) {
+        const buckets = [];
+        for (let b = 0; b < TELEMETRY_BUCKETS; b++) buckets.push(view.getUint16(offset + 14 + 2 * b, false));
+        phases.push({
+            phase: i < TELEMETRY_PHASES.length ? TELEMETRY_PHASES[i] : String(i),
+            samples: view.getUint16(offset, false),
+            totalMillis: view.getUint32(offset + 2, false),
+            maxMillis: view.getUint32(offset + 6, false),
+            charge: view.getUint32(offset + 10, false),
+            buckets,
+        });
+        offset += TELEMETRY_PHASE_SIZE;
+    }
+
+    return [phases, offset];
+}
+)";
+
+static void emitJsField(const FieldInfo& f) {
+    printf("    [fields.%s, offset] = ", f.name);
+
+    switch (f.kind) {
+        case Schema::FIELD_KIND_HEADER:
+            printf("readHeader(view, offset, end, 0x%02x, 0x%02x, 0x%02x, 0x%02x);\n", f.required, f.forbidden, f.valueMask, f.maxValue);
+            break;
+        case Schema::FIELD_KIND_U8:
+            printf("readU8(view, offset, end);\n");
+            break;
+        case Schema::FIELD_KIND_U16:
+            printf("readU16(view, offset, end);\n");
+            break;
+        case Schema::FIELD_KIND_U32:
+            printf("readU32(view, offset, end);\n");
+            break;
+        case Schema::FIELD_KIND_BYTES:
+            printf("readBytes(view, offset, end, %zu);\n", f.size);
+            break;
+        case Schema::FIELD_KIND_SCALED_I32:
+            printf("readScaledI32(view, offset, end, %lld);\n", static_cast<long long>(f.scale));
+            break;
+        case Schema::FIELD_KIND_STR8:
+            printf("readStr8(view, offset, end);\n");
+            break;
+        case Schema::FIELD_KIND_BATCH_FIXES:
+            printf("readBatchFixes(view, offset, end, view.getUint8(0));\n");
+            break;
+        case Schema::FIELD_KIND_TELEMETRY_PHASES:
+            printf("readTelemetryPhases(view, offset, end);\n");
+            break;
+    }
+}
+
+static void emitJs(const MessageInfo* messages, size_t count) {
+    printf("// messages.js - generated by firmware/waltrac/tools/schemagen.cpp from\n");
+    printf("// firmware/waltrac/MessageSchema.h, do not edit.\n\n");
+    fputs(JS_RUNTIME, stdout);
+
+    printf("\nconst HMAC_SIZE = %zu;\n\n", Payload::HMAC_SIZE);
+    printf("const BATCH_SCALE = %lld;\n", static_cast<long long>(PositionBatch::SCALE));
+    printf("const BATCH_MAX_FIXES = %u;\n", PositionBatch::MAX_FIXES);
+    printf("const BATCH_HEADER_COMPACT = 0x%02x;\n", PositionBatch::HEADER_COMPACT);
+    printf("const BATCH_HEADER_SEQUENCED = 0x%02x;\n", PositionBatch::HEADER_SEQUENCED);
+    printf("const BATCH_SEQUENCE_WINDOW = %u;\n", PositionBatch::SEQUENCE_WINDOW);
+    printf("const BATCH_FIX_SIZE = %zu;\n", PositionBatch::FIX_SIZE);
+    printf("const TELEMETRY_PHASE_SIZE = %zu;\n", Telemetry::PHASE_SIZE);
+    printf("const TELEMETRY_BUCKETS = %u;\n", Telemetry::BUCKETS);
+    printf("const TELEMETRY_BUCKET_BASE_MILLIS = %u;\n", (unsigned)Telemetry::BUCKET_BASE_MILLIS);
+    printf("const TELEMETRY_PHASES = [");
+    for (int i = 0; i < TELEMETRY_PHASE_COUNT; ++i) {
+        printf("%s\"%s\"", i > 0 ? ", " : "", telemetryPhaseName(static_cast<TelemetryPhase>(i)));
+    }
+    printf("];\n");
+
+    for (size_t m = 0; m < count; ++m) {
+        const MessageInfo& msg = messages[m];
+        const std::string constant = upper(msg.pythonName) + "_MIN_SIZE";
+
+        printf("\nconst %s = %zu;\n\n", constant.c_str(), msg.minSize);
+        printf("function decode%s(payload) {\n", msg.jsName);
+        printf("    if (payload.byteLength < %s) throw new DecodeError(\"too short\");\n\n", constant.c_str());
+        printf("    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);\n");
+        printf("    const end = payload.byteLength - HMAC_SIZE;\n");
+        printf("    const fields = {};\n");
+        printf("    let offset = 0;\n\n");
+
+        for (size_t i = 0; i < msg.fieldCount; ++i) {
+            emitJsField(msg.fields[i]);
+        }
+
+        printf("\n    if (offset !== end) throw new DecodeError(\"trailing bytes\");\n\n");
+        printf("    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);\n");
+        printf("    return fields;\n");
+        printf("}\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const MessageInfo messages[] = {
+        describe<PositionSchema>("position", "Position"),
+        describe<SessionPositionSchema>("session_position", "SessionPosition"),
+        describe<PositionBatchSchema>("position_batch", "PositionBatch"),
+        describe<SequencedBatchSchema>("sequenced_batch", "SequencedBatch"),
+        describe<CommandSchema>("command", "Command"),
+        describe<TelemetrySchema>("telemetry", "Telemetry"),
+    };
+    const size_t count = sizeof(messages) / sizeof(messages[0]);
+
+    if (argc == 2 && strcmp(argv[1], "python") == 0) {
+        emitPython(messages, count);
+        return 0;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "js") == 0) {
+        emitJs(messages, count);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: %s python|js\n", argv[0]);
+    return 2;
+}
@@ -2,26 +2,422 @@
 #include <WalterModem.h>
 #include <esp_mac.h>
 #include <esp_log.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
 
 #include "Messages.h"
 #include "WaltracConfig.h"
 #include "Waltrac.h"
 
+/* Sends one update and uses its LTE window for the commands, holding the radio so that no GNSS attempt runs in between */
+static bool sendUpdateLocked(const GnssUpdate& update)
+{
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    bool sent = sendPositionUpdate(update);
+    if (sent) {
+        serviceCommands();
+    }
+    xSemaphoreGive(radioMutex);
+
+    return sent;
+}
+
+/* Hands an update to the uplink, directly in duty-cycle mode, through the queue to the uplink task otherwise */
+static void publishUpdate(const GnssUpdate& update);
+
+/* Runs the GNSS work of one interval and returns the seconds until the next interval */
+static uint32_t runGnssCycle()
+{
+    /* Read once per cycle, a SETINTERVAL received meanwhile applies from this cycle on */
+    uint32_t configured = runtimeConfig.interval();
+
+    /* Seconds until the next fix, picked by the motion policy after every fix */
+    uint32_t interval = configured;
+
+    if (!trackerState.latestFixValid) {
+        ESP_LOGI("WaltracGnss", "Looking for GNSS satellites ...");
+
+        do
+        {
+            /* Report that the tracker is still searching */
+            GnssUpdate searching;
+            searching.interval = configured > UINT8_MAX ? UINT8_MAX : configured;
+            searching.fix.satellites = gnssFixNumSatellites;
+            publishUpdate(searching);
+
+            int64_t attemptStart = monotonicMicros();
+
+            xSemaphoreTake(radioMutex, portMAX_DELAY);
+            trackerState.latestFixValid = waitForInitialGnssFix();
+            xSemaphoreGive(radioMutex);
+
+            if (trackerState.latestFixValid) {
+                ttffModel.addSample(TtffModel::MODE_COLD_WARM, gnssRequestMicros - attemptStart, gnssFixMicros - gnssRequestMicros);
+            }
+        }
+        while(!trackerState.latestFixValid);
+    } else {
+        ESP_LOGI("WaltracGnss", "Performing GNSS Update ...");
+
+        int64_t cycleStart = monotonicMicros();
+
+        xSemaphoreTake(radioMutex, portMAX_DELAY);
+        trackerState.latestFixValid = attemptGnssFix();
+        xSemaphoreGive(radioMutex);
+
+        if (trackerState.latestFixValid) {
+            ttffModel.addSample(TtffModel::MODE_HOT, gnssRequestMicros - cycleStart, gnssFixMicros - gnssRequestMicros);
+
+            /* Negative when the fix was ready before the boundary */
+            ESP_LOGI("WaltracGnss", "Fix landed %+lldms from the interval boundary, time to fix %lldms.", (long long)((gnssFixMicros - intervalTimer.deadline()) / 1000), (long long)((gnssFixMicros - gnssRequestMicros) / 1000));
+            MotionPolicy::Decision decision;
+            decision.interval = configured;
+
+#if WT_CFG_MOTION_ADAPTIVE
+            decision = motionPolicy.update(latestGnssFix.latitude, latestGnssFix.longitude, latestGnssFix.timestamp);
+            ESP_LOGI("WaltracGnss", "Moving at %.01fm/s, heading %.0f, turning %.01f/s, next fix in %ds.", motionPolicy.speed(), motionPolicy.heading(), motionPolicy.turnRate(), decision.interval);
+#endif
+
+            interval = decision.interval;
+
+            GnssUpdate update;
+            update.valid = true;
+            update.takenMillis = millis();
+            update.timestamp = latestGnssFix.timestamp;
+            update.interval = interval > UINT8_MAX ? UINT8_MAX : interval;
+            update.fix.confidence = (int)latestGnssFix.estimatedConfidence;
+            update.fix.satellites = gnssFixNumSatellites;
+            update.fix.latitude = latestGnssFix.latitude;
+            update.fix.longitude = latestGnssFix.longitude;
+
+            /* A parked asset keeps the radio off, only the heartbeat is sent. The device is announced regardless. */
+            if (!decision.report && !discoveryPending()) {
+                ESP_LOGI("WaltracGnss", "Stationary within %dm, suppressed GNSS fix.", WT_CFG_STATIONARY_RADIUS);
+            } else {
+                publishUpdate(update);
+            }
+        }
+    }
+
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    RadioScheduler::Stats radio = radioScheduler.takeCycle();
+    xSemaphoreGive(radioMutex);
+
+    ESP_LOGI("WaltracRadio", "Cycle took %ums with %u attaches and %u detaches, LTE %ums, GNSS %ums.", (unsigned)radio.wallMillis, (unsigned)radio.attaches, (unsigned)radio.detaches, (unsigned)radio.lteMillis, (unsigned)radio.gnssMillis);
+
+    trackerState.cycles++;
+    return interval;
+}
+
+/* Runs the interval that is due and returns the milliseconds until the deadline of the next one */
+static uint32_t runInterval()
+{
+    int64_t lateness = intervalTimer.wake(monotonicMicros());
+    uint32_t interval = runGnssCycle();
+
+    /* Start the next fix early by the time it is expected to take */
+    int64_t lead = 0;
+#if WT_CFG_PREDICTIVE_START
+    TtffModel::Mode mode = trackerState.latestFixValid ? TtffModel::MODE_HOT : TtffModel::MODE_COLD_WARM;
+    lead = ttffModel.lead(mode, (int64_t)MAX_GNSS_FIX_DURATION_SECONDS * 1000000);
+#endif
+
+    int64_t remaining = intervalTimer.schedule(monotonicMicros(), interval, lead);
+
+    const IntervalTimer::Stats& timing = intervalTimer.stats();
+    ESP_LOGI("WaltracGnss", "Interval started %lldms late, jitter %.0fms, max %lldms, %u overruns, %u deadlines skipped.", (long long)(lateness / 1000), timing.jitterMicros / 1000.0, (long long)(timing.maxLatenessMicros / 1000), (unsigned)timing.overruns, (unsigned)timing.skipped);
+    ESP_LOGI("WaltracGnss", "Next interval starts %lldms ahead of its boundary.", (long long)(lead / 1000));
+
+    return remaining / 1000;
+}
+
+#if !WT_CFG_DEEP_SLEEP
+/* Acquires fixes once per interval and hands them to the uplink task */
+static void gnssTask(void* /* args */)
+{
+    for (;;) {
+        uint32_t procRemainingTime = runInterval();
+
+        ESP_LOGI("WaltracGnss", "Waiting %ums for next interval ...", (unsigned)procRemainingTime);
+        delay(procRemainingTime);
+    }
+}
+#endif
+
+/* Keeps a fix that could not be sent for the backlog */
+static void storeFix(const GnssUpdate& update)
+{
+    FixStore::Entry entry;
+    entry.fix = update.fix;
+    entry.timestamp = update.timestamp;
+
+    if (fixStore.append(entry)) {
+        ESP_LOGI("WaltracUplink", "Stored GNSS fix, %u fixes in the backlog.", (unsigned)fixStore.size());
+    }
+}
+
+/* Current GNSS time in seconds since the epoch, extrapolated from the update taken last */
+static int64_t gnssNow(const GnssUpdate& update)
+{
+    return update.timestamp + (millis() - update.takenMillis) / 1000;
+}
+
+/* Uses the LTE window of a successful update for the commands, the backlog and the GNSS preparation of the next fixes */
+static void finishLteWindow(const GnssUpdate& update)
+{
+    serviceCommands();
+
+    if (fixStore.size() > 0) {
+        sendBacklog(gnssNow(update));
+    }
+
+#if WT_CFG_TELEMETRY_INTERVAL
+    if (phaseStats.due(monotonicMicros(), (int64_t)WT_CFG_TELEMETRY_INTERVAL * 1000000) && !sendTelemetry()) {
+        ESP_LOGW("WaltracUplink", "Could not send telemetry, trying again with the next update.");
+    }
+#endif
+
+    prepareGnss();
+}
+
+#if WT_CFG_NON_UPLINKS
+/* Adds a fix to the uplink window and sends the window once a batch worth of new fixes is waiting */
+static void handleSequencedUpdate(const GnssUpdate& update)
+{
+    FixStore::Entry entry;
+    entry.fix = update.fix;
+    entry.timestamp = update.timestamp;
+
+    /* The oldest unacknowledged fix makes room and goes the confirmable way through the backlog */
+    FixStore::Entry evicted;
+    if (uplinkWindow.push(entry, evicted) && fixStore.append(evicted)) {
+        ESP_LOGI("WaltracUplink", "Moved unacknowledged GNSS fix to the backlog, %u fixes in the backlog.", (unsigned)fixStore.size());
+    }
+
+    /* batchCount counts the fixes that were not sent at all yet */
+    trackerState.batchCount++;
+    if (trackerState.batchCount < WT_CFG_BATCH_SIZE && !discoveryPending()) {
+        ESP_LOGI("WaltracUplink", "Collected GNSS fix %d/%d for the next batch.", trackerState.batchCount, WT_CFG_BATCH_SIZE);
+        return;
+    }
+
+    ESP_LOGI("WaltracUplink", "Sending %u unacknowledged GNSS fixes ...", (unsigned)uplinkWindow.size());
+
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    if (sendSequencedFixes(update.interval, gnssNow(update))) {
+        trackerState.batchCount = 0;
+        finishLteWindow(update);
+    } else {
+        ESP_LOGE("WaltracUplink", "Could not send GNSS fixes, %u wait in the uplink window.", (unsigned)uplinkWindow.size());
+    }
+    xSemaphoreGive(radioMutex);
+}
+#endif
+
+/* Sends an update as a single position or collects it for the next batch */
+static void handleUpdate(const GnssUpdate& update)
+{
+    static Messages::PositionBatch batch;
+    static uint8_t batchBuf[Messages::PositionBatch::MAX_SIZE];
+
+#if WT_CFG_NON_UPLINKS
+    if (update.valid) {
+        handleSequencedUpdate(update);
+        return;
+    }
+#endif
+
+    if (!update.valid) {
+        if (sendUpdateLocked(update)) {
+            ESP_LOGI("WaltracUplink", "Sent position data update successfully.");
+        } else {
+            ESP_LOGE("WaltracUplink", "Could not send position data update.");
+        }
+    } else if (WT_CFG_BATCH_SIZE > 1) {
+        /* Collected fixes live in trackerState, so a batch can span several deep sleeps */
+        trackerState.batch[trackerState.batchCount++] = update;
+
+        ESP_LOGI("WaltracUplink", "Collected GNSS fix %d/%d for the next batch.", trackerState.batchCount, WT_CFG_BATCH_SIZE);
+
+        /* The radio is only woken up once the batch is complete, or early to announce the device */
+        if (trackerState.batchCount >= WT_CFG_BATCH_SIZE || discoveryPending()) {
+            ESP_LOGI("WaltracUplink", "Sending GNSS batch update ...");
+
+            batch.clear();
+            for (uint8_t i = 0; i < trackerState.batchCount; i++) {
+                batch.addFix(trackerState.batch[i].fix);
+            }
+
+            batch.setHeader(true, WT_CFG_BATCH_COMPACT);
+            batch.interval = update.interval;
+            memcpy(batch.device, macBuf, 6);
+            batch.name = runtimeConfig.name();
+
+            xSemaphoreTake(radioMutex, portMAX_DELAY);
+
+            /* Ages come from the GNSS time, millis() restarts with every wake-up */
+            int64_t now = gnssNow(update);
+            for (uint8_t i = 0; i < batch.count; i++) {
+                int64_t age = now - trackerState.batch[i].timestamp;
+                batch.fixes[i].age = age < 0 ? 0 : (age > UINT16_MAX ? UINT16_MAX : age);
+            }
+
+            size_t batchLen = batch.serialize(batchBuf, sizeof(batchBuf), signer);
+            if (batchLen > 0 && coapSendPositionUpdate(batchBuf, batchLen)) {
+                delay(250);
+                ESP_LOGI("WaltracUplink", "Sent GNSS batch update with %d fixes successfully.", batch.count);
+
+                finishLteWindow(update);
+            } else {
+                ESP_LOGE("WaltracUplink", "Could not send GNSS batch update.");
+
+                for (uint8_t i = 0; i < trackerState.batchCount; i++) {
+                    storeFix(trackerState.batch[i]);
+                }
+            }
+
+            xSemaphoreGive(radioMutex);
+
+            trackerState.batchCount = 0;
+        }
+    } else {
+        ESP_LOGI("WaltracUplink", "Sending GNSS data update ...");
+
+        xSemaphoreTake(radioMutex, portMAX_DELAY);
+        if (sendPositionUpdate(update)) {
+            delay(250);
+            ESP_LOGI("WaltracUplink", "Sent GNSS data update successfully.");
+
+            finishLteWindow(update);
+        } else {
+            ESP_LOGE("WaltracUplink", "Could not send GNSS data update.");
+
+            storeFix(update);
+        }
+        xSemaphoreGive(radioMutex);
+    }
+}
+
+#if !WT_CFG_DEEP_SLEEP
+/* Blocks on the update queue and sends single positions or complete batches */
+static void uplinkTask(void* /* args */)
+{
+    GnssUpdate update;
+    for (;;) {
+        xQueueReceive(gnssUpdates, &update, portMAX_DELAY);
+        handleUpdate(update);
+    }
+}
+#endif
+
+static void publishUpdate(const GnssUpdate& update)
+{
+#if WT_CFG_DEEP_SLEEP
+    handleUpdate(update);
+#else
+    if (xQueueSend(gnssUpdates, &update, 0) != pdTRUE) {
+        ESP_LOGW("WaltracGnss", "Uplink is behind, dropped GNSS update.");
+    }
+#endif
+}
+
+#if WT_CFG_DEEP_SLEEP
+/* Runs intervals until the time to the next deadline is worth a deep sleep, then sleeps until then, never returns */
+static void runDutyCycle()
+{
+    for (;;) {
+        uint32_t procRemainingTime = runInterval();
+
+        if (procRemainingTime >= MIN_DEEP_SLEEP_MILLIS) {
+            /* The modem sleeps whole seconds, the clock has to advance by what is actually slept */
+            uint32_t sleepMillis = (procRemainingTime + ModemInterface::SLEEP_RESOLUTION_MILLIS - 1) / ModemInterface::SLEEP_RESOLUTION_MILLIS * ModemInterface::SLEEP_RESOLUTION_MILLIS;
+
+            ESP_LOGI("WaltracGnss", "Sleeping %ums until next interval ...", (unsigned)sleepMillis);
+            Serial.flush();
+
+            /* The deadlines are absolute, the monotonic clock has to count the sleep */
+            phaseStats.accountAwake();
+            advanceMonotonicClock(sleepMillis);
+
+            /* Holds the modem out of reset during deep sleep, modem.begin() picks it up again on wake-up */
+            modem.sleep(sleepMillis);
+        } else {
+            ESP_LOGI("WaltracGnss", "Waiting %ums for next interval ...", (unsigned)procRemainingTime);
+            delay(procRemainingTime);
+        }
+    }
+}
+#endif
+
+/* How the ESP32 came up, for the restart and crash counters of the telemetry */
+static PhaseStats::Boot bootKind()
+{
+    switch (esp_reset_reason()) {
+        case ESP_RST_DEEPSLEEP:
+            return PhaseStats::BOOT_WAKE;
+        case ESP_RST_SW:
+        case ESP_RST_EXT:
+            return PhaseStats::BOOT_RESTART;
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+        case ESP_RST_BROWNOUT:
+            return PhaseStats::BOOT_CRASH;
+        default:
+            return PhaseStats::BOOT_POWER_ON;
+    }
+}
+
 void setup() 
 {
-    /* Startup serial output */
+    /* A timer wake-up continues the duty cycle, the state of the last interval is still in RTC memory */
+    bool wokeUp = WT_CFG_DEEP_SLEEP && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && trackerState.cycles > 0;
+
+    /* Startup serial output, only worth waiting for after a power on */
     Serial.begin(115200);
-    delay(5000);
+    if (!wokeUp) {
+        delay(5000);
+    }
 
     ESP_LOGI("WaltracSetup", "Waltrac Realtime GNSS Tracker");
 
+    /* Statistics of the telemetry window survive restarts, a power on starts over */
+    phaseStats.begin(bootKind(), monotonicMicros());
+
+    /* Unacknowledged fixes survive restarts as well, after a power on the sequence numbers start at random */
+    uplinkWindow.begin(esp_random());
+
     /* Get the MAC address for board validation */
     esp_read_mac(macBuf, ESP_MAC_WIFI_STA);    
     ESP_LOGI("WaltracSetup", "%02X:%02X:%02X:%02X:%02X:%02X", macBuf[0], macBuf[1], macBuf[2], macBuf[3], macBuf[4], macBuf[5]);
     sprintf(macHex, "%02x%02x%02x%02x%02x%02x", macBuf[0], macBuf[1], macBuf[2], macBuf[3], macBuf[4], macBuf[5]);
 
+    /* Absorb the secret once, all messages are signed with the precomputed key schedule */
+    if (!signer.setKey(WT_CFG_SECRET)) {
+        ESP_LOGE("WaltracSetup", "Could not set up HMAC signer.");
+        return;
+    }
+
+    /* Create the event group, the GNSS update queue and the radio mutex before any handler can fire */
+    if (!initRuntime()) {
+        ESP_LOGE("WaltracSetup", "Could not create runtime primitives.");
+        return;
+    }
+
+    /* Fixes that could not be sent before a restart are still waiting in flash */
+    if (!fixStore.begin()) {
+        ESP_LOGW("WaltracSetup", "Fix store unavailable, fixes that cannot be sent are lost.");
+    }
+
+    /* Interval and name as last set by the server, the compiled values until then */
+    if (!runtimeConfig.begin(WT_CFG_INTERVAL, WT_CFG_NAME)) {
+        ESP_LOGD("WaltracSetup", "No stored settings, using the compiled interval and name.");
+    }
+    applyMotionBounds(runtimeConfig.interval());
+
     /* Open serial connection to modem */
-    if (WalterModem::begin(&Serial2)) {
+    if (modem.begin()) {
         ESP_LOGD("WaltracSetup", "Modem initialization successful.");
     } else {
         ESP_LOGE("WaltracSetup", "Modem initialization failed.");
@@ -42,116 +438,34 @@ void setup()
     /* Set CoAP event handler */
     modem.coapSetEventHandler(coapEventHandler, NULL);
 
-    /* send a discover command at the first connection attempt */
-    Messages::Command command = {};
-    command.setHeader(Messages::COMMAND_ACTION_DISCOVER);
-    command.arg = macHex;
-
-    std::vector<uint8_t> data = command.serialize(WT_CFG_SECRET);
-    if (!coapSendCommand(&data[0], data.size())) {
-        ESP_LOGE("WaltracSetup", "Could not send discover command.");
-    }
-
-    delay(2500);
+    /* Set the network registration event handler */
+    modem.setRegistrationEventHandler(registrationEventHandler, NULL);
 
-    // update Command from server once per minute
-    if (coapSubscribeCommands()) {
-        uint8_t cntMntCmdTimeout = 0;
-        while(cmdModeActive && cntMntCmdTimeout++ < CMD_TIMEOUT_SECONDS) {
-            if (getCommand(command)) {
-                Messages::CommandAction commandAction;
-                command.getHeader(commandAction);
+#if WT_CFG_DEEP_SLEEP
+    if (wokeUp) {
+        ESP_LOGI("WaltracSetup", "Woke up for interval %u.", (unsigned)trackerState.cycles);
 
-                if (commandAction == Messages::COMMAND_ACTION_EXIT) {
-                    ESP_LOGD("WaltracSetup", "Recevied Command EXIT.");
-                    break;
-                } else {
-                    ESP_LOGD("WaltracSetup", "Unknown Command.");
-                }
-
-                cntMntCmdTimeout = 0;
-            }
-
-            delay(1000);
-        }
+        runDutyCycle();
+    }
 
-        ESP_LOGI("WaltracSetup", "Command mode time frame ended after %ds. Entering main loop ...", cntMntCmdTimeout);
-    } else {
-        ESP_LOGW("WaltracSetup", "Cannot subscribe command topic for entering command mode.");
+    /* Keep the network registration through the deep sleeps instead of attaching again every interval */
+    if (!modem.configPSM(WALTER_MODEM_PSM_ENABLE)) {
+        ESP_LOGW("WaltracSetup", "Could not enable PSM.");
     }
+#endif
+
+    /* Tracking starts right away, DISCOVER and the commands go along with the first LTE window of an update */
+#if WT_CFG_DEEP_SLEEP
+    runDutyCycle();
+#else
+    /* The uplink task outranks the GNSS task, so it takes the radio first whenever an update is queued */
+    xTaskCreate(gnssTask, "gnss", TASK_STACK_SIZE, NULL, GNSS_TASK_PRIORITY, NULL);
+    xTaskCreate(uplinkTask, "uplink", TASK_STACK_SIZE, NULL, UPLINK_TASK_PRIORITY, NULL);
+#endif
 }
 
 void loop() 
 {
-    static bool latestFixValid = false;
-    
-    uint64_t procDurationStart = millis();
-
-    // send GNSS data update
-    if (!latestFixValid) {
-        ESP_LOGI("WaltracMain", "Looking for GNSS satellites ...");
-        
-        do
-        {
-            Messages::Position position;
-            position.setHeader(false);
-            position.interval = WT_CFG_INTERVAL;
-            position.confidence = 0;
-            position.satellites = gnssFixNumSatellites;
-            memcpy(position.device, macBuf, 6);
-            position.name = WT_CFG_NAME;
-
-            std::vector<uint8_t> data = position.serialize(WT_CFG_SECRET);
-            if (coapSendPositionUpdate(&data[0], data.size())) {
-                ESP_LOGI("WaltracMain", "Sent position data update successfully.");
-            } else {
-                ESP_LOGE("WaltracMain", "Could not send position data update.");
-            }
-
-            latestFixValid = waitForInitialGnssFix();
-        }
-        while(!latestFixValid);
-    } else {
-        ESP_LOGI("WaltracMain", "Performing GNSS Update ...");
-
-        latestFixValid = attemptGnssFix();
-        if (latestFixValid) {
-            ESP_LOGI("WaltracMain", "Sending GNSS data update ...");
-
-            Messages::Position position;
-            position.setHeader(true);
-            position.interval = WT_CFG_INTERVAL;
-            position.confidence = (int)latestGnssFix.estimatedConfidence;
-            position.satellites = gnssFixNumSatellites;
-            memcpy(position.device, macBuf, 6);
-            position.name = WT_CFG_NAME;
-            position.latitude = latestGnssFix.latitude;
-            position.longitude = latestGnssFix.longitude;
-
-            std::vector<uint8_t> data = position.serialize(WT_CFG_SECRET);
-            if (coapSendPositionUpdate(&data[0], data.size())) {
-                delay(250);
-                ESP_LOGI("WaltracMain", "Sent GNSS data update successfully.");
-            } else {
-                ESP_LOGE("WaltracMain", "Could not send GNSS data update.");
-            }
-        }   
-    }
-
-    // monitor elapsed time and wait until next interval
-    uint32_t procElapsedTime = millis() - procDurationStart;
-    int32_t procRemainingTime = WT_CFG_INTERVAL * 1000 - procElapsedTime;
-    if (procRemainingTime < 0) {
-        procRemainingTime = 0;
-    }
-
-    uint32_t procElapsedSeconds = procElapsedTime / 1000;
-    if (procElapsedSeconds > WT_CFG_INTERVAL) {
-        gnssFixDurationSeconds += procElapsedSeconds;
-    } else {
-        gnssFixDurationSeconds += WT_CFG_INTERVAL;
-    }
-
-    ESP_LOGI("WaltracMain", "Waiting %dms for next interval ...", procRemainingTime);
-    delay(procRemainingTime);
-}
\ No newline at end of file
+    /* All work happens in gnssTask and uplinkTask or in the duty cycle, the Arduino loop task is not needed */
+    vTaskDelete(NULL);
+}
@@ -12,6 +12,12 @@ from messages import *
 
 _secret: str|None = None
 _device_id: str|None = None
+_session_id: int|None = None
+_session_name: str = ""
+_topic_base: str = ""
+
+# sequence number following the last fix received from a sequenced batch
+_next_sequence: int|None = None
 
 def _on_message_discover(mqtt: Client, userdata, message) -> None:
     global _device_id
@@ -30,10 +36,66 @@ def _on_message_discover(mqtt: Client, userdata, message) -> None:
         logging.debug(f"Message: {message.payload.hex()}")
         return
     
+def _acknowledge(mqtt: Client, batch: PositionBatch) -> list[dict]:
+    """Acknowledge a sequenced batch and return its fixes that were not received before."""
+    global _next_sequence
+
+    # the device numbers its fixes anew after a power on, which shows as a batch far behind
+    behind: int = (_next_sequence - batch.sequence) % 0x10000 if _next_sequence is not None else 0
+    if _next_sequence is None or PositionBatch.SEQUENCE_WINDOW < behind < 0x8000:
+        _next_sequence = batch.sequence
+
+    fresh: list[dict] = []
+    for i, fix in enumerate(batch.fixes):
+        if (batch.sequence + i - _next_sequence) % 0x10000 < 0x8000:
+            fresh.append(fix)
+
+    end: int = (batch.sequence + len(batch.fixes)) % 0x10000
+    if (end - _next_sequence) % 0x10000 < 0x8000:
+        _next_sequence = end
+
+    # the batch starts at the oldest fix the device still holds, so acknowledging its end covers everything before
+    command: Command = Command()
+    command.set_header(CommandAction.ACK)
+    command.arg = str(_next_sequence)
+
+    mqtt.publish(f"{_topic_base}waltrac/cmd/{_device_id}", command.serialize(_secret))
+
+    return fresh
+
 def _on_message_monitor(mqtt: Client, userdata, message) -> None:
+    global _session_name
+
     try:
-        position: Position = Position.init(message.payload)
+        if Telemetry.is_telemetry(message.payload):
+            telemetry: Telemetry = Telemetry.init(message.payload)
+            if telemetry.verify(_secret):
+                print(telemetry.summary())
+            else:
+                print("Received message with invalid signature.")
+
+            return
+
+        if SessionPosition.is_session(message.payload):
+            position: SessionPosition = SessionPosition.init(message.payload)
+        elif PositionBatch.is_batch(message.payload):
+            position: PositionBatch = PositionBatch.init(message.payload)
+        else:
+            position: Position = Position.init(message.payload)
+
         if position.verify(_secret):
+            if isinstance(position, PositionBatch) and position.is_sequenced():
+                position.fixes = _acknowledge(mqtt, position)
+                if not position.fixes:
+                    return
+
+            # session frames only carry the name when it changed
+            if isinstance(position, SessionPosition):
+                if position.name:
+                    _session_name = position.name
+                else:
+                    position.name = _session_name
+
             print(str(position))
         else:
             print("Received message with invalid signature.")
@@ -43,13 +105,14 @@ def _on_message_monitor(mqtt: Client, userdata, message) -> None:
         return
 
 def commander(secret: str, mqtt: str) -> None:
-    global _secret, _device_id
+    global _secret, _device_id, _session_id, _topic_base
 
     _secret = secret
     
     mqtt_uri = urlparse(mqtt)
     mqtt_params = mqtt_uri.netloc.split('@')
     mqtt_topic_base = mqtt_uri.path
+    _topic_base = mqtt_topic_base
 
     if len(mqtt_params) == 1:
         mqtt_username, mqtt_password = None, None
@@ -91,8 +154,23 @@ def commander(secret: str, mqtt: str) -> None:
     else:
         print("No device discovered within timeout period.")
         exit(1)
+
+    # answer the discovery with a session ID, the device then sends compact
+    # position frames to waltrac/pos/<session> instead of waltrac/pos/<mac>
+    _session_id = random.randint(1, 0xFFFF)
+
+    # the device subscribes to its command resource shortly after DISCOVER
+    sleep(5)
+
+    command: Command = Command()
+    command.set_header(CommandAction.SETSESSION)
+    command.arg = str(_session_id)
+
+    mqtt.publish(f"{mqtt_topic_base}waltrac/cmd/{_device_id}", command.serialize(secret))
+    print(f"Assigned session {_session_id:04x}")
     
     print("")
+    print("The device keeps tracking, commands reach it with its next LTE window.")
     print("Type a command or 'exit' to close the control application.")
     print("")
 
@@ -106,6 +184,12 @@ def commander(secret: str, mqtt: str) -> None:
                 mqtt.subscribe(f"{mqtt_topic_base}waltrac/pos/{_device_id}")
                 logging.debug("Subscribed to MQTT topic: %s", f"{mqtt_topic_base}waltrac/pos/{_device_id}")
 
+                mqtt.subscribe(f"{mqtt_topic_base}waltrac/pos/{_session_id:04x}")
+                logging.debug("Subscribed to MQTT topic: %s", f"{mqtt_topic_base}waltrac/pos/{_session_id:04x}")
+
+                mqtt.subscribe(f"{mqtt_topic_base}waltrac/tel/{_device_id}")
+                logging.debug("Subscribed to MQTT topic: %s", f"{mqtt_topic_base}waltrac/tel/{_device_id}")
+
                 print("Monitoring for 5 minutes. Press Ctrl+C to stop early.")
 
                 seconds: int = 0
@@ -119,6 +203,12 @@ def commander(secret: str, mqtt: str) -> None:
                 mqtt.unsubscribe(f"{mqtt_topic_base}waltrac/pos/{_device_id}")
                 logging.debug("Unsubscribed from MQTT topic: %s", f"{mqtt_topic_base}waltrac/pos/{_device_id}")
 
+                mqtt.unsubscribe(f"{mqtt_topic_base}waltrac/pos/{_session_id:04x}")
+                logging.debug("Unsubscribed from MQTT topic: %s", f"{mqtt_topic_base}waltrac/pos/{_session_id:04x}")
+
+                mqtt.unsubscribe(f"{mqtt_topic_base}waltrac/tel/{_device_id}")
+                logging.debug("Unsubscribed from MQTT topic: %s", f"{mqtt_topic_base}waltrac/tel/{_device_id}")
+
                 mqtt.on_message = None
 
             elif command.startswith('setinterval'):
@@ -127,8 +217,8 @@ def commander(secret: str, mqtt: str) -> None:
                     print("Invalid command. Usage: setinterval:<seconds>. Type 'help' for a list of commands.")
                     continue
 
-                if not cmdargs[1].isdigit() or int(cmdargs[1]) < 1:
-                    print("Invalid interval. It must be a positive integer representing seconds.")
+                if not cmdargs[1].isdigit() or not 1 <= int(cmdargs[1]) <= 3600:
+                    print("Invalid interval. It must be an integer between 1 and 3600 seconds.")
                     continue
                 
                 command: Command = Command()
@@ -141,6 +231,10 @@ def commander(secret: str, mqtt: str) -> None:
                 if len(cmdargs) != 2:
                     print("Invalid command. Usage: setname:<name>. Type 'help' for a list of commands.")
                     continue
+
+                if not 1 <= len(cmdargs[1].encode('utf-8')) <= 255:
+                    print("Invalid name. It must be between 1 and 255 bytes long.")
+                    continue
                 
                 command: Command = Command()
                 command.set_header(CommandAction.SETNAME)
@@ -157,10 +251,10 @@ def commander(secret: str, mqtt: str) -> None:
                 break
             elif command == 'help':
                 print("Following commands are available:")
-                print("monitor - Monitors incoming positions of the discovered device for 5 minutes. Device needs to be in operations mode.")
-                print("setinterval:<interval> - Set the minimum update interval in seconds for the device. Requires an integer, minimum is 10.")
-                print("setname:<name> - Set the name for the device. Requires a valid UTF-8 string.")
-                print("exit - Quits the control application and sends a command to the discovered device to enter operations mode.")
+                print("monitor - Monitors incoming positions and telemetry of the discovered device for 5 minutes and acknowledges sequenced batches.")
+                print("setinterval:<interval> - Set the minimum update interval in seconds for the device. Requires an integer between 1 and 3600. The device keeps it over restarts.")
+                print("setname:<name> - Set the name for the device. Requires a valid UTF-8 string of up to 255 bytes. The device keeps it over restarts.")
+                print("exit - Quits the control application and lets the device close its command window early.")
                 print("help - Displays the help for available commands.")
             else:
                 print(f'Unknown command: {command}. Enter \'help\' for a list of commands.')
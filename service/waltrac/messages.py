@@ -7,6 +7,23 @@ from typing import Optional, Tuple
 
 from abc import ABC, abstractmethod
 
+# decoders generated from firmware/waltrac/MessageSchema.h
+from messages_schema import DecodeError, decode_position, decode_session_position, decode_position_batch, decode_sequenced_batch, decode_command, decode_telemetry, BATCH_SEQUENCE_WINDOW, TELEMETRY_BUCKETS, TELEMETRY_BUCKET_BASE_MILLIS
+
+
+def _pack_varint(value: int) -> bytes:
+	"""Encode an unsigned integer as LEB128 varint."""
+	out = bytearray()
+	while value >= 0x80:
+		out.append((value & 0x7F) | 0x80)
+		value >>= 7
+
+	out.append(value)
+	return bytes(out)
+
+def _zigzag_encode(value: int) -> int:
+	return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
 
 class Payload(ABC):
 	"""Abstract base class for payload types that support signing/verification.
@@ -109,7 +126,7 @@ class Position(Payload):
 
 		MSB is always 1, bit 0 is the `valid` flag.
 		"""
-		header_val = 0x80 | ((1 if valid else 0) << 1)
+		header_val = 0x80 | (1 if valid else 0)
 		self.header = bytes([header_val])
 
 	def get_header(self) -> Tuple[bool]:
@@ -127,69 +144,22 @@ class Position(Payload):
 
 	@staticmethod
 	def init(data: bytes) -> "Position":
+		"""Parse a raw frame, raises DecodeError (a ValueError) on malformed frames."""
 		if not isinstance(data, (bytes, bytearray)):
 			raise TypeError('data must be bytes or bytearray')
 
-		# minimum size without the variable-length name and hmac
-		min_fixed = 1 + 1 + 6 + 4 + 4 + 1 + 16
-		if len(data) < min_fixed:
-			raise ValueError(f'data too short: need at least {min_fixed} bytes')
+		fields = decode_position(data)
 
-		offset = 0
 		p = Position()
-
-		# 1 byte header
-		p.header = bytes(data[offset : offset + 1])
-		offset += 1
-
-		# 1 byte interval (unsigned)
-		p.interval = struct.unpack_from('>B', data, offset)[0]
-		offset += 1
-
-		# 1 byte confidence (unsigned)
-		p.confidence = struct.unpack_from('>B', data, offset)[0]
-		offset += 1
-
-		# 1 byte satellites (unsigned)
-		p.satellites = struct.unpack_from('>B', data, offset)[0]
-		offset += 1
-
-		# 6 byte device
-		p.device = bytes(data[offset : offset + 6])
-		offset += 6
-
-		# 4 byte latitude (signed int) -> float
-		lat_int = struct.unpack_from('>i', data, offset)[0]
-		p.latitude = float(lat_int) / p.SCALE
-		offset += 4
-
-		# 4 byte longitude (signed int) -> float
-		lon_int = struct.unpack_from('>i', data, offset)[0]
-		p.longitude = float(lon_int) / p.SCALE
-		offset += 4
-
-		# 1 byte namelen
-		namelen: int = struct.unpack_from('>B', data, offset)[0]
-		offset += 1
-
-		# n bytes name
-		if len(data) < offset + namelen + 16:
-			raise ValueError('data too short for name length and hmac')
-
-		name_bytes = data[offset : offset + namelen]
-		try:
-			p.name = name_bytes.decode('utf-8')
-		except Exception as exc:  # keep decode errors explicit
-			raise ValueError('name is not valid UTF-8') from exc
-
-		offset += namelen
-
-		# 16 bytes hmac
-		p.hmac = bytes(data[offset : offset + 16])
-		offset += 16
-
-		if len(data) != offset:
-			raise ValueError('extra or missing bytes after parsing hmac')
+		p.header = bytes([fields['header']])
+		p.interval = fields['interval']
+		p.confidence = fields['confidence']
+		p.satellites = fields['satellites']
+		p.device = fields['device']
+		p.latitude = fields['latitude']
+		p.longitude = fields['longitude']
+		p.name = fields['name']
+		p.hmac = fields['hmac']
 
 		return p
 
@@ -213,7 +183,7 @@ class Position(Payload):
 
 		# (timestamp removed)
 
-		name_bytes = self.name.encode('utf-8')
+		name_bytes = self.name.encode('utf-8', 'surrogateescape')
 		parts += struct.pack('>B', len(name_bytes))
 		parts += name_bytes
 
@@ -230,6 +200,258 @@ class Position(Payload):
 		)
 
 
+class SessionPosition(Payload):
+	"""Represents the position of a device with a session ID assigned by the
+	server in answer to DISCOVER, with layout (big-endian/network byte order):
+
+	- 1 byte header (bytes, bit 4 set to mark a session frame)
+	- 1 byte interval (unsigned int)
+	- 1 byte confidence (unsigned int)
+	- 1 byte satellites (unsigned int)
+	- 2 bytes session (unsigned int)
+	- 4 bytes latitude (signed int, stored as int = float * 1e7)
+	- 4 bytes longitude (signed int, stored as int = float * 1e7)
+	- 1 byte namelen (unsigned int)
+	- n bytes name (utf-8 string, empty if unchanged since the last frame of the session)
+	- 16 bytes hmac (bytes)
+	"""
+
+	SCALE: float = 1e7
+	HEADER_SESSION: int = 0x10
+
+	# typed attributes
+	header: bytes
+	interval: int
+	confidence: int
+	satellites: int
+	session: int
+	latitude: float
+	longitude: float
+	name: str
+	hmac: bytes
+
+	def __init__(self) -> None:
+		self.header = b"\x00"
+		self.interval = 0
+		self.confidence = 0
+		self.satellites = 0
+		self.session = 0
+		self.latitude = 0.0
+		self.longitude = 0.0
+		self.name = ""
+		self.hmac = b"\x00" * 16
+
+	def set_header(self, valid: bool) -> None:
+		"""Set the single-byte header from components.
+
+		MSB is always 1, bit 4 marks the session frame, bit 0 is the `valid` flag.
+		"""
+		header_val = 0x80 | self.HEADER_SESSION | (1 if valid else 0)
+		self.header = bytes([header_val])
+
+	def get_header(self) -> Tuple[bool]:
+		"""Return (valid) decoded from the header byte."""
+		return (bool(self.header[0] & 0x01),)
+
+	@staticmethod
+	def is_session(data: bytes) -> bool:
+		"""Return True if the raw position frame is a session frame."""
+		return len(data) > 0 and bool(data[0] & SessionPosition.HEADER_SESSION)
+
+	@staticmethod
+	def init(data: bytes) -> "SessionPosition":
+		"""Parse a raw frame, raises DecodeError (a ValueError) on malformed frames."""
+		if not isinstance(data, (bytes, bytearray)):
+			raise TypeError('data must be bytes or bytearray')
+
+		fields = decode_session_position(data)
+
+		p = SessionPosition()
+		p.header = bytes([fields['header']])
+		p.interval = fields['interval']
+		p.confidence = fields['confidence']
+		p.satellites = fields['satellites']
+		p.session = fields['session']
+		p.latitude = fields['latitude']
+		p.longitude = fields['longitude']
+		p.name = fields['name']
+		p.hmac = fields['hmac']
+
+		return p
+
+	def _serialize_fields(self) -> bytes:
+		"""Serialize all fields except the trailing HMAC (for signing/verifying)."""
+		parts = bytearray()
+
+		parts += self.header
+		parts += struct.pack('>BBBH', int(self.interval), int(self.confidence), int(self.satellites), int(self.session))
+		parts += struct.pack('>i', int(round(self.latitude * self.SCALE)))
+		parts += struct.pack('>i', int(round(self.longitude * self.SCALE)))
+
+		name_bytes = self.name.encode('utf-8', 'surrogateescape')
+		parts += struct.pack('>B', len(name_bytes))
+		parts += name_bytes
+
+		return bytes(parts)
+
+	def __repr__(self) -> str:  # pragma: no cover - convenience
+		return (
+			f"SessionPosition(header={self.header!r}, interval={self.interval}, "
+			f"confidence={self.confidence}, satellites={self.satellites}, "
+			f"session={self.session:04x}, latitude={self.latitude}, "
+			f"longitude={self.longitude}, name={self.name!r}, hmac={self.hmac!r})"
+		)
+
+
+class PositionBatch(Payload):
+	"""Represents several fixes of one device sent under a single HMAC, with layout
+	(big-endian/network byte order):
+
+	- 1 byte header (bytes, bit 6 set to mark a batch)
+	- 1 byte interval (unsigned int)
+	- 6 bytes device (bytes)
+	- 1 byte count (unsigned int, 1..16)
+	- count fixes, oldest first, each with
+	  - 2 bytes age (unsigned int, seconds between the fix and the transmission)
+	  - 1 byte confidence (unsigned int)
+	  - 1 byte satellites (unsigned int)
+	  - 4 bytes latitude (signed int, stored as int = float * 1e7)
+	  - 4 bytes longitude (signed int, stored as int = float * 1e7)
+	- 1 byte namelen (unsigned int)
+	- n bytes name (utf-8 string)
+	- 16 bytes hmac (bytes)
+
+	If header bit 5 is set the fixes use the compact encoding: the first fix is
+	age (varint), confidence, satellites, latitude (4), longitude (4) and every
+	following fix is seconds since the previous fix (varint), confidence,
+	satellites and the latitude/longitude deltas of the scaled integers as
+	zigzag varints.
+
+	If header bit 2 is set the batch is sequenced: 2 bytes sequence (unsigned
+	int) follow the device, the number of the first fix, the following fixes
+	are numbered consecutively. The device repeats every fix until it receives
+	an ACK command with the sequence number following the last fix received.
+	"""
+
+	SCALE: float = 1e7
+	MAX_FIXES: int = 16
+	HEADER_BATCH: int = 0x40
+	HEADER_COMPACT: int = 0x20
+	HEADER_SEQUENCED: int = 0x04
+	SEQUENCE_WINDOW: int = BATCH_SEQUENCE_WINDOW
+
+	# typed attributes
+	header: bytes
+	interval: int
+	device: bytes
+	sequence: int
+	fixes: list[dict]
+	name: str
+	hmac: bytes
+
+	def __init__(self) -> None:
+		self.header = b"\x00"
+		self.interval = 0
+		self.device = b"\x00" * 6
+		self.sequence = 0
+		self.fixes = []
+		self.name = ""
+		self.hmac = b"\x00" * 16
+
+	def set_header(self, valid: bool, compact: bool = False, sequenced: bool = False) -> None:
+		"""Set the single-byte header from components.
+
+		MSB is always 1, bit 6 marks the batch, bit 5 selects the compact
+		encoding, bit 2 marks a sequenced batch, bit 0 is the `valid` flag.
+		"""
+		header_val = 0x80 | self.HEADER_BATCH | (self.HEADER_COMPACT if compact else 0) | (self.HEADER_SEQUENCED if sequenced else 0) | (1 if valid else 0)
+		self.header = bytes([header_val])
+
+	def get_header(self) -> Tuple[bool, bool]:
+		"""Return (valid, compact) decoded from the header byte."""
+		return (bool(self.header[0] & 0x01), bool(self.header[0] & self.HEADER_COMPACT))
+
+	@staticmethod
+	def is_batch(data: bytes) -> bool:
+		"""Return True if the raw position frame is a batch frame."""
+		return len(data) > 0 and bool(data[0] & PositionBatch.HEADER_BATCH)
+
+	def is_sequenced(self) -> bool:
+		"""Return True if the batch carries sequence numbers and wants an ACK."""
+		return bool(self.header[0] & self.HEADER_SEQUENCED)
+
+	@staticmethod
+	def init(data: bytes) -> "PositionBatch":
+		"""Parse a raw frame, raises DecodeError (a ValueError) on malformed frames."""
+		if not isinstance(data, (bytes, bytearray)):
+			raise TypeError('data must be bytes or bytearray')
+
+		sequenced = len(data) > 0 and bool(data[0] & PositionBatch.HEADER_SEQUENCED)
+		fields = decode_sequenced_batch(data) if sequenced else decode_position_batch(data)
+
+		b = PositionBatch()
+		b.header = bytes([fields['header']])
+		b.interval = fields['interval']
+		b.device = fields['device']
+		b.sequence = fields.get('sequence', 0)
+		b.fixes = fields['fixes']
+		b.name = fields['name']
+		b.hmac = fields['hmac']
+
+		return b
+
+	def _serialize_fields(self) -> bytes:
+		"""Serialize all fields except the trailing HMAC (for signing/verifying)."""
+		if len(self.fixes) < 1 or len(self.fixes) > self.MAX_FIXES:
+			raise ValueError('invalid number of fixes')
+
+		parts = bytearray()
+
+		parts += self.header
+		parts += struct.pack('>B', int(self.interval))
+		parts += self.device
+		if self.is_sequenced():
+			parts += struct.pack('>H', int(self.sequence))
+		parts += struct.pack('>B', len(self.fixes))
+
+		compact: bool = bool(self.header[0] & self.HEADER_COMPACT)
+		previous: Optional[dict] = None
+
+		for fix in self.fixes:
+			lat_int = int(round(fix['latitude'] * self.SCALE))
+			lon_int = int(round(fix['longitude'] * self.SCALE))
+
+			if not compact:
+				parts += struct.pack('>HBBii', int(fix['age']), int(fix['confidence']), int(fix['satellites']), lat_int, lon_int)
+			elif previous is None:
+				parts += _pack_varint(int(fix['age']))
+				parts += struct.pack('>BBii', int(fix['confidence']), int(fix['satellites']), lat_int, lon_int)
+			else:
+				seconds = int(previous['age']) - int(fix['age'])
+				if seconds < 0:
+					raise ValueError('fixes must be ordered oldest first')
+
+				parts += _pack_varint(seconds)
+				parts += struct.pack('>BB', int(fix['confidence']), int(fix['satellites']))
+				parts += _pack_varint(_zigzag_encode(lat_int - int(round(previous['latitude'] * self.SCALE))))
+				parts += _pack_varint(_zigzag_encode(lon_int - int(round(previous['longitude'] * self.SCALE))))
+
+			previous = fix
+
+		name_bytes = self.name.encode('utf-8', 'surrogateescape')
+		parts += struct.pack('>B', len(name_bytes))
+		parts += name_bytes
+
+		return bytes(parts)
+
+	def __repr__(self) -> str:  # pragma: no cover - convenience
+		return (
+			f"PositionBatch(header={self.header!r}, interval={self.interval}, "
+			f"device={self.device!r}, sequence={self.sequence}, fixes={self.fixes!r}, "
+			f"name={self.name!r}, hmac={self.hmac!r})"
+		)
+
+
 class Command(Payload):
 	"""Represents a command payload with layout (big-endian/network byte order):
 
@@ -270,66 +492,147 @@ class Command(Payload):
 
 	@staticmethod
 	def init(data: bytes) -> "Command":
+		"""Parse a raw frame, raises DecodeError (a ValueError) on malformed frames."""
 		if not isinstance(data, (bytes, bytearray)):
 			raise TypeError('data must be bytes or bytearray')
 
-		min_fixed = 1 + 1 + 16
-		if len(data) < min_fixed:
-			raise ValueError(f'data too short: need at least {min_fixed} bytes')
+		fields = decode_command(data)
 
-		offset = 0
 		c = Command()
+		c.header = bytes([fields['header']])
+		c.arg = fields['arg']
+		c.hmac = fields['hmac']
+
+		return c
+
+	def _serialize_fields(self) -> bytes:
+		"""Serialize all fields except the trailing HMAC (for signing/verifying)."""
+		parts = bytearray()
+
+		parts += self.header
 
-		# 1 byte header
-		c.header = bytes(data[offset : offset + 1])
-		offset += 1
+		arg_bytes = self.arg.encode('utf-8', 'surrogateescape')
+		parts += struct.pack('>B', len(arg_bytes))
 
-		# 1 byte arglen
-		arglen: int = struct.unpack_from('>B', data, offset)[0]
-		offset += 1
+		parts += arg_bytes
 
-		if len(data) < offset + arglen + 16:
-			raise ValueError('data too short for arg length and hmac')
+		return bytes(parts)
 
-		arg_bytes = data[offset : offset + arglen]
+	def __repr__(self) -> str:  # pragma: no cover - convenience
+		return (
+			f"Command(header={self.header!r}, "
+			f"arg={self.arg!r}, hmac={self.hmac!r})"
+		)
 
-		try:
-			c.arg = arg_bytes.decode('utf-8')
-		except Exception as exc:
-			raise ValueError('arg is not valid UTF-8') from exc
+class Telemetry(Payload):
+	"""Represents the phase statistics a device sends every few hours, with layout
+	(big-endian/network byte order):
 
-		offset += arglen
+	- 1 byte header (bytes, bit 3 set to mark a telemetry frame)
+	- 6 bytes device (bytes)
+	- 4 bytes window (unsigned int, seconds covered by the frame)
+	- 4 bytes awake (unsigned int, seconds the ESP32 was awake within the window)
+	- 2 bytes each restarts, crashes, gnss_retries, gnss_timeouts, attach_failures, send_failures (unsigned int)
+	- 1 byte count (unsigned int)
+	- count phases in the order clock, assistance, attach, detach, gnss, send, each with
+	  - 2 bytes samples (unsigned int)
+	  - 4 bytes total_millis (unsigned int, wall time of all samples)
+	  - 4 bytes max_millis (unsigned int)
+	  - 4 bytes charge (unsigned int, estimated uAh)
+	  - 10 x 2 bytes buckets (unsigned int), bucket i counts the samples below 125ms << i, the last one the rest
+	- 16 bytes hmac (bytes)
+	"""
 
-		# 16 bytes hmac
-		c.hmac = bytes(data[offset : offset + 16])
-		offset += 16
+	HEADER_TELEMETRY: int = 0x08
 
-		if len(data) != offset:
-			raise ValueError('extra or missing bytes after parsing hmac')
+	COUNTERS = ('restarts', 'crashes', 'gnss_retries', 'gnss_timeouts', 'attach_failures', 'send_failures')
 
-		return c
+	# typed attributes
+	header: bytes
+	device: bytes
+	window: int
+	awake: int
+	counters: dict[str, int]
+	phases: list[dict]
+	hmac: bytes
+
+	def __init__(self) -> None:
+		self.header = bytes([0x80 | self.HEADER_TELEMETRY])
+		self.device = b"\x00" * 6
+		self.window = 0
+		self.awake = 0
+		self.counters = {name: 0 for name in self.COUNTERS}
+		self.phases = []
+		self.hmac = b"\x00" * 16
+
+	@staticmethod
+	def is_telemetry(data: bytes) -> bool:
+		"""Return True if the raw frame is a telemetry frame."""
+		return len(data) > 0 and bool(data[0] & Telemetry.HEADER_TELEMETRY)
+
+	@staticmethod
+	def init(data: bytes) -> "Telemetry":
+		"""Parse a raw frame, raises DecodeError (a ValueError) on malformed frames."""
+		if not isinstance(data, (bytes, bytearray)):
+			raise TypeError('data must be bytes or bytearray')
+
+		fields = decode_telemetry(data)
+
+		t = Telemetry()
+		t.header = bytes([fields['header']])
+		t.device = fields['device']
+		t.window = fields['window']
+		t.awake = fields['awake']
+		t.counters = {name: fields[name] for name in Telemetry.COUNTERS}
+		t.phases = fields['phases']
+		t.hmac = fields['hmac']
+
+		return t
 
 	def _serialize_fields(self) -> bytes:
 		"""Serialize all fields except the trailing HMAC (for signing/verifying)."""
 		parts = bytearray()
 
 		parts += self.header
+		parts += self.device
+		parts += struct.pack('>II', int(self.window), int(self.awake))
+		parts += struct.pack('>6H', *(int(self.counters[name]) for name in self.COUNTERS))
+		parts += struct.pack('>B', len(self.phases))
 
-		arg_bytes = self.arg.encode('utf-8')
-		parts += struct.pack('>B', len(arg_bytes))
-
-		parts += arg_bytes
+		for phase in self.phases:
+			parts += struct.pack('>HIII', int(phase['samples']), int(phase['total_millis']), int(phase['max_millis']), int(phase['charge']))
+			parts += struct.pack('>%dH' % TELEMETRY_BUCKETS, *(int(b) for b in phase['buckets']))
 
 		return bytes(parts)
 
+	def summary(self) -> str:
+		"""Human readable table of the phases."""
+		lines = [
+			f"Telemetry of {self.device.hex()} over {self.window}s, {self.awake}s awake, "
+			+ ", ".join(f"{name.replace('_', ' ')} {value}" for name, value in self.counters.items())
+		]
+
+		for phase in self.phases:
+			mean = phase['total_millis'] / phase['samples'] / 1000 if phase['samples'] else 0.0
+			lines.append(
+				f"  {phase['phase']:<12} {phase['samples']:>6} samples, mean {mean:.2f}s, max {phase['max_millis'] / 1000:.2f}s, "
+				f"{phase['charge'] / 1000:.2f}mAh, buckets from <{TELEMETRY_BUCKET_BASE_MILLIS}ms {phase['buckets']}"
+			)
+
+		return "\n".join(lines)
+
 	def __repr__(self) -> str:  # pragma: no cover - convenience
 		return (
-			f"Command(header={self.header!r}, "
-			f"arg={self.arg!r}, hmac={self.hmac!r})"
+			f"Telemetry(header={self.header!r}, device={self.device!r}, "
+			f"window={self.window}, awake={self.awake}, counters={self.counters!r}, "
+			f"phases={self.phases!r}, hmac={self.hmac!r})"
 		)
 
+
 class CommandAction:
 	DISCOVER = 0
 	SETINTERVAL = 1
 	SETNAME = 2
-	EXIT = 3
\ No newline at end of file
+	EXIT = 3
+	SETSESSION = 4
+	ACK = 5
\ No newline at end of file
@@ -0,0 +1,306 @@
+# messages_schema.py - generated by firmware/waltrac/tools/schemagen.cpp from
+# firmware/waltrac/MessageSchema.h, do not edit.
+
+from __future__ import annotations
+
+import struct
+from typing import Any, Dict, List, Tuple
+
+
+class DecodeError(ValueError):
+	"""Raised when a frame cannot be decoded, `status` matches Messages::decodeStatusName()."""
+
+	def __init__(self, status: str) -> None:
+		super().__init__(status)
+		self.status = status
+
+
+def _need(offset: int, end: int, n: int) -> None:
+	if end - offset < n:
+		raise DecodeError('bad length')
+
+def _read_header(data: bytes, offset: int, end: int, required: int, forbidden: int, value_mask: int, max_value: int) -> Tuple[int, int]:
+	_need(offset, end, 1)
+	v = data[offset]
+	if (v & required) != required or (v & forbidden) or (v & value_mask) > max_value:
+		raise DecodeError('bad header')
+
+	return (v, offset + 1)
+
+def _read_u8(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 1)
+	return (data[offset], offset + 1)
+
+def _read_u16(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 2)
+	return (struct.unpack_from('>H', data, offset)[0], offset + 2)
+
+def _read_u32(data: bytes, offset: int, end: int) -> Tuple[int, int]:
+	_need(offset, end, 4)
+	return (struct.unpack_from('>I', data, offset)[0], offset + 4)
+
+def _read_bytes(data: bytes, offset: int, end: int, n: int) -> Tuple[bytes, int]:
+	_need(offset, end, n)
+	return (bytes(data[offset : offset + n]), offset + n)
+
+def _read_scaled_i32(data: bytes, offset: int, end: int, scale: int) -> Tuple[float, int]:
+	_need(offset, end, 4)
+	return (float(struct.unpack_from('>i', data, offset)[0]) / scale, offset + 4)
+
+def _read_str8(data: bytes, offset: int, end: int) -> Tuple[str, int]:
+	_need(offset, end, 1)
+	n = data[offset]
+	_need(offset + 1, end, n)
+
+	# The firmware takes names as bytes, bytes that are not UTF-8 survive as surrogate escapes
+	value = bytes(data[offset + 1 : offset + 1 + n]).decode('utf-8', 'surrogateescape')
+	return (value, offset + 1 + n)
+
+def _read_varint(data: bytes, offset: int, end: int, max_bytes: int) -> Tuple[int, int]:
+	value = 0
+	for i in range(max_bytes):
+		if offset >= end:
+			break
+
+		b = data[offset]
+		offset += 1
+		value |= (b & 0x7F) << (7 * i)
+
+		if not b & 0x80:
+			return (value, offset)
+
+	raise DecodeError('bad length')
+
+def _zigzag_decode(value: int) -> int:
+	return (value >> 1) ^ -(value & 1)
+
+def _read_batch_fixes(data: bytes, offset: int, end: int, header: int) -> Tuple[List[Dict[str, Any]], int]:
+	count, offset = _read_u8(data, offset, end)
+	if count < 1 or count > BATCH_MAX_FIXES:
+		raise DecodeError('bad length')
+
+	compact = bool(header & BATCH_HEADER_COMPACT)
+	fixes: List[Dict[str, Any]] = []
+	age = lat_int = lon_int = 0
+
+	for i in range(count):
+		if not compact:
+			_need(offset, end, BATCH_FIX_SIZE)
+			age, confidence, satellites, lat_int, lon_int = struct.unpack_from('>HBBii', data, offset)
+			offset += BATCH_FIX_SIZE
+		elif i == 0:
+			age, offset = _read_varint(data, offset, end, 3)
+			_need(offset, end, 10)
+			if age > 0xFFFF:
+				raise DecodeError('bad length')
+
+			confidence, satellites, lat_int, lon_int = struct.unpack_from('>BBii', data, offset)
+			offset += 10
+		else:
+			seconds, offset = _read_varint(data, offset, end, 3)
+			_need(offset, end, 2)
+			confidence, satellites = struct.unpack_from('>BB', data, offset)
+			offset += 2
+
+			dlat, offset = _read_varint(data, offset, end, 5)
+			dlon, offset = _read_varint(data, offset, end, 5)
+
+			age -= seconds
+			lat_int += _zigzag_decode(dlat)
+			lon_int += _zigzag_decode(dlon)
+
+			if age < 0 or not -2**31 <= lat_int < 2**31 or not -2**31 <= lon_int < 2**31:
+				raise DecodeError('bad length')
+
+		fixes.append({
+			'age': age,
+			'confidence': confidence,
+			'satellites': satellites,
+			'latitude': float(lat_int) / BATCH_SCALE,
+			'longitude': float(lon_int) / BATCH_SCALE,
+		})
+
+	return (fixes, offset)
+
+def _read_telemetry_phases(data: bytes, offset: int, end: int) -> Tuple[List[Dict[str, Any]], int]:
+	count, offset = _read_u8(data, offset, end)
+	_need(offset, end, count * TELEMETRY_PHASE_SIZE)
+
+	phases: List[Dict[str, Any]] = []
+	for i in range(count):
+		samples, total_millis, max_millis, charge = struct.unpack_from('>HIII', data, offset)
+		buckets = list(struct.unpack_from('>%dH' % TELEMETRY_BUCKETS, data, offset + 14))
+		offset += TELEMETRY_PHASE_SIZE
+
+		phases.append({
+			'phase': TELEMETRY_PHASES[i] if i < len(TELEMETRY_PHASES) else str(i),
+			'samples': samples,
+			'total_millis': total_millis,
+			'max_millis': max_millis,
+			'charge': charge,
+			'buckets': buckets,
+		})
+
+	return (phases, offset)
+
+
+HMAC_SIZE = 16
+
+BATCH_SCALE = 10000000
+BATCH_MAX_FIXES = 16
+BATCH_HEADER_COMPACT = 0x20
+BATCH_HEADER_SEQUENCED = 0x04
+BATCH_SEQUENCE_WINDOW = 1024
+BATCH_FIX_SIZE = 12
+TELEMETRY_PHASE_SIZE = 34
+TELEMETRY_BUCKETS = 10
+TELEMETRY_BUCKET_BASE_MILLIS = 125
+TELEMETRY_PHASES = ['clock', 'assistance', 'attach', 'detach', 'gnss', 'send']
+
+
+POSITION_MIN_SIZE = 35
+
+def decode_position(data: bytes) -> Dict[str, Any]:
+	if len(data) < POSITION_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0x80, 0x58, 0x00, 0x00)
+	fields['interval'], offset = _read_u8(data, offset, end)
+	fields['confidence'], offset = _read_u8(data, offset, end)
+	fields['satellites'], offset = _read_u8(data, offset, end)
+	fields['device'], offset = _read_bytes(data, offset, end, 6)
+	fields['latitude'], offset = _read_scaled_i32(data, offset, end, 10000000)
+	fields['longitude'], offset = _read_scaled_i32(data, offset, end, 10000000)
+	fields['name'], offset = _read_str8(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
+
+
+SESSION_POSITION_MIN_SIZE = 31
+
+def decode_session_position(data: bytes) -> Dict[str, Any]:
+	if len(data) < SESSION_POSITION_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0x90, 0x48, 0x00, 0x00)
+	fields['interval'], offset = _read_u8(data, offset, end)
+	fields['confidence'], offset = _read_u8(data, offset, end)
+	fields['satellites'], offset = _read_u8(data, offset, end)
+	fields['session'], offset = _read_u16(data, offset, end)
+	fields['latitude'], offset = _read_scaled_i32(data, offset, end, 10000000)
+	fields['longitude'], offset = _read_scaled_i32(data, offset, end, 10000000)
+	fields['name'], offset = _read_str8(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
+
+
+POSITION_BATCH_MIN_SIZE = 26
+
+def decode_position_batch(data: bytes) -> Dict[str, Any]:
+	if len(data) < POSITION_BATCH_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0xC0, 0x1C, 0x00, 0x00)
+	fields['interval'], offset = _read_u8(data, offset, end)
+	fields['device'], offset = _read_bytes(data, offset, end, 6)
+	fields['fixes'], offset = _read_batch_fixes(data, offset, end, data[0])
+	fields['name'], offset = _read_str8(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
+
+
+SEQUENCED_BATCH_MIN_SIZE = 28
+
+def decode_sequenced_batch(data: bytes) -> Dict[str, Any]:
+	if len(data) < SEQUENCED_BATCH_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0xC4, 0x18, 0x00, 0x00)
+	fields['interval'], offset = _read_u8(data, offset, end)
+	fields['device'], offset = _read_bytes(data, offset, end, 6)
+	fields['sequence'], offset = _read_u16(data, offset, end)
+	fields['fixes'], offset = _read_batch_fixes(data, offset, end, data[0])
+	fields['name'], offset = _read_str8(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
+
+
+COMMAND_MIN_SIZE = 18
+
+def decode_command(data: bytes) -> Dict[str, Any]:
+	if len(data) < COMMAND_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0x80, 0x00, 0x0F, 0x05)
+	fields['arg'], offset = _read_str8(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
+
+
+TELEMETRY_MIN_SIZE = 44
+
+def decode_telemetry(data: bytes) -> Dict[str, Any]:
+	if len(data) < TELEMETRY_MIN_SIZE:
+		raise DecodeError('too short')
+
+	end = len(data) - HMAC_SIZE
+	offset = 0
+	fields: Dict[str, Any] = {}
+
+	fields['header'], offset = _read_header(data, offset, end, 0x88, 0x70, 0x00, 0x00)
+	fields['device'], offset = _read_bytes(data, offset, end, 6)
+	fields['window'], offset = _read_u32(data, offset, end)
+	fields['awake'], offset = _read_u32(data, offset, end)
+	fields['restarts'], offset = _read_u16(data, offset, end)
+	fields['crashes'], offset = _read_u16(data, offset, end)
+	fields['gnss_retries'], offset = _read_u16(data, offset, end)
+	fields['gnss_timeouts'], offset = _read_u16(data, offset, end)
+	fields['attach_failures'], offset = _read_u16(data, offset, end)
+	fields['send_failures'], offset = _read_u16(data, offset, end)
+	fields['phases'], offset = _read_telemetry_phases(data, offset, end)
+
+	if offset != end:
+		raise DecodeError('trailing bytes')
+
+	fields['hmac'] = bytes(data[end:])
+	return fields
@@ -0,0 +1,297 @@
+// messages.js - generated by firmware/waltrac/tools/schemagen.cpp from
+// firmware/waltrac/MessageSchema.h, do not edit.
+
+"use strict";
+
+class DecodeError extends Error {
+    constructor(status) {
+        super(status);
+        this.name = "DecodeError";
+        this.status = status;
+    }
+}
+
+function need(offset, end, n) {
+    if (end - offset < n) throw new DecodeError("bad length");
+}
+
+function readHeader(view, offset, end, required, forbidden, valueMask, maxValue) {
+    need(offset, end, 1);
+    const v = view.getUint8(offset);
+    if ((v & required) !== required || (v & forbidden) || (v & valueMask) > maxValue) throw new DecodeError("bad header");
+    return [v, offset + 1];
+}
+
+function readU8(view, offset, end) {
+    need(offset, end, 1);
+    return [view.getUint8(offset), offset + 1];
+}
+
+function readU16(view, offset, end) {
+    need(offset, end, 2);
+    return [view.getUint16(offset, false), offset + 2];
+}
+
+function readU32(view, offset, end) {
+    need(offset, end, 4);
+    return [view.getUint32(offset, false), offset + 4];
+}
+
+function readBytes(view, offset, end, n) {
+    need(offset, end, n);
+    return [new Uint8Array(view.buffer, view.byteOffset + offset, n), offset + n];
+}
+
+function readScaledI32(view, offset, end, scale) {
+    need(offset, end, 4);
+    return [view.getInt32(offset, false) / scale, offset + 4];
+}
+
+function readStr8(view, offset, end) {
+    need(offset, end, 1);
+    const n = view.getUint8(offset);
+    need(offset + 1, end, n);
+    const value = new TextDecoder().decode(new Uint8Array(view.buffer, view.byteOffset + offset + 1, n));
+    return [value, offset + 1 + n];
+}
+
+function readVarint(view, offset, end, maxBytes) {
+    let value = 0;
+    for (let i = 0; i < maxBytes && offset < end; i++) {
+        const b = view.getUint8(offset++);
+        value += (b & 0x7f) * 2 ** (7 * i);
+        if (!(b & 0x80)) return [value, offset];
+    }
+    throw new DecodeError("bad length");
+}
+
+function zigzagDecode(v) {
+    return v % 2 ? -(v + 1) / 2 : v / 2;
+}
+
+function readBatchFixes(view, offset, end, header) {
+    let count;
+    [count, offset] = readU8(view, offset, end);
+    if (count < 1 || count > BATCH_MAX_FIXES) throw new DecodeError("bad length");
+
+    const compact = header & BATCH_HEADER_COMPACT;
+    const fixes = [];
+    let age = 0, lat = 0, lon = 0;
+
+    for (let i = 0; i < count; i++) {
+        let confidence, satellites;
+        if (!compact) {
+            need(offset, end, BATCH_FIX_SIZE);
+            age = view.getUint16(offset, false);
+            confidence = view.getUint8(offset + 2);
+            satellites = view.getUint8(offset + 3);
+            lat = view.getInt32(offset + 4, false);
+            lon = view.getInt32(offset + 8, false);
+            offset += BATCH_FIX_SIZE;
+        } else if (i === 0) {
+            [age, offset] = readVarint(view, offset, end, 3);
+            need(offset, end, 10);
+            if (age > 0xffff) throw new DecodeError("bad length");
+            confidence = view.getUint8(offset);
+            satellites = view.getUint8(offset + 1);
+            lat = view.getInt32(offset + 2, false);
+            lon = view.getInt32(offset + 6, false);
+            offset += 10;
+        } else {
+            let seconds, dlat, dlon;
+            [seconds, offset] = readVarint(view, offset, end, 3);
+            need(offset, end, 2);
+            confidence = view.getUint8(offset);
+            satellites = view.getUint8(offset + 1);
+            offset += 2;
+            [dlat, offset] = readVarint(view, offset, end, 5);
+            [dlon, offset] = readVarint(view, offset, end, 5);
+
+            age -= seconds;
+            lat += zigzagDecode(dlat);
+            lon += zigzagDecode(dlon);
+            if (age < 0 || lat < -(2 ** 31) || lat >= 2 ** 31 || lon < -(2 ** 31) || lon >= 2 ** 31) throw new DecodeError("bad length");
+        }
+        fixes.push({ age, confidence, satellites, latitude: lat / BATCH_SCALE, longitude: lon / BATCH_SCALE });
+    }
+
+    return [fixes, offset];
+}
+
+function readTelemetryPhases(view, offset, end) {
+    let count;
+    [count, offset] = readU8(view, offset, end);
+    need(offset, end, count * TELEMETRY_PHASE_SIZE);
+
+    const phases = [];
+    for (let i = 0; i < count; i++) {
+        const buckets = [];
+        for (let b = 0; b < TELEMETRY_BUCKETS; b++) buckets.push(view.getUint16(offset + 14 + 2 * b, false));
+        phases.push({
+            phase: i < TELEMETRY_PHASES.length ? TELEMETRY_PHASES[i] : String(i),
+            samples: view.getUint16(offset, false),
+            totalMillis: view.getUint32(offset + 2, false),
+            maxMillis: view.getUint32(offset + 6, false),
+            charge: view.getUint32(offset + 10, false),
+            buckets,
+        });
+        offset += TELEMETRY_PHASE_SIZE;
+    }
+
+    return [phases, offset];
+}
+
+const HMAC_SIZE = 16;
+
+const BATCH_SCALE = 10000000;
+const BATCH_MAX_FIXES = 16;
+const BATCH_HEADER_COMPACT = 0x20;
+const BATCH_HEADER_SEQUENCED = 0x04;
+const BATCH_SEQUENCE_WINDOW = 1024;
+const BATCH_FIX_SIZE = 12;
+const TELEMETRY_PHASE_SIZE = 34;
+const TELEMETRY_BUCKETS = 10;
+const TELEMETRY_BUCKET_BASE_MILLIS = 125;
+const TELEMETRY_PHASES = ["clock", "assistance", "attach", "detach", "gnss", "send"];
+
+const POSITION_MIN_SIZE = 35;
+
+function decodePosition(payload) {
+    if (payload.byteLength < POSITION_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0x80, 0x58, 0x00, 0x00);
+    [fields.interval, offset] = readU8(view, offset, end);
+    [fields.confidence, offset] = readU8(view, offset, end);
+    [fields.satellites, offset] = readU8(view, offset, end);
+    [fields.device, offset] = readBytes(view, offset, end, 6);
+    [fields.latitude, offset] = readScaledI32(view, offset, end, 10000000);
+    [fields.longitude, offset] = readScaledI32(view, offset, end, 10000000);
+    [fields.name, offset] = readStr8(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}
+
+const SESSION_POSITION_MIN_SIZE = 31;
+
+function decodeSessionPosition(payload) {
+    if (payload.byteLength < SESSION_POSITION_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0x90, 0x48, 0x00, 0x00);
+    [fields.interval, offset] = readU8(view, offset, end);
+    [fields.confidence, offset] = readU8(view, offset, end);
+    [fields.satellites, offset] = readU8(view, offset, end);
+    [fields.session, offset] = readU16(view, offset, end);
+    [fields.latitude, offset] = readScaledI32(view, offset, end, 10000000);
+    [fields.longitude, offset] = readScaledI32(view, offset, end, 10000000);
+    [fields.name, offset] = readStr8(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}
+
+const POSITION_BATCH_MIN_SIZE = 26;
+
+function decodePositionBatch(payload) {
+    if (payload.byteLength < POSITION_BATCH_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0xc0, 0x1c, 0x00, 0x00);
+    [fields.interval, offset] = readU8(view, offset, end);
+    [fields.device, offset] = readBytes(view, offset, end, 6);
+    [fields.fixes, offset] = readBatchFixes(view, offset, end, view.getUint8(0));
+    [fields.name, offset] = readStr8(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}
+
+const SEQUENCED_BATCH_MIN_SIZE = 28;
+
+function decodeSequencedBatch(payload) {
+    if (payload.byteLength < SEQUENCED_BATCH_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0xc4, 0x18, 0x00, 0x00);
+    [fields.interval, offset] = readU8(view, offset, end);
+    [fields.device, offset] = readBytes(view, offset, end, 6);
+    [fields.sequence, offset] = readU16(view, offset, end);
+    [fields.fixes, offset] = readBatchFixes(view, offset, end, view.getUint8(0));
+    [fields.name, offset] = readStr8(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}
+
+const COMMAND_MIN_SIZE = 18;
+
+function decodeCommand(payload) {
+    if (payload.byteLength < COMMAND_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0x80, 0x00, 0x0f, 0x05);
+    [fields.arg, offset] = readStr8(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}
+
+const TELEMETRY_MIN_SIZE = 44;
+
+function decodeTelemetry(payload) {
+    if (payload.byteLength < TELEMETRY_MIN_SIZE) throw new DecodeError("too short");
+
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    const end = payload.byteLength - HMAC_SIZE;
+    const fields = {};
+    let offset = 0;
+
+    [fields.header, offset] = readHeader(view, offset, end, 0x88, 0x70, 0x00, 0x00);
+    [fields.device, offset] = readBytes(view, offset, end, 6);
+    [fields.window, offset] = readU32(view, offset, end);
+    [fields.awake, offset] = readU32(view, offset, end);
+    [fields.restarts, offset] = readU16(view, offset, end);
+    [fields.crashes, offset] = readU16(view, offset, end);
+    [fields.gnss_retries, offset] = readU16(view, offset, end);
+    [fields.gnss_timeouts, offset] = readU16(view, offset, end);
+    [fields.attach_failures, offset] = readU16(view, offset, end);
+    [fields.send_failures, offset] = readU16(view, offset, end);
+    [fields.phases, offset] = readTelemetryPhases(view, offset, end);
+
+    if (offset !== end) throw new DecodeError("trailing bytes");
+
+    fields.hmac = new Uint8Array(payload.buffer, payload.byteOffset + end, HMAC_SIZE);
+    return fields;
+}